@@ -0,0 +1,875 @@
+﻿#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <omp.h>
+
+#include "counters.h"
+#include "roofline.h"
+
+namespace bench {
+
+std::vector<Kernel>& registry() {
+    static std::vector<Kernel> kernels;
+    return kernels;
+}
+
+Registrar::Registrar(Kernel kernel) {
+    registry().push_back(std::move(kernel));
+}
+
+// '*' - любая подстрока, '?' - любой символ.
+bool wildcard_match(const std::string& pattern, const std::string& text) {
+    size_t p = 0, t = 0, star = std::string::npos, mark = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = t;
+        }
+        else if (star != std::string::npos) {
+            p = star + 1;
+            t = ++mark;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream stream(text);
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+static bool matches_any(const std::vector<std::string>& patterns, const std::string& name) {
+    if (patterns.empty()) {
+        return true;
+    }
+    for (const std::string& pattern : patterns) {
+        if (wildcard_match(pattern, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Config::wants_kernel(const std::string& name) const {
+    return matches_any(kernels, name);
+}
+
+bool Config::wants_variant(const std::string& name) const {
+    return matches_any(variants, name);
+}
+
+std::string Config::param(const std::string& key, const std::string& fallback) const {
+    auto it = params.find(key);
+    return it != params.end() ? it->second : fallback;
+}
+
+std::map<std::string, std::string> kernel_params(const Kernel& kernel, const Config& config) {
+    std::map<std::string, std::string> values;
+    for (const std::string& description : kernel.params) {
+        size_t sep = description.find('=');
+        if (sep == std::string::npos) {
+            continue;
+        }
+        std::string fallback = description.substr(sep + 1, description.find(" - ", sep) - sep - 1);
+        fallback = fallback.substr(0, fallback.find('|'));
+        values[description.substr(0, sep)] = config.param(description.substr(0, sep), fallback);
+    }
+    return values;
+}
+
+std::string format_params(const std::map<std::string, std::string>& params) {
+    std::string text;
+    for (const auto& item : params) {
+        text += (text.empty() ? "" : ";") + item.first + "=" + item.second;
+    }
+    return text;
+}
+
+std::map<std::string, std::string> parse_params(const std::string& text) {
+    std::map<std::string, std::string> params;
+    for (const std::string& item : split(text, ';')) {
+        size_t sep = item.find('=');
+        if (sep != std::string::npos) {
+            params[item.substr(0, sep)] = item.substr(sep + 1);
+        }
+    }
+    return params;
+}
+
+// Число с необязательным суффиксом k/M/G (степени 1000) или в записи 1e6.
+static bool parse_count(const std::string& text, int64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    double multiplier = 1.0;
+    std::string number = text;
+    switch (text.back()) {
+    case 'k': case 'K': multiplier = 1e3; number.pop_back(); break;
+    case 'm': case 'M': multiplier = 1e6; number.pop_back(); break;
+    case 'g': case 'G': multiplier = 1e9; number.pop_back(); break;
+    }
+
+    char* end = nullptr;
+    double parsed = std::strtod(number.c_str(), &end);
+    if (number.empty() || *end != '\0' || parsed < 0) {
+        return false;
+    }
+    value = (int64_t)std::llround(parsed * multiplier);
+    return true;
+}
+
+int64_t Config::param_int(const std::string& key, int64_t fallback) const {
+    int64_t value = 0;
+    return parse_count(param(key, ""), value) ? value : fallback;
+}
+
+double Config::param_double(const std::string& key, double fallback) const {
+    std::string text = param(key, "");
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0' ? value : fallback;
+}
+
+static std::vector<int> default_threads() {
+    int procs = omp_get_num_procs();
+    std::vector<int> threads;
+    for (int t = 1; t < procs; t *= 2) {
+        threads.push_back(t);
+    }
+    threads.push_back(procs);
+    return threads;
+}
+
+// "1,2,4", "1-8", "pow2", "pow2:64", "max" и их комбинации через запятую.
+static bool parse_threads(const std::string& text, std::vector<int>& threads) {
+    int procs = omp_get_num_procs();
+    for (const std::string& item : split(text, ',')) {
+        if (item == "max") {
+            threads.push_back(procs);
+        }
+        else if (item.compare(0, 4, "pow2") == 0) {
+            int limit = procs;
+            if (item.size() > 4) {
+                if (item[4] != ':' || (limit = std::atoi(item.c_str() + 5)) <= 0) {
+                    return false;
+                }
+            }
+            for (int t = 1; t <= limit; t *= 2) {
+                threads.push_back(t);
+            }
+        }
+        else if (item.find('-') != std::string::npos) {
+            int first = std::atoi(item.c_str());
+            int last = std::atoi(item.c_str() + item.find('-') + 1);
+            if (first <= 0 || last < first) {
+                return false;
+            }
+            for (int t = first; t <= last; t++) {
+                threads.push_back(t);
+            }
+        }
+        else {
+            int t = std::atoi(item.c_str());
+            if (t <= 0) {
+                return false;
+            }
+            threads.push_back(t);
+        }
+    }
+
+    std::vector<int> unique;
+    for (int t : threads) {
+        if (std::find(unique.begin(), unique.end(), t) == unique.end()) {
+            unique.push_back(t);
+        }
+    }
+    threads = unique;
+    return !threads.empty();
+}
+
+bool parse_command_line(int argc, char** argv, Config& config, std::string& error) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+
+        // --key=value и --key value равноправны.
+        size_t eq = arg.find('=');
+        bool inline_value = arg.compare(0, 2, "--") == 0 && eq != std::string::npos;
+        if (inline_value) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        }
+        auto next_value = [&]() -> bool {
+            if (inline_value) {
+                return true;
+            }
+            if (i + 1 >= argc) {
+                error = "для " + arg + " не указано значение";
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        if (arg == "--help" || arg == "-h") {
+            config.help = true;
+        }
+        else if (arg == "--list") {
+            config.list = true;
+        }
+        else if (arg == "--kernels" || arg == "-k") {
+            if (!next_value()) return false;
+            config.kernels = split(value, ',');
+        }
+        else if (arg == "--variants") {
+            if (!next_value()) return false;
+            config.variants = split(value, ',');
+        }
+        else if (arg == "--sizes" || arg == "-s") {
+            if (!next_value()) return false;
+            config.sizes.clear();
+            for (const std::string& item : split(value, ',')) {
+                int64_t size = 0;
+                if (!parse_count(item, size) || size <= 0) {
+                    error = "неверный размер: " + item;
+                    return false;
+                }
+                config.sizes.push_back(size);
+            }
+        }
+        else if (arg == "--threads" || arg == "-t") {
+            if (!next_value()) return false;
+            config.threads.clear();
+            if (!parse_threads(value, config.threads)) {
+                error = "неверный список потоков: " + value;
+                return false;
+            }
+        }
+        else if (arg == "--reps" || arg == "-r" || arg == "--min-reps" || arg == "--max-reps") {
+            if (!next_value()) return false;
+            int reps = std::atoi(value.c_str());
+            if (reps <= 0) {
+                error = "неверное число повторов: " + value;
+                return false;
+            }
+            if (arg != "--max-reps") {
+                config.timing.min_reps = reps;
+            }
+            if (arg != "--min-reps") {
+                config.timing.max_reps = reps;
+            }
+        }
+        else if (arg == "--counters") {
+            config.counters = true;
+        }
+        else if (arg == "--counter-reps") {
+            if (!next_value()) return false;
+            config.counter_reps = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (arg == "--bind") {
+            if (!next_value()) return false;
+            if (value != "close" && value != "spread" && value != "master" && value != "primary"
+                && value != "true" && value != "false") {
+                error = "неизвестная привязка: " + value;
+                return false;
+            }
+            config.bind = value;
+        }
+        else if (arg == "--places") {
+            if (!next_value()) return false;
+            config.places = value;
+        }
+        else if (arg == "--memory") {
+            if (!next_value()) return false;
+            if (!parse_memory_policy(value, config.memory)) {
+                error = "неизвестная политика памяти: " + value;
+                return false;
+            }
+        }
+        else if (arg == "--huge-pages") {
+            if (!next_value()) return false;
+            config.pages.clear();
+            for (const std::string& name : split(value, ',')) {
+                parallel_kernels::page_mode mode;
+                if (!parallel_kernels::parse_page_mode(name, mode)) {
+                    error = "неизвестный режим страниц: " + name;
+                    return false;
+                }
+                config.pages.push_back(mode);
+            }
+        }
+        else if (arg == "--no-roofline") {
+            config.roofline = false;
+        }
+        else if (arg == "--stream-size") {
+            if (!next_value()) return false;
+            if (!parse_count(value, config.stream_bytes) || config.stream_bytes < 1000000) {
+                error = "неверный размер массива STREAM: " + value;
+                return false;
+            }
+        }
+        else if (arg == "--warmup") {
+            if (!next_value()) return false;
+            config.timing.warmup = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (arg == "--target-ci") {
+            if (!next_value()) return false;
+            config.timing.target_rel_ci = std::atof(value.c_str()) / 100.0;
+        }
+        else if (arg == "--max-time") {
+            if (!next_value()) return false;
+            config.timing.max_time = std::atof(value.c_str());
+        }
+        else if (arg == "--format" || arg == "-f") {
+            if (!next_value()) return false;
+            if (value != "csv" && value != "json") {
+                error = "неизвестный формат: " + value;
+                return false;
+            }
+            config.format = value;
+        }
+        else if (arg == "--output" || arg == "-o") {
+            if (!next_value()) return false;
+            config.output = value;
+        }
+        else if (arg == "--param" || arg == "-p") {
+            if (!next_value()) return false;
+            size_t sep = value.find('=');
+            if (sep == std::string::npos || sep == 0) {
+                error = "параметр должен иметь вид ключ=значение: " + value;
+                return false;
+            }
+            config.params[value.substr(0, sep)] = value.substr(sep + 1);
+        }
+        else if (arg == "--baseline") {
+            if (!next_value()) return false;
+            for (const std::string& path : split(value, ',')) {
+                config.baselines.push_back(path);
+            }
+        }
+        else if (arg == "--current") {
+            if (!next_value()) return false;
+            config.current = value;
+        }
+        else if (arg == "--threshold") {
+            if (!next_value()) return false;
+            config.threshold = std::atof(value.c_str()) / 100.0;
+        }
+        else if (arg == "--noise") {
+            if (!next_value()) return false;
+            config.noise = std::atof(value.c_str()) / 100.0;
+        }
+        else if (arg == "--seed") {
+            if (!next_value()) return false;
+            config.seed = (unsigned)std::strtoul(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "--data-cache") {
+            if (!next_value()) return false;
+            config.data_cache = value;
+        }
+        else if (arg == "--no-data-cache") {
+            config.data_cache.clear();
+        }
+        else if (arg == "--tune") {
+            if (!next_value()) return false;
+            config.tune_file = value;
+        }
+        else {
+            error = "неизвестный аргумент: " + arg;
+            return false;
+        }
+    }
+
+    if (config.threads.empty()) {
+        config.threads = default_threads();
+    }
+    if (!config.current.empty() && config.baselines.empty()) {
+        error = "--current требует --baseline";
+        return false;
+    }
+    if (config.timing.max_reps < config.timing.min_reps) {
+        config.timing.max_reps = config.timing.min_reps;
+    }
+    if (config.format == "csv" && config.output.size() > 5
+        && config.output.compare(config.output.size() - 5, 5, ".json") == 0) {
+        config.format = "json";
+    }
+
+    for (const std::string& pattern : config.kernels) {
+        bool found = false;
+        for (const Kernel& kernel : registry()) {
+            found = found || wildcard_match(pattern, kernel.name);
+        }
+        if (!found) {
+            error = "нет ядер, подходящих под " + pattern + " (см. --list)";
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_usage(std::ostream& out) {
+    out << "Использование: ompbench [опции]\n"
+        << "  --list                   список ядер, вариантов и размеров по умолчанию\n"
+        << "  -k, --kernels a,b*       ядра (шаблоны с * и ?), по умолчанию все\n"
+        << "      --variants x,y*      варианты ядер, по умолчанию все\n"
+        << "  -s, --sizes 1e6,5M,200k  размеры задачи, по умолчанию свои у каждого ядра\n"
+        << "  -t, --threads 1,2,4|1-8|pow2[:N]|max\n"
+        << "                           число потоков, по умолчанию степени двойки до числа ядер\n"
+        << "  -r, --reps N             ровно N замеряемых повторов (задаёт min и max)\n"
+        << "      --min-reps N         минимум повторов, по умолчанию 5\n"
+        << "      --max-reps N         максимум повторов, по умолчанию 100\n"
+        << "      --target-ci PCT      остановка, когда 95% ДИ среднего уже PCT%, по умолчанию 2\n"
+        << "      --max-time SEC       время на замер после минимума повторов, по умолчанию 5\n"
+        << "      --warmup N           прогревочных запусков вне замера, по умолчанию 1\n"
+        << "      --counters           аппаратные счётчики perf_event_open (Linux): IPC, промахи\n"
+        << "      --counter-reps N     отдельных запусков для счётчиков, по умолчанию 3\n"
+        << "      --bind close|spread|master|false\n"
+        << "                           привязка потоков (OMP_PROC_BIND), по умолчанию как в окружении\n"
+        << "      --places cores|threads|sockets|numa_domains|{0:4},{4:4}\n"
+        << "                           места для привязки (OMP_PLACES)\n"
+        << "      --memory default|first_touch|interleave|local\n"
+        << "                           размещение данных ядра по узлам NUMA перед замером\n"
+        << "      --huge-pages off,thp,hugetlb\n"
+        << "                           страницы данных ядер с huge_vector: обычные, прозрачные\n"
+        << "                           большие (madvise), hugetlbfs; прогон в каждом режиме\n"
+        << "      --no-roofline        без замера STREAM и колонок GB_per_sec/GFLOPS/Roofline(%)\n"
+        << "      --stream-size BYTES  байт на массив STREAM, по умолчанию 128M (>= 4x LLC)\n"
+        << "  -f, --format csv|json    формат результата\n"
+        << "  -o, --output FILE        файл результата, по умолчанию stdout\n"
+        << "  -p, --param key=value    параметр ядра (см. --list)\n"
+        << "      --seed N             seed генераторов данных, по умолчанию 1\n"
+        << "      --data-cache DIR     каталог кэша входных данных, по умолчанию ompbench_data\n"
+        << "      --no-data-cache      генерировать данные заново и не сохранять\n"
+        << "      --tune FILE          измерить накладные расходы OpenMP для --threads и записать\n"
+        << "                           пороги распараллеливания (PK_TUNING_FILE), без прогона ядер\n"
+        << "\nСравнение с базой (код выхода 4 при регрессиях):\n"
+        << "      --baseline a.csv,b   CSV ompbench или старые CSV лабораторных\n"
+        << "      --current FILE       сравнить готовый CSV с базой, без прогона\n"
+        << "      --threshold PCT      минимальное значимое изменение, по умолчанию 5\n"
+        << "      --noise PCT          шум строк без доверительного интервала, по умолчанию 3\n";
+}
+
+void print_kernels(std::ostream& out) {
+    for (const Kernel& kernel : registry()) {
+        out << kernel.name << " - " << kernel.description << "\n";
+        out << "    варианты: ";
+        for (size_t i = 0; i < kernel.variants.size(); i++) {
+            out << (i ? ", " : "") << kernel.variants[i];
+        }
+        out << "\n    размеры:  ";
+        for (size_t i = 0; i < kernel.default_sizes.size(); i++) {
+            out << (i ? ", " : "") << kernel.default_sizes[i];
+        }
+        out << "\n";
+        for (const std::string& param : kernel.params) {
+            out << "    --param " << param << "\n";
+        }
+    }
+}
+
+static bool matches_reference(double result, double reference, double tolerance) {
+    if (std::isnan(reference)) {
+        return true;
+    }
+    return std::fabs(result - reference) <= tolerance * std::max(1.0, std::fabs(reference));
+}
+
+// Отдельный проход вне замера времени: счётчики включаются только на время
+// run, подготовка в них не попадает. Значения усредняются по запускам.
+static void collect_counters(PerfCounters& counters, const Config& config, Workload& workload,
+    const std::string& variant, int threads, int64_t size, Row& row) {
+    counters.reset();
+    for (int rep = 0; rep < config.counter_reps; rep++) {
+        if (workload.setup) {
+            workload.setup(variant, threads);
+        }
+        counters.enable();
+        workload.run(variant, threads);
+        counters.disable();
+    }
+
+    CounterValues values = counters.read();
+    double per_run[COUNTER_EVENTS];
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        per_run[e] = values.value[e] / config.counter_reps;
+        if (values.valid[e]) {
+            row.metrics.push_back({ counter_name((CounterEvent)e), per_run[e] });
+        }
+    }
+
+    if (values.valid[COUNTER_CYCLES] && values.valid[COUNTER_INSTRUCTIONS]) {
+        row.metrics.push_back({ "IPC", per_run[COUNTER_CYCLES] > 0
+            ? per_run[COUNTER_INSTRUCTIONS] / per_run[COUNTER_CYCLES] : 0.0 });
+    }
+
+    double elements = workload.elements ? workload.elements(variant) : (double)size;
+    for (CounterEvent e : { COUNTER_LLC_MISSES, COUNTER_DTLB_MISSES, COUNTER_BRANCH_MISSES }) {
+        if (values.valid[e] && elements > 0) {
+            row.metrics.push_back({ std::string(counter_name(e)) + "_per_Elem", per_run[e] / elements });
+        }
+    }
+}
+
+// Достигнутые ГБ/с и ГФлоп/с по медиане и доля от roofline min(P, I * B)
+// для того же числа потоков. Для ядер без операций (или с нулевыми байтами)
+// доля считается от той границы, которая определена.
+static void add_roofline_metrics(Roofline& roofline, const Workload& workload, const std::string& variant,
+    int threads, Row& row) {
+    double bytes = workload.bytes ? workload.bytes(variant) : 0.0;
+    double flops = workload.flops ? workload.flops(variant) : 0.0;
+    double seconds = row.time.median / 1000.0;
+    if ((bytes <= 0 && flops <= 0) || seconds <= 0) {
+        return;
+    }
+
+    const RooflinePoint& point = roofline.get(threads);
+    double gb_per_sec = bytes / seconds / 1e9;
+    double gflops = flops / seconds / 1e9;
+    double percent = 0.0;
+    if (flops > 0 && bytes > 0) {
+        double attainable = std::min(point.gflops, flops / bytes * point.bandwidth);
+        percent = gflops / attainable * 100.0;
+    }
+    else if (bytes > 0) {
+        percent = gb_per_sec / point.bandwidth * 100.0;
+    }
+    else {
+        percent = gflops / point.gflops * 100.0;
+    }
+
+    if (bytes > 0) {
+        row.metrics.push_back({ "GB_per_sec", gb_per_sec });
+    }
+    if (flops > 0) {
+        row.metrics.push_back({ "GFLOPS", gflops });
+    }
+    if (flops > 0 && bytes > 0) {
+        row.metrics.push_back({ "Flops_per_Byte", flops / bytes });
+    }
+    row.metrics.push_back({ "Roofline(%)", percent });
+    row.metrics.push_back({ "Peak_GB_per_sec", point.bandwidth });
+    row.metrics.push_back({ "Peak_GFLOPS", point.gflops });
+}
+
+std::vector<Row> run_benchmarks(const Config& config, int& failures) {
+    std::vector<Row> rows;
+    failures = 0;
+
+    PerfCounters counters;
+    bool use_counters = config.counters;
+    Roofline roofline((size_t)config.stream_bytes);
+    const std::string bind = proc_bind_name();
+    const std::string places = places_name().empty() ? "-" : places_name();
+
+    for (const Kernel& kernel : registry()) {
+        if (!config.wants_kernel(kernel.name)) {
+            continue;
+        }
+        std::vector<std::string> variants;
+        for (const std::string& variant : kernel.variants) {
+            if (config.wants_variant(variant)) {
+                variants.push_back(variant);
+            }
+        }
+        if (variants.empty()) {
+            continue;
+        }
+
+        std::cerr << "\n=== " << kernel.name << ": " << kernel.description << " ===\n";
+        const std::map<std::string, std::string> params = kernel_params(kernel, config);
+        const std::vector<int64_t>& sizes = config.sizes.empty() ? kernel.default_sizes : config.sizes;
+
+        for (int64_t size : sizes) {
+            for (parallel_kernels::page_mode pages : config.pages) {
+                std::cerr << "\nРазмер: " << size;
+                if (config.pages.size() > 1 || pages != parallel_kernels::page_mode::normal) {
+                    std::cerr << ", страницы: " << parallel_kernels::page_mode_name(pages);
+                }
+                std::cerr << "\n";
+                // Режим действует на выделения при подготовке данных и в самих запусках.
+                parallel_kernels::set_page_mode(pages);
+                Workload workload = kernel.prepare(size, config);
+
+                // Эталон считается один раз на вариант, после его первой подготовки.
+                std::vector<double> references(variants.size(), 0.0);
+                std::vector<bool> has_reference(variants.size(), false);
+                auto reference_for = [&](size_t v) {
+                    if (!has_reference[v]) {
+                        if (workload.setup) {
+                            workload.setup(variants[v], 1);
+                        }
+                        references[v] = workload.reference ? workload.reference(variants[v])
+                            : workload.run(variants[v], 1).value;
+                        has_reference[v] = true;
+                    }
+                    return references[v];
+                };
+
+                // Ускорение считается по медианам относительно первого числа потоков в списке.
+                std::vector<double> base_time(variants.size(), 0.0);
+
+                for (int threads : config.threads) {
+                    for (size_t v = 0; v < variants.size(); v++) {
+                        const std::string& variant = variants[v];
+                        Row row;
+                        row.kernel = kernel.name;
+                        row.variant = variant;
+                        row.size = size;
+                        row.threads = threads;
+                        row.reference = reference_for(v);
+
+                        // Прогрев команды потоков нужного размера.
+#pragma omp parallel num_threads(threads)
+                        {
+                        }
+
+                        row.bind = bind;
+                        row.places = places;
+                        row.memory = memory_policy_name(memory_policy());
+                        row.pages = parallel_kernels::page_mode_name(pages);
+                        row.seed = std::to_string(config.seed);
+                        row.params = params;
+
+                        // Данные размещаются после первой подготовки варианта: часть ядер
+                        // строит их лениво в setup.
+                        if (workload.place) {
+                            if (workload.setup) {
+                                workload.setup(variant, threads);
+                            }
+                            workload.place(threads);
+                        }
+
+                        RunResult result;
+                        std::function<void()> setup;
+                        if (workload.setup) {
+                            setup = [&] { workload.setup(variant, threads); };
+                        }
+                        row.time = measure(config.timing, setup, [&] { result = workload.run(variant, threads); });
+                        if (workload.derive) {
+                            workload.derive(variant, threads, row.time, result);
+                        }
+                        row.result = result.value;
+                        row.metrics = result.metrics;
+
+                        // Формат строки отчёта восстанавливается: иначе точность и
+                        // fixed переходят в следующие сообщения (roofline, ядра).
+                        const std::ios::fmtflags flags = std::cerr.flags();
+                        const std::streamsize precision = std::cerr.precision();
+
+                        if (!matches_reference(row.result, row.reference, workload.tolerance)) {
+                            failures++;
+                            std::cerr << "   " << std::left << std::setw(20) << variant << std::right
+                                << "Потоков: " << std::setw(3) << threads << "    НЕВЕРНЫЙ РЕЗУЛЬТАТ: "
+                                << std::setprecision(17) << row.result << ", эталон " << row.reference << "\n";
+                            std::cerr.flags(flags);
+                            std::cerr.precision(precision);
+                            continue;
+                        }
+
+                        if (use_counters) {
+                            if (counters.attach(threads)) {
+                                collect_counters(counters, config, workload, variant, threads, size, row);
+                            }
+                            else {
+                                std::cerr << "   Аппаратные счётчики недоступны (" << counters.error()
+                                    << "), замеры продолжаются без них\n";
+                                use_counters = false;
+                            }
+                        }
+
+                        if (base_time[v] == 0.0) {
+                            base_time[v] = row.time.median;
+                        }
+                        row.speedup = row.time.median > 0 ? base_time[v] / row.time.median : 0.0;
+                        row.efficiency = row.speedup * config.threads.front() / threads * 100.0;
+
+                        if (config.roofline) {
+                            add_roofline_metrics(roofline, workload, variant, threads, row);
+                        }
+
+                        std::cerr << "   " << std::left << std::setw(20) << variant << std::right
+                            << "Потоков: " << std::setw(3) << threads
+                            << "    Время: " << std::fixed << std::setprecision(3) << std::setw(10) << row.time.median << " мс"
+                            << " ±" << std::setprecision(1) << std::setw(4) << row.time.rel_ci() * 100.0 << "%"
+                            << " (" << row.time.reps << " повт.)"
+                            << "    Ускорение: " << std::setprecision(2) << row.speedup << "x"
+                            << "    Эффективность: " << std::setprecision(1) << row.efficiency << "%\n";
+                        std::cerr.flags(flags);
+                        std::cerr.precision(precision);
+                        rows.push_back(std::move(row));
+                    }
+                }
+            }
+        }
+    }
+    parallel_kernels::set_page_mode(parallel_kernels::page_mode::normal);
+    return rows;
+}
+
+// Имена дополнительных колонок в порядке первого появления.
+static std::vector<std::string> metric_columns(const std::vector<Row>& rows) {
+    std::vector<std::string> columns;
+    for (const Row& row : rows) {
+        for (const auto& metric : row.metrics) {
+            if (std::find(columns.begin(), columns.end(), metric.first) == columns.end()) {
+                columns.push_back(metric.first);
+            }
+        }
+    }
+    return columns;
+}
+
+static std::string format_number(double value) {
+    if (!std::isfinite(value)) {
+        return "";
+    }
+    std::ostringstream out;
+    out << std::setprecision(10) << value;
+    return out.str();
+}
+
+// Поле в кавычках, если в нём есть запятая (списки OMP_PLACES).
+static std::string csv_field(const std::string& text) {
+    if (text.find_first_of(",\"") == std::string::npos) {
+        return text;
+    }
+    std::string quoted = "\"";
+    for (char c : text) {
+        quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+    }
+    return quoted + "\"";
+}
+
+void write_csv(std::ostream& out, const std::vector<Row>& rows) {
+    std::vector<std::string> columns = metric_columns(rows);
+
+    out << "Kernel,Variant,Size,Threads,Bind,Places,Memory,Pages,Seed,Params,Reps,Outliers,Time(ms),Mean(ms),P10(ms),P90(ms),CI95_Low(ms),CI95_High(ms),"
+        << "Rel_CI(%),Speedup,Efficiency(%),Result";
+    for (const std::string& column : columns) {
+        out << "," << column;
+    }
+    out << "\n";
+
+    for (const Row& row : rows) {
+        const Measurement& t = row.time;
+        out << row.kernel << "," << row.variant << "," << row.size << "," << row.threads << ","
+            << row.bind << "," << csv_field(row.places) << "," << row.memory << "," << row.pages << ","
+            << row.seed << "," << csv_field(format_params(row.params)) << "," << t.reps << "," << t.outliers << "," << format_number(t.median) << "," << format_number(t.mean) << ","
+            << format_number(t.p10) << "," << format_number(t.p90) << "," << format_number(t.ci_low) << ","
+            << format_number(t.ci_high) << "," << format_number(t.rel_ci() * 100.0) << ","
+            << format_number(row.speedup) << "," << format_number(row.efficiency) << "," << format_number(row.result);
+        for (const std::string& column : columns) {
+            out << ",";
+            for (const auto& metric : row.metrics) {
+                if (metric.first == column) {
+                    out << format_number(metric.second);
+                    break;
+                }
+            }
+        }
+        out << "\n";
+    }
+}
+
+static std::string json_string(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        default: escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+static std::string json_number(double value) {
+    std::string text = format_number(value);
+    return text.empty() ? "null" : text;
+}
+
+void write_json(std::ostream& out, const Config& config, const std::vector<Row>& rows) {
+    out << "{\n  \"config\": {\n    \"warmup\": " << config.timing.warmup
+        << ",\n    \"counters\": " << (config.counters ? "true" : "false")
+        << ",\n    \"proc_bind\": " << json_string(proc_bind_name())
+        << ",\n    \"places\": " << json_string(places_name())
+        << ",\n    \"num_places\": " << places_count()
+        << ",\n    \"memory\": " << json_string(memory_policy_name(config.memory))
+        << ",\n    \"huge_pages\": [";
+    for (size_t i = 0; i < config.pages.size(); i++) {
+        out << (i ? ", " : "") << json_string(parallel_kernels::page_mode_name(config.pages[i]));
+    }
+    out << "]"
+        << ",\n    \"numa_nodes\": " << numa_nodes()
+        << ",\n    \"roofline\": " << (config.roofline ? "true" : "false")
+        << ",\n    \"stream_bytes\": " << config.stream_bytes
+        << ",\n    \"min_reps\": " << config.timing.min_reps
+        << ",\n    \"max_reps\": " << config.timing.max_reps
+        << ",\n    \"target_rel_ci\": " << json_number(config.timing.target_rel_ci)
+        << ",\n    \"seed\": " << config.seed
+        << ",\n    \"data_cache\": " << json_string(config.data_cache)
+        << ",\n    \"max_threads\": " << omp_get_num_procs()
+        << ",\n    \"params\": {";
+    bool first = true;
+    for (const auto& item : config.params) {
+        out << (first ? "" : ", ") << json_string(item.first) << ": " << json_string(item.second);
+        first = false;
+    }
+    out << "}\n  },\n  \"results\": [";
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        out << (i ? "," : "") << "\n    {\"kernel\": " << json_string(row.kernel)
+            << ", \"variant\": " << json_string(row.variant)
+            << ", \"size\": " << row.size
+            << ", \"threads\": " << row.threads
+            << ", \"bind\": " << json_string(row.bind) << ", \"places\": " << json_string(row.places)
+            << ", \"memory\": " << json_string(row.memory)
+            << ", \"pages\": " << json_string(row.pages)
+            << ", \"seed\": " << json_string(row.seed)
+            << ", \"params\": " << json_string(format_params(row.params))
+            << ", \"reps\": " << row.time.reps
+            << ", \"outliers\": " << row.time.outliers
+            << ", \"time_ms\": " << json_number(row.time.median)
+            << ", \"mean_ms\": " << json_number(row.time.mean)
+            << ", \"p10_ms\": " << json_number(row.time.p10)
+            << ", \"p90_ms\": " << json_number(row.time.p90)
+            << ", \"ci95_ms\": [" << json_number(row.time.ci_low) << ", " << json_number(row.time.ci_high) << "]"
+            << ", \"speedup\": " << json_number(row.speedup)
+            << ", \"efficiency\": " << json_number(row.efficiency)
+            << ", \"result\": " << json_number(row.result)
+            << ", \"reference\": " << json_number(row.reference)
+            << ", \"metrics\": {";
+        for (size_t m = 0; m < row.metrics.size(); m++) {
+            out << (m ? ", " : "") << json_string(row.metrics[m].first) << ": " << json_number(row.metrics[m].second);
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}  // namespace bench
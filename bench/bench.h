@@ -0,0 +1,158 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "placement.h"
+#include "timing.h"
+
+// Общий драйвер бенчмарков ompbench.
+//
+// Каждая лабораторная регистрирует свои ядра через bench::Registrar. Ядро
+// описывает варианты (стратегии) и размеры по умолчанию, а prepare(size)
+// готовит входные данные и возвращает Workload, который драйвер запускает
+// для каждой комбинации потоков и варианта. Размеры, потоки, повторы, набор
+// ядер и формат вывода задаются из командной строки.
+//
+// Результат каждого запуска сверяется с эталоном последовательного алгоритма;
+// строка с неверным результатом не попадает в вывод.
+
+namespace bench {
+
+struct Config {
+    std::vector<std::string> kernels;    // шаблоны имён ядер, пусто - все
+    std::vector<std::string> variants;   // шаблоны вариантов, пусто - все
+    std::vector<int64_t> sizes;          // пусто - размеры ядра по умолчанию
+    std::vector<int> threads;
+    std::string bind;                    // OMP_PROC_BIND (--bind), пусто - не менять
+    std::string places;                  // OMP_PLACES (--places)
+    MemoryPolicy memory = MEMORY_DEFAULT;
+    // Режимы страниц данных ядра (--huge-pages): для каждого размера данные
+    // готовятся заново в каждом режиме.
+    std::vector<parallel_kernels::page_mode> pages = { parallel_kernels::page_mode::normal };
+    TimingOptions timing;
+    bool counters = false;               // аппаратные счётчики (--counters)
+    int counter_reps = 3;                // запусков для усреднения счётчиков
+    bool roofline = true;                // колонки roofline (--no-roofline)
+    int64_t stream_bytes = 128000000;    // байт на массив STREAM (--stream-size)
+    std::string format = "csv";
+    std::string output;                  // пусто - stdout
+    std::map<std::string, std::string> params;
+    std::vector<std::string> baselines;  // CSV для сравнения (--baseline)
+    std::string current;                 // сравнить этот CSV вместо прогона
+    double threshold = 0.05;             // порог регрессии (--threshold)
+    double noise = 0.03;                 // шум строк без ДИ (--noise)
+    unsigned seed = 1;
+    std::string data_cache = "ompbench_data";  // кэш входных данных (--data-cache), пусто - выключен
+    std::string tune_file;               // --tune: записать пороги include/tuning.hpp вместо прогона
+    bool list = false;
+    bool help = false;
+
+    bool wants_kernel(const std::string& name) const;
+    bool wants_variant(const std::string& name) const;
+
+    std::string param(const std::string& key, const std::string& fallback) const;
+    int64_t param_int(const std::string& key, int64_t fallback) const;
+    double param_double(const std::string& key, double fallback) const;
+};
+
+// Результат одного запуска: значение для CSV и дополнительные колонки ядра.
+struct RunResult {
+    double value = 0.0;
+    std::vector<std::pair<std::string, double>> metrics;
+
+    RunResult() = default;
+    RunResult(double v) : value(v) {}
+};
+
+struct Workload {
+    // Замеряемый запуск варианта.
+    std::function<RunResult(const std::string& variant, int threads)> run;
+    // Необязательная подготовка перед каждым повтором, в замер не входит.
+    std::function<void(const std::string& variant, int threads)> setup;
+    // Эталон последовательного алгоритма для варианта. Если не задан,
+    // эталоном служит результат того же варианта на одном потоке.
+    std::function<double(const std::string& variant)> reference;
+    // Допустимое относительное отклонение (абсолютное при |эталон| < 1).
+    double tolerance = 1e-9;
+    // Число обрабатываемых элементов за запуск для колонок *_per_Elem;
+    // по умолчанию равно размеру.
+    std::function<double(const std::string& variant)> elements;
+    // Байты, которые запуск читает и пишет в память, и число операций с
+    // плавающей точкой (сравнения min/max тоже считаются). По ним строка
+    // получает GB_per_sec, GFLOPS и процент от roofline; без них колонок нет.
+    std::function<double(const std::string& variant)> bytes;
+    std::function<double(const std::string& variant)> flops;
+    // Размещение данных ядра по текущей политике памяти (place_vector,
+    // place_rows) под статическое разбиение на threads потоков. Вызывается
+    // вне замера после подготовки варианта.
+    std::function<void(int threads)> place;
+    // Необязательные метрики по статистике замера, а не по последнему
+    // запуску: вызывается после замера и дополняет result.metrics (например,
+    // накладные расходы как медиана времени минус эталонная работа).
+    std::function<void(const std::string& variant, int threads, const Measurement& time, RunResult& result)> derive;
+};
+
+struct Kernel {
+    std::string name;
+    std::string description;
+    std::vector<std::string> variants;
+    std::vector<int64_t> default_sizes;
+    std::function<Workload(int64_t size, const Config& config)> prepare;
+    std::vector<std::string> params = {};   // описания параметров --param для --list
+};
+
+struct Row {
+    std::string kernel;
+    std::string variant;
+    int64_t size = 0;
+    int threads = 0;
+    std::string bind;                    // фактические привязка, места и политика памяти
+    std::string places;
+    std::string memory;
+    std::string pages = "off";          // режим страниц: off, thp, hugetlb
+    std::string seed;                    // seed данных; пусто - неизвестен (старые CSV)
+    std::map<std::string, std::string> params;  // значения --param ядра, с умолчаниями
+    Measurement time;                    // мс
+    double speedup = 0.0;                // по медианам
+    double efficiency = 0.0;
+    double result = 0.0;
+    double reference = 0.0;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+std::vector<Kernel>& registry();
+
+class Registrar {
+public:
+    explicit Registrar(Kernel kernel);
+};
+
+// Значения параметров, описанных в kernel.params ("имя=умолчание - ..."), с
+// учётом --param; у умолчаний вида a|b берётся первое.
+std::map<std::string, std::string> kernel_params(const Kernel& kernel, const Config& config);
+
+// "имя=значение;..." для CSV и обратно.
+std::string format_params(const std::map<std::string, std::string>& params);
+std::map<std::string, std::string> parse_params(const std::string& text);
+
+bool wildcard_match(const std::string& pattern, const std::string& text);
+std::vector<std::string> split(const std::string& text, char separator);
+
+bool parse_command_line(int argc, char** argv, Config& config, std::string& error);
+void print_usage(std::ostream& out);
+void print_kernels(std::ostream& out);
+
+// failures - число отброшенных строк с неверным результатом.
+std::vector<Row> run_benchmarks(const Config& config, int& failures);
+
+void write_csv(std::ostream& out, const std::vector<Row>& rows);
+void write_json(std::ostream& out, const Config& config, const std::vector<Row>& rows);
+
+}  // namespace bench
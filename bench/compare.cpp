@@ -0,0 +1,356 @@
+﻿#include "compare.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <tuple>
+
+namespace bench {
+
+// Поля строки CSV с учётом кавычек.
+static std::vector<std::string> parse_csv_line(const std::string& line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                i++;
+            }
+            else if (c == '"') {
+                quoted = false;
+            }
+            else {
+                fields.back() += c;
+            }
+        }
+        else if (c == '"') {
+            quoted = true;
+        }
+        else if (c == ',') {
+            fields.emplace_back();
+        }
+        else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+// Старые CSV лабораторных: заголовок, ядро, колонки варианта (через "/")
+// или фиксированные варианты по колонкам времени.
+struct LegacyTime {
+    const char* column;
+    const char* variant;
+};
+
+// Колонка старого CSV, которая соответствует параметру ядра.
+struct LegacyParam {
+    const char* column;
+    const char* name;
+};
+
+struct LegacySchema {
+    const char* header;
+    const char* kernel;
+    const char* size_column;
+    std::vector<const char*> variant_columns;
+    std::vector<LegacyTime> times;
+    double to_ms;
+    std::vector<LegacyParam> params = {};
+};
+
+static const std::vector<LegacySchema>& legacy_schemas() {
+    static const std::vector<LegacySchema> schemas = {
+        { "Size,Threads,Reduction_Time,Manual_Time,Speedup_Reduction,Efficiency_Reduction,Speedup_Manual,Efficiency_Manual",
+          "minmax", "Size", {}, { { "Reduction_Time", "max_reduction" }, { "Manual_Time", "max_manual" } }, 1.0 },
+        { "Threads,Size,Time(ms),Speedup,Efficiency(%)",
+          "scalar_product", "Size", {}, { { "Time(ms)", "atomic" } }, 1.0 },
+        { "Threads,Intervals,Time(ms),Result,Speedup,Efficiency(%)",
+          "integral", "Intervals", {}, { { "Time(ms)", "reduction" } }, 1.0 },
+        { "Threads,Size,Time(ms),Result,Speedup,Efficiency(%)",
+          "maximin", "Size", {}, { { "Time(ms)", "critical" } }, 1.0 },
+        { "Matrix_Type,Size,Threads,Strategy,Time(ms),Result,Speedup,Efficiency(%)",
+          "maximin_schedule", "Size", { "Matrix_Type", "Strategy" }, { { "Time(ms)", nullptr } }, 1.0 },
+        { "Schedule_Type,Vector_Size,Iterations,Threads,Time(ms),Speedup,Efficiency(%)",
+          "schedule", "Vector_Size", { "Schedule_Type" }, { { "Time(ms)", nullptr } }, 1.0,
+          { { "Iterations", "iterations" } } },
+        { "Method,Data_Size,Threads,Time(ms),Speedup,Efficiency(%),Result",
+          "reduction", "Data_Size", { "Method" }, { { "Time(ms)", nullptr } }, 1.0 },
+        { "Pairs,Vector_Size,Threads,Time(sec),Speedup,Efficiency",
+          "file_pipeline", "Vector_Size", {}, { { "Time(sec)", "sections" } }, 1000.0, { { "Pairs", "pairs" } } },
+    };
+    return schemas;
+}
+
+static std::string file_name(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool load_results(const std::string& path, std::vector<Row>& rows, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "не удалось открыть " + path;
+        return false;
+    }
+
+    std::string header_line;
+    std::getline(file, header_line);
+    if (header_line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        header_line.erase(0, 3);
+    }
+    if (!header_line.empty() && header_line.back() == '\r') {
+        header_line.pop_back();
+    }
+    std::vector<std::string> header = parse_csv_line(header_line);
+    std::map<std::string, size_t> column;
+    for (size_t i = 0; i < header.size(); i++) {
+        column[header[i]] = i;
+    }
+
+    const LegacySchema* legacy = nullptr;
+    bool native = column.count("Kernel") && column.count("Variant") && column.count("Size")
+        && column.count("Threads") && column.count("Time(ms)");
+    if (!native) {
+        for (const LegacySchema& schema : legacy_schemas()) {
+            if (header_line == schema.header) {
+                legacy = &schema;
+            }
+        }
+        if (!legacy) {
+            error = path + ": неизвестный формат CSV (" + header_line + ")";
+            return false;
+        }
+    }
+
+    auto number = [&](const std::vector<std::string>& fields, const std::string& name, double fallback) {
+        auto it = column.find(name);
+        if (it == column.end() || it->second >= fields.size() || fields[it->second].empty()) {
+            return fallback;
+        }
+        return std::atof(fields[it->second].c_str());
+    };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = parse_csv_line(line);
+        if (fields.size() < header.size()) {
+            continue;
+        }
+
+        if (native) {
+            Row row;
+            row.kernel = fields[column["Kernel"]];
+            row.variant = fields[column["Variant"]];
+            row.size = (int64_t)number(fields, "Size", 0);
+            row.threads = (int)number(fields, "Threads", 0);
+            if (column.count("Pages")) {
+                row.pages = fields[column["Pages"]];
+            }
+            if (column.count("Seed")) {
+                row.seed = fields[column["Seed"]];
+            }
+            if (column.count("Params")) {
+                row.params = parse_params(fields[column["Params"]]);
+            }
+            row.time.median = number(fields, "Time(ms)", 0.0);
+            row.time.mean = number(fields, "Mean(ms)", row.time.median);
+            row.time.reps = (int)number(fields, "Reps", 1);
+            row.time.outliers = (int)number(fields, "Outliers", 0);
+            row.time.ci_low = number(fields, "CI95_Low(ms)", row.time.mean);
+            row.time.ci_high = number(fields, "CI95_High(ms)", row.time.mean);
+            rows.push_back(row);
+            continue;
+        }
+
+        std::string variant;
+        for (const char* name : legacy->variant_columns) {
+            variant += (variant.empty() ? "" : "/") + fields[column[name]];
+        }
+        for (const LegacyTime& time : legacy->times) {
+            Row row;
+            row.kernel = legacy->kernel;
+            row.variant = time.variant ? time.variant : variant;
+            // min_result_omp1.csv отличается от max_ только именем файла.
+            if (row.kernel == "minmax" && file_name(path).compare(0, 4, "min_") == 0) {
+                row.variant.replace(0, 3, "min");
+            }
+            row.size = (int64_t)number(fields, legacy->size_column, 0);
+            row.threads = (int)number(fields, "Threads", 0);
+            for (const LegacyParam& param : legacy->params) {
+                row.params[param.name] = fields[column[param.column]];
+            }
+            row.time.median = row.time.mean = number(fields, time.column, 0.0) * legacy->to_ms;
+            row.time.reps = 1;
+            row.time.ci_low = row.time.ci_high = row.time.mean;
+            rows.push_back(row);
+        }
+    }
+    return true;
+}
+
+// Среднее и его стандартная ошибка со степенями свободы; для строк без ДИ -
+// допущение о шуме и нормальное приближение.
+static void mean_error(const Row& row, const CompareOptions& options, double& se, double& df) {
+    int n = row.time.reps - row.time.outliers;
+    if (n >= 2 && row.time.ci_high > row.time.ci_low) {
+        df = n - 1;
+        se = (row.time.ci_high - row.time.ci_low) / 2.0 / t_quantile_95(n - 1);
+    }
+    else {
+        df = 1000;
+        se = options.noise * row.time.mean;
+    }
+}
+
+typedef std::tuple<std::string, std::string, int64_t, int, std::string> RowKey;
+
+static RowKey row_key(const Row& row) {
+    return RowKey(row.kernel, row.variant, row.size, row.threads, row.pages);
+}
+
+// Seed и параметры не противоречат друг другу; отсутствующие - неизвестны.
+static bool same_workload(const Row& a, const Row& b) {
+    if (!a.seed.empty() && !b.seed.empty() && a.seed != b.seed) {
+        return false;
+    }
+    for (const auto& item : a.params) {
+        auto it = b.params.find(item.first);
+        if (it != b.params.end() && it->second != item.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string describe(const Row& row) {
+    std::string text = row.kernel + "/" + row.variant + ", размер " + std::to_string(row.size) + ", потоков "
+        + std::to_string(row.threads) + ", страницы " + row.pages;
+    if (!row.seed.empty()) {
+        text += ", seed " + row.seed;
+    }
+    if (!row.params.empty()) {
+        text += ", " + format_params(row.params);
+    }
+    return text;
+}
+
+bool check_unique(const std::vector<Row>& base, std::string& error) {
+    std::map<std::tuple<RowKey, std::string, std::map<std::string, std::string>>, const Row*> seen;
+    for (const Row& row : base) {
+        if (!seen.emplace(std::make_tuple(row_key(row), row.seed, row.params), &row).second) {
+            error = "в базе повторяется строка " + describe(row);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<Comparison> compare_results(const std::vector<Row>& base, const std::vector<Row>& current,
+    const CompareOptions& options, size_t& ambiguous) {
+    std::map<RowKey, std::vector<const Row*>> base_rows;
+    for (const Row& row : base) {
+        base_rows[row_key(row)].push_back(&row);
+    }
+
+    ambiguous = 0;
+    std::vector<Comparison> comparisons;
+    for (const Row& row : current) {
+        auto it = base_rows.find(row_key(row));
+        if (it == base_rows.end()) {
+            continue;
+        }
+        const Row* match = nullptr;
+        int candidates = 0;
+        for (const Row* candidate : it->second) {
+            if (same_workload(*candidate, row)) {
+                match = candidate;
+                candidates++;
+            }
+        }
+        if (candidates > 1) {
+            ambiguous++;
+            continue;
+        }
+        if (!match || match->time.mean <= 0) {
+            continue;
+        }
+        Comparison c;
+        c.base = *match;
+        c.current = row;
+        c.change = (row.time.mean - c.base.time.mean) / c.base.time.mean;
+
+        double se_base, df_base, se_new, df_new;
+        mean_error(c.base, options, se_base, df_base);
+        mean_error(c.current, options, se_new, df_new);
+        double variance = se_base * se_base + se_new * se_new;
+        if (variance > 0) {
+            c.t = (row.time.mean - c.base.time.mean) / std::sqrt(variance);
+            // Степени свободы по Уэлчу - Саттертуэйту.
+            double df = variance * variance
+                / (std::pow(se_base, 4) / df_base + std::pow(se_new, 4) / df_new);
+            c.significant = std::fabs(c.t) > t_quantile_95((int)std::max(1.0, std::floor(df)));
+        }
+        else {
+            c.significant = c.change != 0.0;
+        }
+        if (c.significant && std::fabs(c.change) > options.threshold) {
+            c.verdict = c.change > 0 ? 1 : -1;
+        }
+        comparisons.push_back(c);
+    }
+    return comparisons;
+}
+
+// setw считает байты, а заголовки в UTF-8: выравнивание по символам.
+static std::string pad(const std::string& text, size_t width, bool left = false) {
+    size_t length = 0;
+    for (unsigned char c : text) {
+        length += (c & 0xC0) != 0x80;
+    }
+    std::string spaces(width > length ? width - length : 0, ' ');
+    return left ? text + spaces : spaces + text;
+}
+
+int print_comparison(std::ostream& out, const std::vector<Comparison>& comparisons, size_t unmatched,
+    size_t ambiguous) {
+    int regressions = 0;
+    int improvements = 0;
+    std::string kernel;
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    for (const Comparison& c : comparisons) {
+        if (c.current.kernel != kernel) {
+            kernel = c.current.kernel;
+            out << "\n=== " << kernel << " ===\n"
+                << pad("Вариант", 22, true) << pad("Размер", 10) << pad("Потоки", 8) << pad("База, мс", 12)
+                << pad("Сейчас, мс", 12) << pad("Разница", 10) << pad("t", 8) << "  Итог\n";
+        }
+        const char* verdict = c.verdict > 0 ? "РЕГРЕССИЯ" : c.verdict < 0 ? "улучшение"
+            : c.significant ? "в пределах порога" : "не значимо";
+        regressions += c.verdict > 0;
+        improvements += c.verdict < 0;
+
+        out << std::left << std::setw(22) << c.current.variant << std::right << std::setw(10) << c.current.size
+            << std::setw(8) << c.current.threads << std::fixed << std::setprecision(3)
+            << std::setw(12) << c.base.time.mean << std::setw(12) << c.current.time.mean
+            << std::showpos << std::setprecision(1) << std::setw(9) << c.change * 100.0 << "%"
+            << std::setw(8) << c.t << std::noshowpos << "  " << verdict << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+
+    out << "\nСопоставлено строк: " << comparisons.size() << ", без пары в базе: " << unmatched;
+    if (ambiguous > 0) {
+        out << ", неоднозначных: " << ambiguous;
+    }
+    out << ", регрессий: " << regressions << ", улучшений: " << improvements << "\n";
+    return regressions;
+}
+
+}  // namespace bench
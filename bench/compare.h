@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+// Сравнение результатов с сохранённым базовым прогоном.
+//
+// Базой служат CSV самого ompbench или старые CSV лабораторных
+// (max/min_result_omp1.csv, results_omp2.csv ... result_omp8.csv): их колонки
+// переводятся в ядро, вариант, размер и число потоков ompbench. Строки
+// сопоставляются по этим четырём ключам и режиму страниц (у старых CSV - off),
+// а также по seed и параметрам ядра (колонки Seed и Params). Параметр или seed,
+// которого нет в одной из строк, считается неизвестным и совпадает с любым:
+// у старых CSV известны только параметры из их колонок (Pairs у
+// result_omp8.csv, Iterations у result_omp6.csv). Совпадающие во всём строки
+// базы - ошибка; если строке подходят несколько строк базы, она не
+// сравнивается и считается неоднозначной.
+//
+// Разница средних проверяется t-критерием Уэлча: стандартная ошибка берётся
+// из 95% доверительного интервала строки, а для строк без интервала (старые
+// CSV, один повтор) - из допущения об относительном шуме noise. Изменение
+// считается регрессией или улучшением, только если оно значимо и больше
+// порога threshold.
+
+namespace bench {
+
+struct CompareOptions {
+    double threshold = 0.05;   // практически значимое относительное изменение
+    double noise = 0.03;       // относительная стандартная ошибка строк без ДИ
+};
+
+struct Comparison {
+    Row base;
+    Row current;
+    double change = 0.0;       // (новое - базовое) / базовое по средним
+    double t = 0.0;
+    bool significant = false;
+    int verdict = 0;           // +1 регрессия, -1 улучшение, 0 без изменений
+};
+
+// CSV ompbench или одна из старых схем лабораторных.
+bool load_results(const std::string& path, std::vector<Row>& rows, std::string& error);
+
+// false и error, если в базе есть строки с одинаковыми ключами.
+bool check_unique(const std::vector<Row>& base, std::string& error);
+
+// ambiguous - число строк current, которым подходят несколько строк базы.
+std::vector<Comparison> compare_results(const std::vector<Row>& base, const std::vector<Row>& current,
+    const CompareOptions& options, size_t& ambiguous);
+
+// Таблица по ядрам; возвращает число регрессий.
+int print_comparison(std::ostream& out, const std::vector<Comparison>& comparisons, size_t unmatched,
+    size_t ambiguous);
+
+}  // namespace bench
@@ -0,0 +1,173 @@
+﻿#include "counters.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <omp.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+const char* counter_name(CounterEvent event) {
+    static const char* const names[COUNTER_EVENTS] = {
+        "Cycles", "Instructions", "LLC_Misses", "dTLB_Misses", "Branch_Misses"
+    };
+    return names[event];
+}
+
+void PerfCounters::close_all() {
+#ifdef __linux__
+    for (const std::vector<int>& thread_fds : fds) {
+        for (int fd : thread_fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+#endif
+    fds.clear();
+}
+
+#ifdef __linux__
+
+static void event_attr(CounterEvent event, perf_event_attr& attr) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (event) {
+    case COUNTER_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case COUNTER_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case COUNTER_LLC_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+        break;
+    case COUNTER_DTLB_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+        break;
+    default:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+}
+
+bool PerfCounters::attach(int threads) {
+    if (attached_threads() == threads) {
+        return true;
+    }
+    close_all();
+    fds.assign(threads, std::vector<int>(COUNTER_EVENTS, -1));
+
+    std::vector<int> open_errors(threads, 0);
+#pragma omp parallel num_threads(threads)
+    {
+        int thread = omp_get_thread_num();
+        for (int e = 0; e < COUNTER_EVENTS; e++) {
+            perf_event_attr attr;
+            event_attr((CounterEvent)e, attr);
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fd < 0) {
+                open_errors[thread] = errno;
+            }
+            fds[thread][e] = fd;
+        }
+    }
+
+    // Событие считается доступным, только если открылось на всех потоках.
+    bool any = false;
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        bool everywhere = true;
+        for (int t = 0; t < threads; t++) {
+            everywhere = everywhere && fds[t][e] >= 0;
+        }
+        if (!everywhere) {
+            for (int t = 0; t < threads; t++) {
+                if (fds[t][e] >= 0) {
+                    ::close(fds[t][e]);
+                    fds[t][e] = -1;
+                }
+            }
+        }
+        any = any || everywhere;
+    }
+
+    if (!any) {
+        int err = 0;
+        for (int e : open_errors) {
+            err = err ? err : e;
+        }
+        last_error = std::string("perf_event_open: ") + strerror(err);
+        close_all();
+    }
+    return any;
+}
+
+static void for_each_fd(const std::vector<std::vector<int>>& fds, unsigned long request) {
+    for (const std::vector<int>& thread_fds : fds) {
+        for (int fd : thread_fds) {
+            if (fd >= 0) {
+                ioctl(fd, request, 0);
+            }
+        }
+    }
+}
+
+void PerfCounters::reset() { for_each_fd(fds, PERF_EVENT_IOC_RESET); }
+void PerfCounters::enable() { for_each_fd(fds, PERF_EVENT_IOC_ENABLE); }
+void PerfCounters::disable() { for_each_fd(fds, PERF_EVENT_IOC_DISABLE); }
+
+CounterValues PerfCounters::read() const {
+    CounterValues values;
+    for (int e = 0; e < COUNTER_EVENTS; e++) {
+        values.valid[e] = !fds.empty() && fds[0][e] >= 0;
+    }
+    for (const std::vector<int>& thread_fds : fds) {
+        for (int e = 0; e < COUNTER_EVENTS; e++) {
+            uint64_t data[3] = {};   // value, time_enabled, time_running
+            if (thread_fds[e] < 0 || ::read(thread_fds[e], data, sizeof(data)) != (ssize_t)sizeof(data)) {
+                continue;
+            }
+            if (data[2] > 0) {
+                values.value[e] += (double)data[0] * ((double)data[1] / (double)data[2]);
+            }
+        }
+    }
+    return values;
+}
+
+#else
+
+bool PerfCounters::attach(int) {
+    last_error = "аппаратные счётчики поддерживаются только в Linux";
+    return false;
+}
+
+void PerfCounters::reset() {}
+void PerfCounters::enable() {}
+void PerfCounters::disable() {}
+
+CounterValues PerfCounters::read() const {
+    return CounterValues();
+}
+
+#endif
+
+}  // namespace bench
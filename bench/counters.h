@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+// Аппаратные счётчики через perf_event_open (только Linux).
+//
+// Счётчики открываются на каждом потоке команды OpenMP: внутри parallel
+// региона каждый поток открывает свои дескрипторы, а libgomp переиспользует
+// те же потоки в следующих регионах того же размера. Значения суммируются по
+// потокам и масштабируются на долю времени, когда счётчик был активен
+// (мультиплексирование). Потоки вне команды - вложенные регионы, потоки
+// чтения std::async и т.п. - не учитываются.
+//
+// Если perf_event_open недоступен (другая ОС, контейнер без прав,
+// perf_event_paranoid), attach возвращает false и замеры идут без счётчиков.
+
+namespace bench {
+
+enum CounterEvent {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_EVENTS
+};
+
+const char* counter_name(CounterEvent event);
+
+struct CounterValues {
+    double value[COUNTER_EVENTS] = {};
+    bool valid[COUNTER_EVENTS] = {};
+};
+
+class PerfCounters {
+private:
+    std::vector<std::vector<int>> fds;   // [поток][событие], -1 - не открыт
+    std::string last_error;
+
+    void close_all();
+
+public:
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters() { close_all(); }
+
+    // Открыть счётчики на потоках команды из threads потоков.
+    bool attach(int threads);
+    int attached_threads() const { return (int)fds.size(); }
+    const std::string& error() const { return last_error; }
+
+    void reset();
+    void enable();
+    void disable();
+    CounterValues read() const;
+};
+
+}  // namespace bench
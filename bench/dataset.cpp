@@ -0,0 +1,159 @@
+﻿#include "dataset.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+static const char DATASET_MAGIC[8] = { 'O', 'M', 'P', 'D', 'A', 'T', 'A', '1' };
+static const uint64_t DATASET_ALIGNMENT = 4096;
+static const size_t DATASET_MAX_RANK = 4;
+
+struct DatasetHeader {
+    char magic[8];
+    uint32_t element_size;
+    uint32_t rank;
+    int64_t shape[DATASET_MAX_RANK];
+    uint64_t seed;
+    uint64_t generator_hash;   // FNV-1a имени генератора
+    uint64_t data_offset;
+    uint64_t data_bytes;
+};
+
+static uint64_t fnv1a(const std::string& text) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static DatasetHeader make_header(const DatasetKey& key, size_t element_size) {
+    DatasetHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.element_size = (uint32_t)element_size;
+    header.rank = (uint32_t)std::min(key.shape.size(), DATASET_MAX_RANK);
+    uint64_t count = 1;
+    for (size_t d = 0; d < key.shape.size(); d++) {
+        if (d < DATASET_MAX_RANK) {
+            header.shape[d] = key.shape[d];
+        }
+        count *= (uint64_t)key.shape[d];
+    }
+    header.seed = key.seed;
+    header.generator_hash = fnv1a(key.generator);
+    header.data_offset = DATASET_ALIGNMENT;
+    header.data_bytes = count * element_size;
+    return header;
+}
+
+static std::string dataset_path(const std::string& dir, const DatasetKey& key) {
+    std::string name;
+    for (char c : key.generator) {
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '_';
+        name += safe ? c : '_';
+    }
+    name += '-';
+    for (size_t d = 0; d < key.shape.size(); d++) {
+        name += (d ? "x" : "") + std::to_string(key.shape[d]);
+    }
+    name += "-s" + std::to_string(key.seed) + ".bin";
+    return (std::filesystem::path(dir) / name).string();
+}
+
+bool load_dataset(const std::string& dir, const DatasetKey& key, size_t element_size,
+    const std::function<void(const char* data)>& consume) {
+    if (dir.empty() || key.shape.size() > DATASET_MAX_RANK) {
+        return false;
+    }
+    const std::string path = dataset_path(dir, key);
+    const DatasetHeader expected = make_header(key, element_size);
+    const uint64_t file_bytes = expected.data_offset + expected.data_bytes;
+
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != file_bytes) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, (size_t)file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    bool ok = std::memcmp(map, &expected, sizeof(expected)) == 0;
+    if (ok) {
+        madvise(map, (size_t)file_bytes, MADV_WILLNEED);
+        consume((const char*)map + expected.data_offset);
+    }
+    munmap(map, (size_t)file_bytes);
+    return ok;
+#else
+    std::ifstream file(path, std::ios::binary);
+    DatasetHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || std::memcmp(&header, &expected, sizeof(expected)) != 0) {
+        return false;
+    }
+    std::vector<char> data((size_t)expected.data_bytes);
+    file.seekg((std::streamoff)expected.data_offset);
+    if (!file.read(data.data(), (std::streamsize)data.size())) {
+        return false;
+    }
+    consume(data.data());
+    return true;
+#endif
+}
+
+bool store_dataset(const std::string& dir, const DatasetKey& key, size_t element_size,
+    const std::vector<std::pair<const void*, size_t>>& parts) {
+    if (dir.empty() || key.shape.size() > DATASET_MAX_RANK) {
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    const std::string path = dataset_path(dir, key);
+    const std::string temporary = path + ".tmp";
+    const DatasetHeader header = make_header(key, element_size);
+
+    bool ok;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        std::vector<char> padding((size_t)header.data_offset - sizeof(header), 0);
+        file.write(padding.data(), (std::streamsize)padding.size());
+        uint64_t written = 0;
+        for (const std::pair<const void*, size_t>& part : parts) {
+            file.write((const char*)part.first, (std::streamsize)part.second);
+            written += part.second;
+        }
+        ok = (bool)file && written == header.data_bytes;
+    }
+    if (ok) {
+        std::filesystem::rename(temporary, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(temporary, error);
+        std::cerr << "Не удалось сохранить данные в " << path << ", кэш не используется\n";
+        return false;
+    }
+    std::cerr << "Данные сохранены в " << path << " (" << header.data_bytes / 1048576.0 << " МБ)\n";
+    return true;
+}
+
+}  // namespace bench
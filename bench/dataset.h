@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+
+#include "bench.h"
+#include "huge_pages.hpp"
+
+// Входные данные ядер: детерминированные генераторы и кэш на диске.
+//
+// Значение элемента зависит только от (seed, поток, индекс), а не от порядка
+// генерации, поэтому массив заполняется параллельно и одинаково при любом
+// числе потоков. Кэш хранит сгенерированный массив в файле
+//   <каталог>/<генератор>-<форма>-s<seed>.bin
+// с заголовком и данными с границы страницы; при следующих запусках файл
+// отображается mmap и копируется в векторы ядра параллельным циклом
+// schedule(static), как при генерации. Вектор выделяется аллокатором
+// huge_vector, который не обнуляет элементы, поэтому первое касание каждой
+// страницы делает поток этого цикла, а не вызывающий. Строки матрицы
+// выделяются и заполняются внутри параллельного цикла.
+// Файл с несовпадающим заголовком перезаписывается, запись идёт через
+// временный файл и rename. Пустой каталог (--no-data-cache) отключает кэш.
+//
+// Генератор в ключе - имя распределения с версией: изменив распределение,
+// нужно сменить имя, иначе будут прочитаны старые данные.
+
+namespace bench {
+
+inline uint64_t random_bits(uint64_t seed, uint64_t stream, uint64_t index) {
+    uint64_t z = seed * 0xD1B54A32D192ED03ull + stream * 0xA0761D6478BD642Full + index * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Равномерное целое в [0, bound).
+inline uint32_t random_below(uint64_t bits, uint32_t bound) {
+    return (uint32_t)(((bits >> 32) * bound) >> 32);
+}
+
+struct DatasetKey {
+    std::string generator;
+    std::vector<int64_t> shape;
+    uint64_t seed;
+};
+
+// Отобразить файл набора и передать consume указатель на его данные; false,
+// если кэш выключен, файла нет или заголовок не совпадает с ключом.
+bool load_dataset(const std::string& dir, const DatasetKey& key, size_t element_size,
+    const std::function<void(const char* data)>& consume);
+
+// Записать набор из кусков (указатель, байты), идущих подряд.
+bool store_dataset(const std::string& dir, const DatasetKey& key, size_t element_size,
+    const std::vector<std::pair<const void*, size_t>>& parts);
+
+// Вектор из count значений fill(i). Alloc не должен инициализировать элементы
+// при выделении, иначе их обнулит вызывающий поток.
+template <typename T, typename Alloc = parallel_kernels::huge_page_allocator<T>, typename Fill>
+std::vector<T, Alloc> cached_vector(const Config& config, const std::string& generator, int64_t count, Fill fill) {
+    std::vector<T, Alloc> values((size_t)count);
+    const DatasetKey key{ generator, { count }, config.seed };
+    T* out = values.data();
+    bool loaded = load_dataset(config.data_cache, key, sizeof(T), [&](const char* data) {
+        const T* in = (const T*)data;
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < count; i++) {
+            out[i] = in[i];
+        }
+    });
+    if (!loaded) {
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < count; i++) {
+            out[i] = fill(i);
+        }
+        store_dataset(config.data_cache, key, sizeof(T), { { out, values.size() * sizeof(T) } });
+    }
+    return values;
+}
+
+// Матрица rows x cols строками из значений fill(i, j).
+template <typename T, typename Alloc = std::allocator<T>, typename Fill>
+std::vector<std::vector<T, Alloc>> cached_matrix(const Config& config, const std::string& generator, int64_t rows,
+    int64_t cols, Fill fill) {
+    std::vector<std::vector<T, Alloc>> matrix((size_t)rows);
+    const DatasetKey key{ generator, { rows, cols }, config.seed };
+    bool loaded = load_dataset(config.data_cache, key, sizeof(T), [&](const char* data) {
+        const T* in = (const T*)data;
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < rows; i++) {
+            matrix[i].assign(in + i * cols, in + (i + 1) * cols);
+        }
+    });
+    if (!loaded) {
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < rows; i++) {
+            matrix[i].resize((size_t)cols);
+            for (int64_t j = 0; j < cols; j++) {
+                matrix[i][j] = fill(i, j);
+            }
+        }
+        std::vector<std::pair<const void*, size_t>> parts;
+        for (const std::vector<T, Alloc>& row : matrix) {
+            parts.emplace_back(row.data(), row.size() * sizeof(T));
+        }
+        store_dataset(config.data_cache, key, sizeof(T), parts);
+    }
+    return matrix;
+}
+
+}  // namespace bench
@@ -0,0 +1,128 @@
+﻿#include "bench.h"
+#include "compare.h"
+#include "overhead.h"
+#include "shard.h"
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+
+    // Рабочий процесс ядра sharded: ompbench запускает его сам.
+    if (argc > 1 && std::string(argv[1]) == bench::SHARD_WORKER_FLAG) {
+        return bench::run_shard_worker(argc, argv);
+    }
+
+    bench::Config config;
+    std::string error;
+    if (!bench::parse_command_line(argc, argv, config, error)) {
+        std::cerr << "ompbench: " << error << "\n\n";
+        bench::print_usage(std::cerr);
+        return 2;
+    }
+    if (config.help) {
+        bench::print_usage(std::cout);
+        return 0;
+    }
+    if (config.list) {
+        bench::print_kernels(std::cout);
+        return 0;
+    }
+
+    // База загружается до прогона, чтобы ошибка в пути не стоила прогона.
+    std::vector<bench::Row> baseline;
+    for (const std::string& path : config.baselines) {
+        if (!bench::load_results(path, baseline, error)) {
+            std::cerr << "ompbench: " << error << "\n";
+            return 2;
+        }
+    }
+    if (!bench::check_unique(baseline, error)) {
+        std::cerr << "ompbench: " << error << "\n";
+        return 2;
+    }
+    bench::CompareOptions compare_options;
+    compare_options.threshold = config.threshold;
+    compare_options.noise = config.noise;
+
+    if (!config.current.empty()) {
+        std::vector<bench::Row> current;
+        if (!bench::load_results(config.current, current, error)) {
+            std::cerr << "ompbench: " << error << "\n";
+            return 2;
+        }
+        size_t ambiguous = 0;
+        std::vector<bench::Comparison> comparisons = bench::compare_results(baseline, current, compare_options, ambiguous);
+        int regressions = bench::print_comparison(std::cout, comparisons, current.size() - comparisons.size() - ambiguous,
+            ambiguous);
+        return regressions > 0 ? 4 : 0;
+    }
+
+    bench::apply_thread_binding(config, argv);
+    bench::set_memory_policy(config.memory);
+
+    if (!config.tune_file.empty()) {
+        if (!bench::write_tuning_file(config.tune_file, config, error)) {
+            std::cerr << "ompbench: " << error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    std::vector<bench::Row> rows;
+    int failures = 0;
+    try {
+        rows = bench::run_benchmarks(config, failures);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ompbench: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!config.output.empty()) {
+        file.open(config.output);
+        if (!file.is_open()) {
+            std::cerr << "ompbench: не удалось открыть " << config.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = config.output.empty() ? std::cout : file;
+
+    if (config.format == "json") {
+        bench::write_json(out, config, rows);
+    }
+    else {
+        bench::write_csv(out, rows);
+    }
+
+    if (!config.output.empty()) {
+        std::cerr << "\nРезультаты сохранены в " << config.output << "\n";
+    }
+    int regressions = 0;
+    if (!config.baselines.empty()) {
+        size_t ambiguous = 0;
+        std::vector<bench::Comparison> comparisons = bench::compare_results(baseline, rows, compare_options, ambiguous);
+        regressions = bench::print_comparison(std::cerr, comparisons, rows.size() - comparisons.size() - ambiguous,
+            ambiguous);
+    }
+
+    if (failures > 0) {
+        std::cerr << "ompbench: " << failures << " замеров с результатом, не совпавшим с эталоном\n";
+        return 3;
+    }
+    if (regressions > 0) {
+        std::cerr << "ompbench: " << regressions << " значимых замедлений относительно базы\n";
+        return 4;
+    }
+    return 0;
+}
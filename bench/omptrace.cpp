@@ -0,0 +1,274 @@
+﻿#include <omp-tools.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Трассировщик OMPT: временная шкала потоков в формате Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev).
+//
+// Записываются parallel регионы, неявные задачи, явные задачи (от запуска до
+// завершения или переключения), циклы и выдача порций итераций, ожидание на
+// барьерах, taskwait и taskgroup, ожидание замков, critical, atomic и ordered.
+//
+// Подключение: библиотека загружается runtime OpenMP по
+//   OMP_TOOL_LIBRARIES=/path/libomptrace.so ./ompbench ...
+// или линкуется в приложение (runtime находит ompt_start_tool среди символов
+// процесса). OMPT поддерживают LLVM libomp и Intel OpenMP; libgomp из GCC его
+// не реализует, поэтому программу, собранную GCC, запускают с libomp через
+// LD_PRELOAD: libomp экспортирует и точки входа GOMP_*.
+//
+// Файл задаёт OMPTRACE_FILE (по умолчанию omptrace.json), запись - при
+// завершении runtime. У каждого потока свой буфер событий, в который пишет
+// только он сам, без блокировок и атомарных операций; общий мьютекс берётся
+// лишь при регистрации потока. Событие - 32 байта и чтение steady_clock.
+
+namespace {
+
+enum EventName : uint16_t {
+    EVENT_PARALLEL,
+    EVENT_IMPLICIT_TASK,
+    EVENT_TASK,
+    EVENT_LOOP,
+    EVENT_SECTIONS,
+    EVENT_SINGLE,
+    EVENT_WORKSHARE,
+    EVENT_CHUNK,
+    EVENT_SECTION,
+    EVENT_BARRIER_WAIT,
+    EVENT_TASKWAIT_WAIT,
+    EVENT_TASKGROUP_WAIT,
+    EVENT_REDUCTION_WAIT,
+    EVENT_LOCK_WAIT,
+    EVENT_CRITICAL_WAIT,
+    EVENT_ATOMIC_WAIT,
+    EVENT_ORDERED_WAIT,
+    EVENT_NAMES
+};
+
+const char* const event_names[EVENT_NAMES] = {
+    "parallel", "implicit task", "task", "loop", "sections", "single", "workshare", "chunk", "section",
+    "barrier wait", "taskwait wait", "taskgroup wait", "reduction wait",
+    "lock wait", "critical wait", "atomic wait", "ordered wait"
+};
+
+// Фаза Chrome trace: 'B' - начало, 'E' - конец, 'i' - мгновенное событие.
+struct Event {
+    uint64_t time_ns;
+    uint64_t arg;
+    uint64_t id;
+    EventName name;
+    char phase;
+};
+
+struct ThreadBuffer {
+    int index;
+    ompt_thread_t type;
+    std::deque<Event> events;   // deque не копирует уже записанное при росте
+};
+
+// Буферы не разрушаются: libomp вызывает finalize из своего деструктора,
+// уже после статических объектов этой библиотеки.
+std::mutex& buffers_mutex = *new std::mutex;
+std::vector<std::unique_ptr<ThreadBuffer>>& buffers = *new std::vector<std::unique_ptr<ThreadBuffer>>;
+std::atomic<uint64_t> next_task_id(1);
+thread_local ThreadBuffer* current = nullptr;
+std::chrono::steady_clock::time_point start_time;
+ompt_set_callback_t set_callback = nullptr;
+
+ThreadBuffer* register_thread(ompt_thread_t type) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffers.emplace_back(new ThreadBuffer{ (int)buffers.size(), type, {} });
+    return buffers.back().get();
+}
+
+inline void record(EventName name, char phase, uint64_t arg = 0, uint64_t id = 0) {
+    if (!current) {
+        current = register_thread(ompt_thread_other);
+    }
+    uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    current->events.push_back(Event{ now, arg, id, name, phase });
+}
+
+inline char phase_of(ompt_scope_endpoint_t endpoint) {
+    return endpoint == ompt_scope_begin ? 'B' : 'E';
+}
+
+void on_thread_begin(ompt_thread_t type, ompt_data_t* thread_data) {
+    current = register_thread(type);
+    thread_data->ptr = current;
+}
+
+void on_parallel_begin(ompt_data_t*, const ompt_frame_t*, ompt_data_t*, unsigned int requested, int, const void*) {
+    record(EVENT_PARALLEL, 'B', requested);
+}
+
+void on_parallel_end(ompt_data_t*, ompt_data_t*, int, const void*) {
+    record(EVENT_PARALLEL, 'E');
+}
+
+void on_implicit_task(ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*, unsigned int actual,
+    unsigned int index, int flags) {
+    if (!(flags & ompt_task_initial)) {
+        record(EVENT_IMPLICIT_TASK, phase_of(endpoint), actual, index);
+    }
+}
+
+// Явным задачам присваивается номер; у неявных task_data->value остаётся 0.
+void on_task_create(ompt_data_t*, const ompt_frame_t*, ompt_data_t* new_task_data, int flags, int, const void*) {
+    if (flags & ompt_task_explicit) {
+        new_task_data->value = next_task_id.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void on_task_schedule(ompt_data_t* prior_task_data, ompt_task_status_t, ompt_data_t* next_task_data) {
+    if (prior_task_data && prior_task_data->value) {
+        record(EVENT_TASK, 'E', 0, prior_task_data->value);
+    }
+    if (next_task_data && next_task_data->value) {
+        record(EVENT_TASK, 'B', 0, next_task_data->value);
+    }
+}
+
+void on_work(ompt_work_t type, ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*, uint64_t count,
+    const void*) {
+    EventName name = EVENT_LOOP;
+    switch (type) {
+    case ompt_work_sections: name = EVENT_SECTIONS; break;
+    case ompt_work_single_executor:
+    case ompt_work_single_other: name = EVENT_SINGLE; break;
+    case ompt_work_workshare: name = EVENT_WORKSHARE; break;
+    default: break;
+    }
+    record(name, phase_of(endpoint), count);
+}
+
+void on_dispatch(ompt_data_t*, ompt_data_t*, ompt_dispatch_t kind, ompt_data_t instance) {
+    record(kind == ompt_dispatch_section ? EVENT_SECTION : EVENT_CHUNK, 'i', instance.value);
+}
+
+void on_sync_region_wait(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*,
+    const void*) {
+    EventName name = EVENT_BARRIER_WAIT;
+    switch (kind) {
+    case ompt_sync_region_taskwait: name = EVENT_TASKWAIT_WAIT; break;
+    case ompt_sync_region_taskgroup: name = EVENT_TASKGROUP_WAIT; break;
+    case ompt_sync_region_reduction: name = EVENT_REDUCTION_WAIT; break;
+    default: break;
+    }
+    record(name, phase_of(endpoint), kind);
+}
+
+EventName mutex_event(ompt_mutex_t kind) {
+    switch (kind) {
+    case ompt_mutex_critical: return EVENT_CRITICAL_WAIT;
+    case ompt_mutex_atomic: return EVENT_ATOMIC_WAIT;
+    case ompt_mutex_ordered: return EVENT_ORDERED_WAIT;
+    default: return EVENT_LOCK_WAIT;
+    }
+}
+
+// Ожидание - от запроса до захвата; время удержания не пишется.
+void on_mutex_acquire(ompt_mutex_t kind, unsigned int, unsigned int, ompt_wait_id_t wait_id, const void*) {
+    record(mutex_event(kind), 'B', wait_id);
+}
+
+void on_mutex_acquired(ompt_mutex_t kind, ompt_wait_id_t wait_id, const void*) {
+    record(mutex_event(kind), 'E', wait_id);
+}
+
+const char* thread_type_name(ompt_thread_t type) {
+    switch (type) {
+    case ompt_thread_initial: return "initial";
+    case ompt_thread_worker: return "worker";
+    default: return "other";
+    }
+}
+
+void write_trace() {
+    const char* path = std::getenv("OMPTRACE_FILE");
+    if (!path || !*path) {
+        path = "omptrace.json";
+    }
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        std::fprintf(stderr, "omptrace: не удалось открыть %s\n", path);
+        return;
+    }
+#ifdef __linux__
+    const long pid = (long)getpid();
+#else
+    const long pid = 1;
+#endif
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    size_t total = 0;
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char* separator = "";
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s %d\"}}", separator, pid, buffer->index, thread_type_name(buffer->type),
+            buffer->index);
+        separator = ",\n";
+        for (const Event& event : buffer->events) {
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%ld,\"tid\":%d,\"ts\":%.3f",
+                event_names[event.name], event.phase, pid, buffer->index, event.time_ns / 1000.0);
+            if (event.phase == 'i') {
+                std::fprintf(file, ",\"s\":\"t\"");
+            }
+            std::fprintf(file, ",\"args\":{\"arg\":%llu,\"id\":%llu}}",
+                (unsigned long long)event.arg, (unsigned long long)event.id);
+        }
+        total += buffer->events.size();
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+    std::fprintf(stderr, "omptrace: %zu событий, %zu потоков -> %s\n", total, buffers.size(), path);
+}
+
+template <typename Callback>
+void subscribe(ompt_callbacks_t event, Callback callback) {
+    set_callback(event, (ompt_callback_t)callback);
+}
+
+int initialize(ompt_function_lookup_t lookup, int, ompt_data_t*) {
+    set_callback = (ompt_set_callback_t)lookup("ompt_set_callback");
+    if (!set_callback) {
+        return 0;
+    }
+    start_time = std::chrono::steady_clock::now();
+    subscribe(ompt_callback_thread_begin, on_thread_begin);
+    subscribe(ompt_callback_parallel_begin, on_parallel_begin);
+    subscribe(ompt_callback_parallel_end, on_parallel_end);
+    subscribe(ompt_callback_implicit_task, on_implicit_task);
+    subscribe(ompt_callback_task_create, on_task_create);
+    subscribe(ompt_callback_task_schedule, on_task_schedule);
+    subscribe(ompt_callback_work, on_work);
+    subscribe(ompt_callback_dispatch, on_dispatch);
+    subscribe(ompt_callback_sync_region_wait, on_sync_region_wait);
+    subscribe(ompt_callback_mutex_acquire, on_mutex_acquire);
+    subscribe(ompt_callback_mutex_acquired, on_mutex_acquired);
+    return 1;
+}
+
+void finalize(ompt_data_t*) {
+    write_trace();
+}
+
+}  // namespace
+
+extern "C" ompt_start_tool_result_t* ompt_start_tool(unsigned int, const char*) {
+    static ompt_start_tool_result_t result = { &initialize, &finalize, { 0 } };
+    return &result;
+}
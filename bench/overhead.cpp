@@ -0,0 +1,386 @@
+﻿#include "overhead.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "bench.h"
+
+#ifdef _MSC_VER
+#define OVERHEAD_NOINLINE __declspec(noinline)
+#else
+#define OVERHEAD_NOINLINE __attribute__((noinline))
+#endif
+
+namespace bench {
+
+namespace {
+
+// Задержка EPCC: сложения float идут цепочкой, без -ffast-math цикл не
+// сворачивается и не векторизуется.
+OVERHEAD_NOINLINE void delay(int length) {
+    float a = 0.0f;
+    for (int i = 0; i < length; i++) {
+        a += (float)i;
+    }
+    if (a < 0) {
+        std::printf("%f", a);
+    }
+}
+
+// Эталонная работа: count задержек подряд на одном потоке.
+void run_delays(int64_t count, int length) {
+    for (int64_t i = 0; i < count; i++) {
+        delay(length);
+    }
+}
+
+// Эталон замеряется как обычный запуск (прогрев, повторы до нужного
+// доверительного интервала) один раз на число задержек: от варианта и
+// потоков он зависит только через count.
+typedef std::map<int64_t, Measurement> ReferenceCache;
+
+const Measurement& reference_time(ReferenceCache& cache, const TimingOptions& timing, int64_t count, int length) {
+    auto it = cache.find(count);
+    if (it == cache.end()) {
+        it = cache.emplace(count, measure(timing, nullptr, [=] { run_delays(count, length); })).first;
+    }
+    return it->second;
+}
+
+// Накладные расходы на конструкцию, мкс: разность медиан теста и эталона на
+// inner. Разность в пределах суммы полуширин 95% интервалов обоих замеров
+// неотличима от шума - below_noise; отрицательная обнуляется.
+struct Overhead {
+    double value;
+    double ci;
+    bool below_noise;
+};
+
+Overhead overhead_per_construct(const Measurement& time, const Measurement& reference, int64_t inner) {
+    const double half_width = (time.ci_high - time.ci_low + reference.ci_high - reference.ci_low) / 2.0;
+    const double difference = time.median - reference.median;
+    Overhead overhead;
+    overhead.value = std::max(0.0, difference) / inner * 1e3;
+    overhead.ci = half_width / inner * 1e3;
+    overhead.below_noise = difference <= half_width;
+    return overhead;
+}
+
+void add_overhead_metrics(const Overhead& overhead, RunResult& result) {
+    result.metrics.push_back({ "Overhead(us)", overhead.value });
+    result.metrics.push_back({ "Overhead_CI95(us)", overhead.ci });
+    result.metrics.push_back({ "Below_Noise", overhead.below_noise ? 1.0 : 0.0 });
+}
+
+// inner конструкций; каждый поток выполняет inner задержек, в critical и lock
+// задержки идут последовательно, поэтому на поток их inner / threads.
+void run_sync(const std::string& construct, int threads, int inner, int length) {
+    if (construct == "parallel") {
+        for (int j = 0; j < inner; j++) {
+#pragma omp parallel num_threads(threads)
+            delay(length);
+        }
+    }
+    else if (construct == "for") {
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner; j++) {
+#pragma omp for
+            for (int i = 0; i < threads; i++) {
+                delay(length);
+            }
+        }
+    }
+    else if (construct == "parallel_for") {
+        for (int j = 0; j < inner; j++) {
+#pragma omp parallel for num_threads(threads)
+            for (int i = 0; i < threads; i++) {
+                delay(length);
+            }
+        }
+    }
+    else if (construct == "barrier") {
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner; j++) {
+            delay(length);
+#pragma omp barrier
+        }
+    }
+    else if (construct == "single") {
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner; j++) {
+#pragma omp single
+            delay(length);
+        }
+    }
+    else if (construct == "critical") {
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner / threads; j++) {
+#pragma omp critical(syncbench)
+            delay(length);
+        }
+    }
+    else if (construct == "lock") {
+        omp_lock_t lock;
+        omp_init_lock(&lock);
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner / threads; j++) {
+            omp_set_lock(&lock);
+            delay(length);
+            omp_unset_lock(&lock);
+        }
+        omp_destroy_lock(&lock);
+    }
+    else if (construct == "atomic") {
+        double counter = 0.0;
+#pragma omp parallel num_threads(threads)
+        for (int j = 0; j < inner; j++) {
+            delay(length);
+#pragma omp atomic
+            counter += 1.0;
+        }
+        if (counter < 0) {
+            std::printf("%f", counter);
+        }
+    }
+    else {
+        int sum = 0;
+        for (int j = 0; j < inner; j++) {
+#pragma omp parallel num_threads(threads) reduction(+:sum)
+            {
+                delay(length);
+                sum += 1;
+            }
+        }
+        if (sum < 0) {
+            std::printf("%d", sum);
+        }
+    }
+}
+
+// Число задержек на критическом пути, по нему считается эталонное время.
+int sync_delays(const std::string& construct, int threads, int inner) {
+    return construct == "critical" || construct == "lock" ? inner / threads * threads : inner;
+}
+
+const char* const SYNC_CONSTRUCTS[] = {
+    "parallel", "for", "parallel_for", "barrier", "single", "critical", "lock", "atomic", "reduction"
+};
+
+Workload prepare_syncbench(int64_t size, const Config& config) {
+    const int inner = (int)size;
+    const int length = (int)config.param_int("delay", 100);
+    const TimingOptions timing = config.timing;
+    auto references = std::make_shared<ReferenceCache>();
+
+    Workload workload;
+    workload.setup = [=](const std::string& variant, int threads) {
+        reference_time(*references, timing, sync_delays(variant, threads, inner), length);
+    };
+    workload.run = [=](const std::string& variant, int threads) -> RunResult {
+        run_sync(variant, threads, inner, length);
+        return RunResult();
+    };
+    workload.derive = [=](const std::string& variant, int threads, const Measurement& time, RunResult& result) {
+        const int delays = sync_delays(variant, threads, inner);
+        const Measurement& reference = reference_time(*references, timing, delays, length);
+        add_overhead_metrics(overhead_per_construct(time, reference, inner), result);
+        result.metrics.push_back({ "Delay(us)", reference.median / delays * 1e3 });
+    };
+    workload.reference = [](const std::string&) { return 0.0; };
+    workload.elements = [size](const std::string&) { return (double)size; };
+    return workload;
+}
+
+// Вариант schedbench: "<static|dynamic|guided>[_<порция>]".
+void parse_schedule(const std::string& variant, std::string& kind, int& chunk) {
+    size_t sep = variant.find('_');
+    kind = variant.substr(0, sep);
+    chunk = sep == std::string::npos ? 0 : std::atoi(variant.c_str() + sep + 1);
+}
+
+// inner циклов по iterations * threads итерациям с задержкой в каждой.
+void run_sched(const std::string& kind, int chunk, int threads, int64_t iterations, int inner, int length) {
+    const int64_t n = iterations * threads;
+#pragma omp parallel num_threads(threads)
+    for (int j = 0; j < inner; j++) {
+        if (kind == "static" && chunk == 0) {
+#pragma omp for schedule(static)
+            for (int64_t i = 0; i < n; i++) {
+                delay(length);
+            }
+        }
+        else if (kind == "static") {
+#pragma omp for schedule(static, chunk)
+            for (int64_t i = 0; i < n; i++) {
+                delay(length);
+            }
+        }
+        else if (kind == "dynamic") {
+#pragma omp for schedule(dynamic, chunk)
+            for (int64_t i = 0; i < n; i++) {
+                delay(length);
+            }
+        }
+        else {
+#pragma omp for schedule(guided, chunk)
+            for (int64_t i = 0; i < n; i++) {
+                delay(length);
+            }
+        }
+    }
+}
+
+std::vector<std::string> schedbench_variants() {
+    std::vector<std::string> variants = { "static" };
+    for (const char* kind : { "static", "dynamic", "guided" }) {
+        for (int chunk : { 1, 4, 16, 64 }) {
+            variants.push_back(std::string(kind) + "_" + std::to_string(chunk));
+        }
+    }
+    return variants;
+}
+
+// Размер - итераций на поток. Per_Chunk(us) - накладные расходы цикла на
+// порцию, выданную потоку; у guided порции убывают, и делитель
+// iterations / chunk - верхняя оценка их числа.
+Workload prepare_schedbench(int64_t size, const Config& config) {
+    const int length = (int)config.param_int("delay", 500);
+    const int inner = (int)config.param_int("inner", 20);
+    const TimingOptions timing = config.timing;
+    auto references = std::make_shared<ReferenceCache>();
+
+    Workload workload;
+    workload.setup = [=](const std::string&, int) { reference_time(*references, timing, inner * size, length); };
+    workload.run = [=](const std::string& variant, int threads) -> RunResult {
+        std::string kind;
+        int chunk;
+        parse_schedule(variant, kind, chunk);
+        run_sched(kind, chunk, threads, size, inner, length);
+        return RunResult();
+    };
+    workload.derive = [=](const std::string& variant, int, const Measurement& time, RunResult& result) {
+        std::string kind;
+        int chunk;
+        parse_schedule(variant, kind, chunk);
+        const Measurement& reference = reference_time(*references, timing, inner * size, length);
+        const Overhead overhead = overhead_per_construct(time, reference, inner);
+        const double chunks = chunk == 0 ? 1.0 : std::ceil((double)size / chunk);
+        add_overhead_metrics(overhead, result);
+        result.metrics.push_back({ "Per_Chunk(us)", overhead.value / chunks });
+        result.metrics.push_back({ "Delay(us)", reference.median / (inner * size) * 1e3 });
+    };
+    workload.reference = [](const std::string&) { return 0.0; };
+    workload.elements = [size, inner](const std::string&) { return (double)size * inner; };
+    return workload;
+}
+
+const Registrar syncbench_registrar({
+    "syncbench", "EPCC syncbench: накладные расходы конструкций синхронизации OpenMP",
+    std::vector<std::string>(std::begin(SYNC_CONSTRUCTS), std::end(SYNC_CONSTRUCTS)),
+    { 1000 },
+    prepare_syncbench,
+    { "delay=100 - длина задержки внутри конструкции, сложений" }
+});
+
+const Registrar schedbench_registrar({
+    "schedbench", "EPCC schedbench: накладные расходы schedule static/dynamic/guided",
+    schedbench_variants(),
+    { 128, 1024 },
+    prepare_schedbench,
+    { "delay=500 - длина задержки на итерацию, сложений",
+      "inner=20 - циклов omp for за запуск" }
+});
+
+// Время элемента последовательного скалярного произведения double (векторы в
+// L2), мс: замер проходов по векторам, делённый на число элементов.
+Measurement dot_element_time(const TimingOptions& timing) {
+    const int N = 16384;
+    const int REPS = 200;
+    std::vector<double> a(N, 1.0), b(N, 0.5);
+    double sink = 0.0;
+    Measurement time = measure(timing, nullptr, [&] {
+        for (int r = 0; r < REPS; r++) {
+            double sum = 0.0;
+            for (int i = 0; i < N; i++) {
+                sum += a[i] * b[i];
+            }
+            sink += sum;
+        }
+    });
+    if (sink < 0) {
+        std::printf("%f", sink);
+    }
+    const double scale = 1.0 / ((double)REPS * N);
+    time.median *= scale;
+    time.ci_low *= scale;
+    time.ci_high *= scale;
+    return time;
+}
+
+// Порог n* = o / (c * (1 - 1/p)); o и c в мкс.
+int64_t parallel_cutoff(double overhead, double element, int threads) {
+    return (int64_t)std::ceil(overhead / (element * (1.0 - 1.0 / threads)));
+}
+
+}  // namespace
+
+bool write_tuning_file(const std::string& path, const Config& config, std::string& error) {
+    const int inner = 1000;
+    const int length = (int)config.param_int("delay", 100);
+    const Measurement element_time = dot_element_time(config.timing);
+    const double element = element_time.median * 1e3;
+    const double element_ci = (element_time.ci_high - element_time.ci_low) / 2.0 * 1e3;
+    std::cerr << "Элемент скалярного произведения: " << element * 1e3 << " нс\n";
+
+    std::vector<std::string> lines;
+    ReferenceCache references;
+    for (int p : config.threads) {
+        if (p < 2) {
+            continue;
+        }
+        // Тот же замер, что syncbench reduction: эталон задержек, затем конструкция.
+        const Measurement& reference = reference_time(references, config.timing, inner, length);
+        const Measurement time = measure(config.timing, nullptr, [=] { run_sync("reduction", p, inner, length); });
+        const Overhead overhead = overhead_per_construct(time, reference, inner);
+        // В пределах шума медиана ничего не говорит, порог берётся по верхней границе интервала.
+        const double used = overhead.below_noise ? overhead.value + overhead.ci : overhead.value;
+        const int64_t cutoff = parallel_cutoff(used, element, p);
+        std::cerr << "Потоков " << p << ": reduction " << overhead.value << " ± " << overhead.ci << " мкс"
+            << (overhead.below_noise ? " (в пределах шума)" : "") << ", порог " << cutoff << " элементов\n";
+        lines.push_back("# " + std::to_string(p) + " потоков: syncbench reduction " + std::to_string(overhead.value)
+            + " мкс, CI95 ±" + std::to_string(overhead.ci) + " мкс" + (overhead.below_noise ? ", в пределах шума" : "")
+            + "; элемент " + std::to_string(element * 1e3) + " нс, CI95 ±" + std::to_string(element_ci * 1e3)
+            + " нс; порог по CI " + std::to_string(parallel_cutoff(std::max(0.0, overhead.value - overhead.ci), element, p))
+            + ".." + std::to_string(parallel_cutoff(overhead.value + overhead.ci, element, p)));
+        lines.push_back("dot_product_cutoff " + std::to_string(p) + " " + std::to_string(cutoff));
+    }
+
+    std::ofstream file(path);
+    file << "# Пороги распараллеливания (ompbench --tune), формат: <имя> <потоков> <значение>\n";
+    file << "# Метод: накладные расходы syncbench reduction (inner " << inner << ", delay " << length
+         << ") - разность медиан конструкции и эталона задержек, делённая на inner;\n"
+         << "# порог n* = o / (c * (1 - 1/p)) по медиане o, по верхней границе CI95 - если o в пределах шума.\n";
+    for (const std::string& line : lines) {
+        file << line << "\n";
+    }
+    if (!file) {
+        error = "не удалось записать " + path;
+        return false;
+    }
+    std::cerr << "Пороги сохранены в " << path << "\n";
+    return true;
+}
+
+}  // namespace bench
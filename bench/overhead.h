@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <string>
+
+// Накладные расходы runtime OpenMP по методике EPCC (syncbench, schedbench).
+//
+// Каждая конструкция выполняется inner раз вокруг задержки - цикла из delay
+// сложений, который компилятор не сворачивает. Накладные расходы одной
+// конструкции - (медиана времени теста - медиана той же работы без OpenMP) /
+// inner. Работа без OpenMP замеряется на одном потоке с теми же повторами и
+// доверительным интервалом, что и тест, один раз на число задержек.
+// Разность в пределах шума обоих замеров помечается Below_Noise = 1, а
+// отрицательная обнуляется. Методика предполагает не больше потока на ядро:
+// иначе задержки потоков идут по очереди и попадают в накладные расходы.
+//
+// Ядра syncbench и schedbench регистрируются как обычные ядра ompbench,
+// поэтому потоки перебираются через --threads, а строки попадают в CSV с
+// колонками Overhead(us), Overhead_CI95(us), Below_Noise (и Per_Chunk(us) для
+// schedbench).
+//
+// write_tuning_file выводит пороги распараллеливания для include/tuning.hpp:
+// размер, с которого параллельный цикл со свёрткой обгоняет
+// последовательный, n* = o / (c * (1 - 1/p)), где o - накладные расходы
+// syncbench reduction на p потоках (тот же замер с эталоном и интервалом,
+// inner 1000, delay из --param delay), c - медиана времени элемента
+// последовательного скалярного произведения. Если o в пределах шума, порог
+// считается по верхней границе интервала. Интервалы o и c и диапазон порога
+// записываются в файл комментариями.
+
+namespace bench {
+
+struct Config;
+
+// Пороги для каждого числа потоков config.threads больше одного; false и
+// error при ошибке записи.
+bool write_tuning_file(const std::string& path, const Config& config, std::string& error);
+
+}  // namespace bench
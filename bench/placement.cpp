@@ -0,0 +1,244 @@
+﻿#include "placement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+
+#include "bench.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+static MemoryPolicy current_policy = MEMORY_DEFAULT;
+// Читается потоками регионов place_memory/place_row_memory, пока другой
+// поток может выставлять его в report_failure.
+static std::atomic<bool> policy_failed(false);
+
+bool parse_memory_policy(const std::string& name, MemoryPolicy& policy) {
+    for (int p = MEMORY_DEFAULT; p <= MEMORY_LOCAL; p++) {
+        if (name == memory_policy_name((MemoryPolicy)p)) {
+            policy = (MemoryPolicy)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* memory_policy_name(MemoryPolicy policy) {
+    static const char* const names[] = { "default", "first_touch", "interleave", "local" };
+    return names[policy];
+}
+
+void set_memory_policy(MemoryPolicy policy) {
+    current_policy = policy;
+    policy_failed = false;
+}
+
+MemoryPolicy memory_policy() {
+    return current_policy;
+}
+
+// true, если значение переменной изменилось.
+static bool set_env(const char* name, const std::string& value) {
+    if (value.empty()) {
+        return false;
+    }
+    const char* old = std::getenv(name);
+    if (old && value == old) {
+        return false;
+    }
+#ifdef _WIN32
+    _putenv_s(name, value.c_str());
+#else
+    setenv(name, value.c_str(), 1);
+#endif
+    return true;
+}
+
+void apply_thread_binding(const Config& config, char** argv) {
+    bool changed = set_env("OMP_PROC_BIND", config.bind);
+    changed = set_env("OMP_PLACES", config.places) || changed;
+#ifdef __linux__
+    if (changed) {
+        execv("/proc/self/exe", argv);
+        std::cerr << "ompbench: перезапуск с OMP_PROC_BIND/OMP_PLACES не удался (" << strerror(errno)
+            << "), привязка может не действовать\n";
+    }
+#else
+    (void)argv;
+    (void)changed;
+#endif
+}
+
+std::string proc_bind_name() {
+    switch (omp_get_proc_bind()) {
+    case omp_proc_bind_false: return "false";
+    case omp_proc_bind_true: return "true";
+    case omp_proc_bind_master: return "master";
+    case omp_proc_bind_close: return "close";
+    case omp_proc_bind_spread: return "spread";
+    default: return "unknown";
+    }
+}
+
+std::string places_name() {
+    const char* places = std::getenv("OMP_PLACES");
+    return places ? places : "";
+}
+
+int places_count() {
+    return omp_get_num_places();
+}
+
+#ifdef __linux__
+
+int numa_nodes() {
+    static int nodes = 0;
+    if (nodes == 0) {
+        DIR* dir = opendir("/sys/devices/system/node");
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+                    nodes++;
+                }
+            }
+            closedir(dir);
+        }
+        nodes = std::max(nodes, 1);
+    }
+    return nodes;
+}
+
+static int current_node() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return 0;
+    }
+    return (int)node;
+}
+
+static void report_failure(int error) {
+    // Сообщение печатает только поток, первым выставивший флаг.
+    if (!policy_failed.exchange(true)) {
+        std::cerr << "   mbind: " << strerror(error) << ", политика памяти "
+            << memory_policy_name(current_policy) << " не применяется\n";
+    }
+}
+
+// Перенести страницы [begin, end) по политике mode с маской узлов mask.
+static void bind_pages(uintptr_t begin, uintptr_t end, int mode, unsigned long mask) {
+    if (begin >= end || policy_failed) {
+        return;
+    }
+    const unsigned long max_node = sizeof(mask) * 8;
+    if (syscall(SYS_mbind, (void*)begin, end - begin, mode, &mask, max_node, MPOL_MF_MOVE) != 0) {
+        report_failure(errno);
+        return;
+    }
+    // Для first_touch и local политика диапазона возвращается к обычной:
+    // перенесённые страницы остаются на месте, новые - по первому касанию.
+    if (mode == MPOL_BIND) {
+        syscall(SYS_mbind, (void*)begin, end - begin, MPOL_DEFAULT, nullptr, 0, 0);
+    }
+}
+
+// Страница принадлежит куску, в который попадает её первый байт, кроме
+// первой страницы всего диапазона.
+static uintptr_t page_start(uintptr_t address, bool first) {
+    static const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    return first ? address & ~(page - 1) : (address + page - 1) & ~(page - 1);
+}
+
+// Маска в одно слово: до 63 узлов.
+static unsigned long all_nodes_mask() {
+    int nodes = std::min<int>(numa_nodes(), (int)(sizeof(unsigned long) * 8 - 1));
+    return (1ul << nodes) - 1;
+}
+
+void place_memory(void* data, size_t count, size_t size, int threads) {
+    if (current_policy == MEMORY_DEFAULT || policy_failed || count == 0) {
+        return;
+    }
+    const uintptr_t base = (uintptr_t)data;
+    const uintptr_t end = page_start(base + count * size, false);
+
+    if (current_policy == MEMORY_INTERLEAVE) {
+        bind_pages(page_start(base, true), end, MPOL_INTERLEAVE, all_nodes_mask());
+        return;
+    }
+    if (current_policy == MEMORY_LOCAL) {
+        bind_pages(page_start(base, true), end, MPOL_BIND, 1ul << current_node());
+        return;
+    }
+
+    // Границы куска каждого потока берутся из того же schedule(static), что
+    // и в ядрах, поэтому совпадают с их разбиением.
+#pragma omp parallel num_threads(threads)
+    {
+        int64_t first = -1;
+        int64_t last = -1;
+#pragma omp for schedule(static)
+        for (int64_t i = 0; i < (int64_t)count; i++) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+        if (first >= 0) {
+            uintptr_t chunk_begin = page_start(base + first * size, first == 0);
+            uintptr_t chunk_end = last + 1 == (int64_t)count ? end : page_start(base + (last + 1) * size, false);
+            bind_pages(chunk_begin, chunk_end, MPOL_BIND, 1ul << current_node());
+        }
+    }
+}
+
+void place_row_memory(const std::vector<void*>& rows, size_t row_bytes, int threads) {
+    if (current_policy == MEMORY_DEFAULT || policy_failed || row_bytes == 0) {
+        return;
+    }
+    if (current_policy != MEMORY_FIRST_TOUCH) {
+        for (void* row : rows) {
+            place_memory(row, row_bytes, 1, 1);
+        }
+        return;
+    }
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < (int64_t)rows.size(); i++) {
+        uintptr_t begin = (uintptr_t)rows[i];
+        bind_pages(page_start(begin, false), page_start(begin + row_bytes, false), MPOL_BIND, 1ul << current_node());
+    }
+}
+
+#else
+
+int numa_nodes() {
+    return 1;
+}
+
+void place_memory(void*, size_t, size_t, int) {
+    if (current_policy != MEMORY_DEFAULT && !policy_failed) {
+        policy_failed = true;
+        std::cerr << "   Политика памяти " << memory_policy_name(current_policy)
+            << " поддерживается только в Linux и не применяется\n";
+    }
+}
+
+void place_row_memory(const std::vector<void*>&, size_t, int) {
+    place_memory(nullptr, 0, 0, 0);
+}
+
+#endif
+
+}  // namespace bench
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Привязка потоков и размещение памяти по узлам NUMA.
+//
+// Привязка задаётся через OMP_PROC_BIND и OMP_PLACES. libgomp читает их один
+// раз при загрузке, поэтому в Linux ompbench выставляет переменные и
+// перезапускает себя; остальные среды читают их при первом обращении к
+// OpenMP.
+//
+// Политика памяти применяется к уже заполненным данным ядра перед замером
+// (Workload::place):
+//   first_touch - страницы каждого куска статического разбиения переносятся
+//                 на узел потока, который этот кусок обрабатывает, т.е. туда,
+//                 куда их положило бы параллельное первое касание;
+//   interleave  - страницы чередуются по всем узлам;
+//   local       - все страницы на узле главного потока;
+//   default     - данные не трогаются (первое касание генератора).
+// Без поддержки mbind (не Linux, ядро без NUMA) политика игнорируется с
+// одним предупреждением.
+
+namespace bench {
+
+struct Config;
+
+enum MemoryPolicy {
+    MEMORY_DEFAULT,
+    MEMORY_FIRST_TOUCH,
+    MEMORY_INTERLEAVE,
+    MEMORY_LOCAL
+};
+
+bool parse_memory_policy(const std::string& name, MemoryPolicy& policy);
+const char* memory_policy_name(MemoryPolicy policy);
+
+// Выставить OMP_PROC_BIND/OMP_PLACES из --bind/--places. В Linux при
+// изменении переменных процесс перезапускается с теми же аргументами и
+// функция не возвращается.
+void apply_thread_binding(const Config& config, char** argv);
+
+void set_memory_policy(MemoryPolicy policy);
+MemoryPolicy memory_policy();
+
+int numa_nodes();
+
+// Фактическая привязка по данным runtime: close, spread, master, true, false.
+std::string proc_bind_name();
+// OMP_PLACES или пусто и число мест по данным runtime.
+std::string places_name();
+int places_count();
+
+// Разместить count элементов по size байт согласно текущей политике; для
+// first_touch - по статическому разбиению индексов на threads потоков.
+void place_memory(void* data, size_t count, size_t size, int threads);
+
+// Строки матрицы одинаковой длины row_bytes, по строке на индекс.
+void place_row_memory(const std::vector<void*>& rows, size_t row_bytes, int threads);
+
+template <typename T, typename Alloc>
+void place_vector(std::vector<T, Alloc>& data, int threads) {
+    if (!data.empty()) {
+        place_memory(data.data(), data.size(), sizeof(T), threads);
+    }
+}
+
+// Матрица строками: при first_touch строка целиком уходит потоку, которому
+// достаётся её номер при статическом разбиении внешнего цикла.
+template <typename T, typename Alloc>
+void place_rows(std::vector<std::vector<T, Alloc>>& matrix, int threads) {
+    std::vector<void*> rows(matrix.size());
+    for (size_t i = 0; i < matrix.size(); i++) {
+        rows[i] = matrix[i].data();
+    }
+    place_row_memory(rows, matrix.empty() ? 0 : matrix[0].size() * sizeof(T), threads);
+}
+
+}  // namespace bench
@@ -0,0 +1,212 @@
+﻿#include "roofline.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <omp.h>
+
+#include "bench.h"
+
+namespace bench {
+
+namespace {
+
+struct StreamArrays {
+    size_t n;
+    std::unique_ptr<double[]> a, b, c;
+
+    // Без инициализации в конструкторе: страницы размещает параллельный цикл.
+    StreamArrays(size_t elements, int threads)
+        : n(elements), a(new double[elements]), b(new double[elements]), c(new double[elements]) {
+        double* pa = a.get();
+        double* pb = b.get();
+        double* pc = c.get();
+#pragma omp parallel for schedule(static) num_threads(threads)
+        for (int64_t i = 0; i < (int64_t)n; i++) {
+            pa[i] = 1.0;
+            pb[i] = 2.0;
+            pc[i] = 0.0;
+        }
+    }
+};
+
+const double STREAM_SCALAR = 3.0;
+
+void stream_copy(StreamArrays& s, int threads) {
+    const double* a = s.a.get();
+    double* c = s.c.get();
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < (int64_t)s.n; i++) {
+        c[i] = a[i];
+    }
+}
+
+void stream_scale(StreamArrays& s, int threads) {
+    const double* c = s.c.get();
+    double* b = s.b.get();
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < (int64_t)s.n; i++) {
+        b[i] = STREAM_SCALAR * c[i];
+    }
+}
+
+void stream_add(StreamArrays& s, int threads) {
+    const double* a = s.a.get();
+    const double* b = s.b.get();
+    double* c = s.c.get();
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < (int64_t)s.n; i++) {
+        c[i] = a[i] + b[i];
+    }
+}
+
+void stream_triad(StreamArrays& s, int threads) {
+    double* a = s.a.get();
+    const double* b = s.b.get();
+    const double* c = s.c.get();
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < (int64_t)s.n; i++) {
+        a[i] = b[i] + STREAM_SCALAR * c[i];
+    }
+}
+
+// Байт за один проход: чтения плюс запись.
+double stream_bytes(const std::string& variant, size_t n) {
+    return (variant == "add" || variant == "triad" ? 3.0 : 2.0) * sizeof(double) * n;
+}
+
+void run_stream_variant(const std::string& variant, StreamArrays& s, int threads) {
+    if (variant == "copy") stream_copy(s, threads);
+    else if (variant == "scale") stream_scale(s, threads);
+    else if (variant == "add") stream_add(s, threads);
+    else stream_triad(s, threads);
+}
+
+}  // namespace
+
+StreamResult run_stream(size_t elements, int threads, int reps) {
+    StreamArrays s(elements, threads);
+    double best[4];
+    std::fill(best, best + 4, std::numeric_limits<double>::max());
+    const char* const variants[4] = { "copy", "scale", "add", "triad" };
+
+    for (int rep = 0; rep < reps; rep++) {
+        for (int v = 0; v < 4; v++) {
+            double start = omp_get_wtime();
+            run_stream_variant(variants[v], s, threads);
+            best[v] = std::min(best[v], omp_get_wtime() - start);
+        }
+    }
+
+    StreamResult result;
+    result.copy = stream_bytes("copy", elements) / best[0] / 1e9;
+    result.scale = stream_bytes("scale", elements) / best[1] / 1e9;
+    result.add = stream_bytes("add", elements) / best[2] / 1e9;
+    result.triad = stream_bytes("triad", elements) / best[3] / 1e9;
+    return result;
+}
+
+double measure_peak_gflops(int threads) {
+    const int CHAINS = 16;
+    const int64_t ITERATIONS = 1 << 22;
+    double best = std::numeric_limits<double>::max();
+    double sink = 0.0;           // печатается при невозможном знаке, чтобы цикл не выбросили
+
+    for (int rep = 0; rep < 3; rep++) {
+        double start = omp_get_wtime();
+#pragma omp parallel num_threads(threads) reduction(+:sink)
+        {
+            double acc[CHAINS];
+            for (int j = 0; j < CHAINS; j++) {
+                acc[j] = 1.0 + j * 1e-3;
+            }
+            const double mul = 0.999999;
+            const double add = 1e-7;
+            for (int64_t it = 0; it < ITERATIONS; it++) {
+#pragma omp simd
+                for (int j = 0; j < CHAINS; j++) {
+                    acc[j] = acc[j] * mul + add;
+                }
+            }
+            for (int j = 0; j < CHAINS; j++) {
+                sink += acc[j];
+            }
+        }
+        best = std::min(best, omp_get_wtime() - start);
+    }
+
+    if (sink < 0) {
+        std::printf("%f", sink);
+    }
+    return 2.0 * CHAINS * ITERATIONS * threads / best / 1e9;
+}
+
+const RooflinePoint& Roofline::get(int threads) {
+    auto it = points.find(threads);
+    if (it != points.end()) {
+        return it->second;
+    }
+
+    RooflinePoint point;
+    StreamResult stream = run_stream(stream_elements, threads, 5);
+    point.bandwidth = stream.triad;
+    point.gflops = measure_peak_gflops(threads);
+
+    const std::ios::fmtflags flags = std::cerr.flags();
+    const std::streamsize precision = std::cerr.precision();
+    std::cerr << std::fixed << std::setprecision(1)
+        << "   [roofline, потоков " << threads << ": STREAM copy " << stream.copy
+        << ", scale " << stream.scale << ", add " << stream.add << ", triad " << stream.triad
+        << " ГБ/с; пик " << point.gflops << " ГФлоп/с]\n";
+    std::cerr.flags(flags);
+    std::cerr.precision(precision);
+    return points[threads] = point;
+}
+
+namespace {
+
+// STREAM как обычное ядро: по его строкам видно, насколько стабильна
+// пропускная способность и сколько даёт каждый следующий поток.
+Workload prepare_stream(int64_t size, const Config&) {
+    // Массивы создаются при первой подготовке, первым касанием той команды,
+    // что будет их обрабатывать.
+    auto arrays = std::make_shared<std::unique_ptr<StreamArrays>>();
+
+    Workload workload;
+    workload.setup = [arrays, size](const std::string&, int threads) {
+        if (!*arrays) {
+            arrays->reset(new StreamArrays((size_t)size, threads));
+        }
+    };
+    workload.run = [arrays](const std::string& variant, int threads) -> RunResult {
+        run_stream_variant(variant, **arrays, threads);
+        return 0.0;
+    };
+    workload.reference = [](const std::string&) { return 0.0; };
+    workload.place = [arrays, size](int threads) {
+        place_memory((*arrays)->a.get(), (size_t)size, sizeof(double), threads);
+        place_memory((*arrays)->b.get(), (size_t)size, sizeof(double), threads);
+        place_memory((*arrays)->c.get(), (size_t)size, sizeof(double), threads);
+    };
+    workload.bytes = [size](const std::string& variant) { return stream_bytes(variant, (size_t)size); };
+    workload.flops = [size](const std::string& variant) {
+        return variant == "copy" ? 0.0 : variant == "triad" ? 2.0 * size : (double)size;
+    };
+    return workload;
+}
+
+const Registrar stream_registrar({
+    "stream", "STREAM: устойчивая пропускная способность памяти",
+    { "copy", "scale", "add", "triad" },
+    { 1 << 20, 1 << 22, 1 << 24 },
+    prepare_stream
+});
+
+}  // namespace
+
+}  // namespace bench
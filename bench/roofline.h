@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <map>
+
+// Модель roofline: достижимая производительность min(P, I * B), где B -
+// устойчивая пропускная способность памяти (STREAM triad), P - пиковая
+// производительность FMA-цикла, I - арифметическая интенсивность ядра
+// (флопы на байт). Обе границы измеряются на этой машине для каждого числа
+// потоков один раз и кэшируются.
+//
+// Граница B - пропускная способность основной памяти, поэтому ядро, данные
+// которого помещаются в кэш, может показать Roofline(%) больше 100.
+
+namespace bench {
+
+struct StreamResult {
+    double copy = 0.0;     // ГБ/с: c = a
+    double scale = 0.0;    // b = s * c
+    double add = 0.0;      // c = a + b
+    double triad = 0.0;    // a = b + s * c
+};
+
+// Массивы по elements элементов double размещаются первым касанием с тем же
+// статическим разбиением, что и сами циклы; берётся лучшее время из reps.
+StreamResult run_stream(size_t elements, int threads, int reps);
+
+// ГФлоп/с независимых цепочек умножения-сложения на каждом потоке.
+double measure_peak_gflops(int threads);
+
+struct RooflinePoint {
+    double bandwidth = 0.0;   // ГБ/с, STREAM triad
+    double gflops = 0.0;      // пик ГФлоп/с
+};
+
+class Roofline {
+private:
+    std::map<int, RooflinePoint> points;
+    size_t stream_elements;
+
+public:
+    explicit Roofline(size_t stream_bytes_per_array)
+        : stream_elements(stream_bytes_per_array / sizeof(double)) {}
+
+    const RooflinePoint& get(int threads);
+};
+
+}  // namespace bench
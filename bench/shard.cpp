@@ -0,0 +1,630 @@
+﻿#include "shard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "bench.h"
+#include "dataset.h"
+#include "parallel_kernels.hpp"
+#include "placement.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace pk = parallel_kernels;
+
+namespace bench {
+
+const char* const SHARD_WORKER_FLAG = "--shard-worker";
+
+namespace {
+
+enum ShardOp { SHARD_MIN, SHARD_MAX, SHARD_SUM, SHARD_DOT, SHARD_MAXIMIN };
+
+const char* const SHARD_OP_NAMES[] = { "min", "max", "sum", "dot", "maximin" };
+
+bool parse_shard_op(const std::string& name, ShardOp& op) {
+    for (int k = SHARD_MIN; k <= SHARD_MAXIMIN; k++) {
+        if (name == SHARD_OP_NAMES[k]) {
+            op = (ShardOp)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Набор - rows x cols элементов по строкам; у векторов cols = 1. Процессы
+// делят строки: рабочему w достаются [rows * w / shards, rows * (w + 1) / shards).
+struct ShardDataset {
+    ShardOp op = SHARD_MIN;
+    int64_t rows = 0;
+    int64_t cols = 1;
+    uint64_t seed = 0;
+};
+
+// Второй вектор dot начинается с границы страницы.
+size_t second_offset(const ShardDataset& d) {
+    return ((size_t)(d.rows * d.cols) * sizeof(int) + 4095) / 4096 * 4096;
+}
+
+size_t dataset_bytes(const ShardDataset& d) {
+    const size_t n = (size_t)(d.rows * d.cols);
+    return d.op == SHARD_SUM ? n * sizeof(double) : d.op == SHARD_DOT ? second_offset(d) + n * sizeof(int)
+        : n * sizeof(int);
+}
+
+// Значения - как у ядер лабораторных: minmax, reduction, scalar_product, maximin.
+void fill_rows(const ShardDataset& d, char* base, int64_t begin, int64_t end, int threads) {
+    const int64_t first = begin * d.cols;
+    const int64_t last = end * d.cols;
+    const uint64_t seed = d.seed;
+    if (d.op == SHARD_SUM) {
+        double* values = (double*)base;
+#pragma omp parallel for schedule(static) num_threads(threads)
+        for (int64_t i = first; i < last; i++) {
+            values[i] = random_below(random_bits(seed, 0, (uint64_t)i), 1000) / 10.0;
+        }
+    }
+    else if (d.op == SHARD_DOT) {
+        int* a = (int*)base;
+        int* b = (int*)(base + second_offset(d));
+#pragma omp parallel for schedule(static) num_threads(threads)
+        for (int64_t i = first; i < last; i++) {
+            a[i] = (int)random_below(random_bits(seed, 1, (uint64_t)i), 1000);
+            b[i] = (int)random_below(random_bits(seed, 2, (uint64_t)i), 1000);
+        }
+    }
+    else {
+        const uint32_t bound = d.op == SHARD_MAXIMIN ? 10000 : 1000000000;
+        int* values = (int*)base;
+#pragma omp parallel for schedule(static) num_threads(threads)
+        for (int64_t i = first; i < last; i++) {
+            values[i] = (int)random_below(random_bits(seed, 0, (uint64_t)i), bound);
+        }
+    }
+}
+
+// Ядро над строками [begin, end); пустой диапазон даёт нейтральный элемент.
+double compute_rows(const ShardDataset& d, const char* base, int64_t begin, int64_t end, int threads) {
+    const int64_t first = begin * d.cols;
+    const int64_t count = (end - begin) * d.cols;
+    switch (d.op) {
+    case SHARD_MIN:
+        return pk::min((const int*)base + first, count, threads);
+    case SHARD_MAX:
+        return pk::max((const int*)base + first, count, threads);
+    case SHARD_SUM:
+        return pk::sum((const double*)base + first, count, threads);
+    case SHARD_DOT:
+        return (double)pk::dot<pk::builtin_combine, pk::static_schedule, long long>(
+            (const int*)base + first, (const int*)(base + second_offset(d)) + first, count, threads);
+    default: {
+        const int* matrix = (const int*)base;
+        const int64_t cols = d.cols;
+        return pk::max_of_row_mins(end - begin, [=](int64_t i) {
+            const int* row = matrix + (begin + i) * cols;
+            return *std::min_element(row, row + cols);
+        }, threads);
+    }
+    }
+}
+
+double combine(ShardOp op, double a, double b) {
+    return op == SHARD_MIN ? std::min(a, b) : op == SHARD_SUM || op == SHARD_DOT ? a + b : std::max(a, b);
+}
+
+// Последовательный эталон по всему набору.
+double serial_reference(const ShardDataset& d, const char* base) {
+    const int64_t n = d.rows * d.cols;
+    if (d.op == SHARD_SUM) {
+        const double* values = (const double*)base;
+        double sum = 0.0;
+        for (int64_t i = 0; i < n; i++) {
+            sum += values[i];
+        }
+        return sum;
+    }
+    if (d.op == SHARD_DOT) {
+        const int* a = (const int*)base;
+        const int* b = (const int*)(base + second_offset(d));
+        long long sum = 0;
+        for (int64_t i = 0; i < n; i++) {
+            sum += (long long)a[i] * b[i];
+        }
+        return (double)sum;
+    }
+    const int* values = (const int*)base;
+    if (d.op == SHARD_MAXIMIN) {
+        int result = std::numeric_limits<int>::min();
+        for (int64_t i = 0; i < d.rows; i++) {
+            result = std::max(result, *std::min_element(values + i * d.cols, values + (i + 1) * d.cols));
+        }
+        return result;
+    }
+    int result = values[0];
+    for (int64_t i = 1; i < n; i++) {
+        result = d.op == SHARD_MIN ? std::min(result, values[i]) : std::max(result, values[i]);
+    }
+    return result;
+}
+
+int shard_threads(int threads, int shards, int index) {
+    return std::max(1, threads / shards + (index < threads % shards ? 1 : 0));
+}
+
+#ifdef __linux__
+
+const int MAX_SHARDS = 64;
+const size_t SHARD_NAME_SIZE = 64;
+
+enum ShardCommand { COMMAND_FILL, COMMAND_RUN, COMMAND_QUIT };
+
+// Узел дерева свёртки: start - команда рабочему, ready - его частичный
+// результат value готов для процесса-родителя в дереве.
+struct alignas(64) ShardNode {
+    sem_t start;
+    sem_t ready;
+    double value;
+};
+
+// Управляющий сегмент; команду пишет родитель до sem_post(start).
+struct ShardControl {
+    sem_t done;
+    int shards;
+    int command;
+    int threads;
+    ShardDataset dataset;
+    char dataset_name[SHARD_NAME_SIZE];
+    ShardNode nodes[MAX_SHARDS];
+};
+
+void wait_semaphore(sem_t* semaphore) {
+    while (sem_wait(semaphore) != 0 && errno == EINTR) {
+    }
+}
+
+// Сегмент shared memory; владелец удаляет имя в деструкторе.
+class SharedSegment {
+public:
+    SharedSegment(const std::string& name, size_t bytes, bool create) : name_(name), bytes_(bytes), owner_(create) {
+        int fd = shm_open(name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open " + name + ": " + strerror(errno));
+        }
+        if (create && ftruncate(fd, (off_t)bytes) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("ftruncate " + name + ": " + strerror(error));
+        }
+        data_ = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            if (create) {
+                shm_unlink(name.c_str());
+            }
+            throw std::runtime_error("mmap " + name + ": " + strerror(error));
+        }
+    }
+    ~SharedSegment() {
+        munmap(data_, bytes_);
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+    }
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    char* data() const { return (char*)data_; }
+    const std::string& name() const { return name_; }
+
+private:
+    std::string name_;
+    size_t bytes_;
+    bool owner_;
+    void* data_ = nullptr;
+};
+
+std::string segment_name(const std::string& suffix) {
+    static int sequence = 0;
+    return "/ompbench." + std::to_string(getpid()) + "." + std::to_string(sequence++) + "." + suffix;
+}
+
+// Номера процессоров из списка вида "0-3,8-11".
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    for (const std::string& part : split(text, ',')) {
+        int first = 0, last = 0;
+        int fields = std::sscanf(part.c_str(), "%d-%d", &first, &last);
+        if (fields == 1) {
+            last = first;
+        }
+        for (int cpu = first; fields >= 1 && cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Наборы процессоров рабочих: процессы делят узлы NUMA поровну подряд, а
+// процессоры узла (из доступных процессу) - поровну между его процессами.
+std::vector<std::vector<int>> shard_cpu_sets(int shards) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<std::vector<int>> groups;
+    for (int node = 0; node < numa_nodes(); node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string line;
+        std::getline(file, line);
+        std::vector<int> cpus;
+        for (int cpu : parse_cpu_list(line)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            groups.push_back(cpus);
+        }
+    }
+    if (groups.empty()) {
+        groups.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                groups.back().push_back(cpu);
+            }
+        }
+    }
+
+    const int count = (int)groups.size();
+    std::vector<std::vector<int>> sets((size_t)shards);
+    for (int w = 0; w < shards; w++) {
+        const int group = (int)((int64_t)w * count / shards);
+        // Процессы группы - подряд идущие w с тем же group.
+        int first = w, last = w;
+        while (first > 0 && (int64_t)(first - 1) * count / shards == group) {
+            first--;
+        }
+        while (last + 1 < shards && (int64_t)(last + 1) * count / shards == group) {
+            last++;
+        }
+        const std::vector<int>& cpus = groups[group];
+        const int64_t k = last - first + 1;
+        const int64_t j = w - first;
+        const int64_t len = (int64_t)cpus.size();
+        int64_t begin = len * j / k;
+        int64_t end = len * (j + 1) / k;
+        if (begin == end) {
+            begin = j % len;
+            end = begin + 1;
+        }
+        sets[w].assign(cpus.begin() + begin, cpus.begin() + end);
+    }
+    return sets;
+}
+
+std::string describe_cpus(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t k = 0; k < cpus.size(); k++) {
+        size_t run = k;
+        while (run + 1 < cpus.size() && cpus[run + 1] == cpus[run] + 1) {
+            run++;
+        }
+        text += (text.empty() ? "" : ",") + std::to_string(cpus[k]);
+        if (run > k) {
+            text += "-" + std::to_string(cpus[run]);
+        }
+        k = run;
+    }
+    return text;
+}
+
+// Рабочие процессы и управляющий сегмент. Деструктор завершает рабочих
+// командой QUIT; если родитель погибнет, рабочие получат SIGTERM.
+class ShardPool {
+public:
+    ShardPool(int shards, bool pin)
+        : control_segment_(segment_name("control"), sizeof(ShardControl), true),
+          control_((ShardControl*)control_segment_.data()) {
+        control_->shards = shards;
+        sem_init(&control_->done, 1, 0);
+        for (int w = 0; w < shards; w++) {
+            sem_init(&control_->nodes[w].start, 1, 0);
+            sem_init(&control_->nodes[w].ready, 1, 0);
+        }
+
+        std::vector<std::vector<int>> sets = pin ? shard_cpu_sets(shards) : std::vector<std::vector<int>>();
+        std::vector<char> name(control_segment_.name().begin(), control_segment_.name().end());
+        name.push_back('\0');
+        for (int w = 0; w < shards; w++) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (pin) {
+                for (int cpu : sets[w]) {
+                    CPU_SET(cpu, &set);
+                }
+                std::cerr << "Шард " << w << ": CPU " << describe_cpus(sets[w]) << "\n";
+            }
+            std::string index = std::to_string(w);
+            char* args[] = { (char*)"ompbench", (char*)SHARD_WORKER_FLAG, name.data(), (char*)index.c_str(), nullptr };
+            pid_t pid = fork();
+            if (pid == 0) {
+                prctl(PR_SET_PDEATHSIG, SIGTERM);
+                if (pin) {
+                    sched_setaffinity(0, sizeof(set), &set);
+                }
+                execv("/proc/self/exe", args);
+                _exit(127);
+            }
+            if (pid < 0) {
+                int error = errno;
+                stop();
+                throw std::runtime_error(std::string("fork: ") + strerror(error));
+            }
+            pids_.push_back(pid);
+        }
+    }
+    ~ShardPool() {
+        stop();
+        sem_destroy(&control_->done);
+        for (int w = 0; w < control_->shards; w++) {
+            sem_destroy(&control_->nodes[w].start);
+            sem_destroy(&control_->nodes[w].ready);
+        }
+    }
+    ShardPool(const ShardPool&) = delete;
+    ShardPool& operator=(const ShardPool&) = delete;
+
+    int shards() const { return control_->shards; }
+
+    // Команда всем рабочим и результат свёртки по дереву.
+    double execute(ShardCommand command, const SharedSegment& data, const ShardDataset& dataset, int threads) {
+        control_->command = command;
+        control_->threads = threads;
+        control_->dataset = dataset;
+        std::snprintf(control_->dataset_name, SHARD_NAME_SIZE, "%s", data.name().c_str());
+        for (int w = 0; w < (int)pids_.size(); w++) {
+            sem_post(&control_->nodes[w].start);
+        }
+        // Ожидание с проверкой, что рабочие живы: упавший процесс не
+        // опубликует результат, и без проверки родитель ждал бы вечно.
+        for (;;) {
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            if (sem_timedwait(&control_->done, &deadline) == 0) {
+                return control_->nodes[0].value;
+            }
+            if (errno != ETIMEDOUT && errno != EINTR) {
+                throw std::runtime_error(std::string("sem_timedwait: ") + strerror(errno));
+            }
+            for (size_t w = 0; w < pids_.size(); w++) {
+                int status;
+                if (pids_[w] > 0 && waitpid(pids_[w], &status, WNOHANG) == pids_[w]) {
+                    pids_[w] = -1;
+                    throw std::runtime_error("рабочий процесс шарда " + std::to_string(w) + " завершился");
+                }
+            }
+        }
+    }
+
+private:
+    void stop() {
+        control_->command = COMMAND_QUIT;
+        for (size_t w = 0; w < pids_.size(); w++) {
+            sem_post(&control_->nodes[w].start);
+        }
+        for (pid_t pid : pids_) {
+            if (pid > 0) {
+                waitpid(pid, nullptr, 0);
+            }
+        }
+        pids_.clear();
+    }
+
+    SharedSegment control_segment_;
+    ShardControl* control_;
+    std::vector<pid_t> pids_;
+};
+
+// Свёртка частичных результатов по дереву; корень будит родителя.
+void reduce_tree(ShardControl* control, int index, double value) {
+    const int shards = control->shards;
+    for (int step = 1; step < shards; step *= 2) {
+        if (index % (2 * step) != 0) {
+            control->nodes[index].value = value;
+            sem_post(&control->nodes[index].ready);
+            return;
+        }
+        if (index + step < shards) {
+            wait_semaphore(&control->nodes[index + step].ready);
+            value = combine(control->dataset.op, value, control->nodes[index + step].value);
+        }
+    }
+    control->nodes[0].value = value;
+    sem_post(&control->done);
+}
+
+struct ShardState {
+    std::unique_ptr<ShardPool> pool;
+    std::map<std::string, ShardDataset> datasets;
+    std::map<std::string, std::unique_ptr<SharedSegment>> segments;
+};
+
+// Вариант - "<операция>/<process|sharded>". size - число элементов; у maximin
+// матрица size / cols строк по cols элементов.
+Workload prepare_sharded(int64_t size, const Config& config) {
+    const int shards = (int)config.param_int("shards", 2);
+    const bool pin = config.param_int("pin", 1) != 0;
+    const int64_t cols = config.param_int("cols", 1000);
+    if (shards < 1 || shards > MAX_SHARDS) {
+        throw std::runtime_error("shards должно быть от 1 до " + std::to_string(MAX_SHARDS));
+    }
+    if (cols < 1) {
+        throw std::runtime_error("cols должно быть положительным");
+    }
+    auto state = std::make_shared<ShardState>();
+
+    auto split_variant = [](const std::string& variant) {
+        size_t slash = variant.find('/');
+        return std::make_pair(variant.substr(0, slash), variant.substr(slash + 1));
+    };
+
+    Workload workload;
+    // Набор операции создаётся при первом обращении и заполняется рабочими,
+    // каждым свою часть.
+    workload.setup = [=](const std::string& variant, int threads) {
+        if (!state->pool) {
+            state->pool.reset(new ShardPool(shards, pin));
+        }
+        const std::string op_name = split_variant(variant).first;
+        if (state->segments.count(op_name) == 0) {
+            ShardDataset d;
+            if (!parse_shard_op(op_name, d.op)) {
+                throw std::runtime_error("неизвестная операция: " + op_name);
+            }
+            d.cols = d.op == SHARD_MAXIMIN ? cols : 1;
+            d.rows = std::max<int64_t>(1, size / d.cols);
+            d.seed = config.seed;
+            std::unique_ptr<SharedSegment> segment(new SharedSegment(segment_name(op_name), dataset_bytes(d), true));
+            state->pool->execute(COMMAND_FILL, *segment, d, threads);
+            state->datasets[op_name] = d;
+            state->segments[op_name] = std::move(segment);
+        }
+    };
+    workload.run = [=](const std::string& variant, int threads) -> RunResult {
+        auto parts = split_variant(variant);
+        const ShardDataset& d = state->datasets.at(parts.first);
+        const SharedSegment& segment = *state->segments.at(parts.first);
+        RunResult result;
+        if (parts.second == "process") {
+            result.value = compute_rows(d, segment.data(), 0, d.rows, threads);
+        }
+        else {
+            result.value = state->pool->execute(COMMAND_RUN, segment, d, threads);
+        }
+        result.metrics.push_back({ "Shards", parts.second == "process" ? 1.0 : (double)shards });
+        return result;
+    };
+    workload.reference = [=](const std::string& variant) {
+        const std::string op_name = split_variant(variant).first;
+        return serial_reference(state->datasets.at(op_name), state->segments.at(op_name)->data());
+    };
+    auto elements = [=](const std::string& variant) {
+        return split_variant(variant).first == "maximin" ? (double)(std::max<int64_t>(1, size / cols) * cols)
+            : (double)size;
+    };
+    workload.elements = elements;
+    workload.bytes = [=](const std::string& variant) {
+        const std::string op = split_variant(variant).first;
+        return elements(variant) * (op == "sum" || op == "dot" ? 8.0 : 4.0);
+    };
+    workload.flops = [=](const std::string& variant) {
+        return elements(variant) * (split_variant(variant).first == "dot" ? 2.0 : 1.0);
+    };
+    return workload;
+}
+
+#else
+
+Workload prepare_sharded(int64_t, const Config&) {
+    throw std::runtime_error("шардированный режим поддерживается только в Linux");
+}
+
+#endif
+
+std::vector<std::string> sharded_variants() {
+    std::vector<std::string> variants;
+    for (const char* op : SHARD_OP_NAMES) {
+        for (const char* mode : { "process", "sharded" }) {
+            variants.push_back(std::string(op) + "/" + mode);
+        }
+    }
+    return variants;
+}
+
+const Registrar sharded_registrar({
+    "sharded", "Min/max, сумма, скалярное произведение и максимин в нескольких процессах над shared memory",
+    sharded_variants(),
+    { 1000000, 10000000 },
+    prepare_sharded,
+    { "shards=2 - число рабочих процессов",
+      "pin=1 - привязать процессы к узлам NUMA / частям ядер (0 - без привязки)",
+      "cols=1000 - длина строки матрицы maximin" }
+});
+
+}  // namespace
+
+int run_shard_worker(int argc, char** argv) {
+#ifdef __linux__
+    if (argc < 4) {
+        std::cerr << "ompbench: " << SHARD_WORKER_FLAG << " <сегмент> <номер>\n";
+        return 2;
+    }
+    const int index = std::atoi(argv[3]);
+    try {
+        SharedSegment control_segment(argv[2], sizeof(ShardControl), false);
+        ShardControl* control = (ShardControl*)control_segment.data();
+        std::unique_ptr<SharedSegment> data;
+        for (;;) {
+            wait_semaphore(&control->nodes[index].start);
+            if (control->command == COMMAND_QUIT) {
+                return 0;
+            }
+            const ShardDataset& d = control->dataset;
+            if (!data || data->name() != control->dataset_name) {
+                data.reset();
+                data.reset(new SharedSegment(control->dataset_name, dataset_bytes(d), false));
+            }
+            const int shards = control->shards;
+            const int threads = shard_threads(control->threads, shards, index);
+            const int64_t begin = d.rows * index / shards;
+            const int64_t end = d.rows * (index + 1) / shards;
+            double value = 0.0;
+            if (control->command == COMMAND_FILL) {
+                fill_rows(d, data->data(), begin, end, threads);
+            }
+            else {
+                value = compute_rows(d, data->data(), begin, end, threads);
+            }
+            reduce_tree(control, index, value);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ompbench: шард " << index << ": " << e.what() << "\n";
+        return 1;
+    }
+#else
+    (void)argc;
+    (void)argv;
+    std::cerr << "ompbench: шардированный режим поддерживается только в Linux\n";
+    return 1;
+#endif
+}
+
+}  // namespace bench
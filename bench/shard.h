@@ -0,0 +1,33 @@
+﻿#pragma once
+
+// Шардированный режим: ядро выполняют несколько процессов ompbench над общим
+// набором данных в POSIX shared memory.
+//
+// Один процесс OpenMP на несколько сокетов масштабируется плохо: потоки
+// делят один runtime, барьеры и свёртки идут через межсокетные линии. Ядро
+// sharded запускает shards рабочих процессов (fork и exec самого ompbench с
+// SHARD_WORKER_FLAG), каждый привязан к своему набору ядер: к узлу NUMA,
+// если узлов не меньше процессов, иначе к части ядер узла. Рабочий отображает
+// сегмент набора, сам заполняет свою часть (страницы получают первое
+// касание на его узле) и выполняет на ней ядро parallel_kernels своими
+// threads / shards потоками. Частичные результаты объединяются деревом в
+// управляющем сегменте: на шаге s процесс с номером, кратным 2s, ждёт
+// семафор процесса +s и объединяет его значение со своим, остальные
+// публикуют своё и выходят; корень будит родителя. Глубина дерева -
+// ceil(log2(shards)).
+//
+// Операции: min, max (int), sum (double), dot (int с накоплением в long long)
+// и maximin (матрица int по строкам). Вариант "<операция>/process" - то же
+// ядро в одном процессе всеми потоками над тем же сегментом, для сравнения.
+//
+// Только Linux: на других системах ядро сообщает об ошибке.
+
+namespace bench {
+
+// Первый аргумент рабочего процесса: ompbench --shard-worker <сегмент> <номер>.
+extern const char* const SHARD_WORKER_FLAG;
+
+// Цикл рабочего процесса; код возврата для main.
+int run_shard_worker(int argc, char** argv);
+
+}  // namespace bench
@@ -0,0 +1,124 @@
+﻿#include "timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+namespace bench {
+
+double t_quantile_95(int degrees_of_freedom) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degrees_of_freedom < 1) {
+        return 0.0;
+    }
+    if (degrees_of_freedom <= 30) {
+        return table[degrees_of_freedom - 1];
+    }
+    if (degrees_of_freedom <= 60) {
+        return 2.000;
+    }
+    return degrees_of_freedom <= 120 ? 1.980 : 1.960;
+}
+
+// Линейная интерполяция между порядковыми статистиками.
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    double position = fraction * (values.size() - 1);
+    size_t lower = (size_t)position;
+    size_t upper = std::min(lower + 1, values.size() - 1);
+    return values[lower] + (values[upper] - values[lower]) * (position - lower);
+}
+
+Measurement summarize(const std::vector<double>& samples, double outlier_z) {
+    Measurement m;
+    m.reps = (int)samples.size();
+    if (samples.empty()) {
+        return m;
+    }
+
+    double median = percentile(samples, 0.5);
+    std::vector<double> deviations;
+    for (double x : samples) {
+        deviations.push_back(std::fabs(x - median));
+    }
+    double mad = percentile(deviations, 0.5);
+
+    // Модифицированный z-score: 0.6745 * |x - median| / MAD.
+    for (double x : samples) {
+        if (mad > 0 && 0.6745 * std::fabs(x - median) / mad > outlier_z) {
+            m.outliers++;
+        }
+        else {
+            m.samples.push_back(x);
+        }
+    }
+
+    const size_t n = m.samples.size();
+    m.median = percentile(m.samples, 0.5);
+    m.p10 = percentile(m.samples, 0.1);
+    m.p90 = percentile(m.samples, 0.9);
+
+    double sum = 0.0;
+    for (double x : m.samples) {
+        sum += x;
+    }
+    m.mean = sum / n;
+
+    double half_width = 0.0;
+    if (n > 1) {
+        double squares = 0.0;
+        for (double x : m.samples) {
+            squares += (x - m.mean) * (x - m.mean);
+        }
+        double stddev = std::sqrt(squares / (n - 1));
+        half_width = t_quantile_95((int)n - 1) * stddev / std::sqrt((double)n);
+    }
+    else {
+        half_width = std::fabs(m.mean);
+    }
+    m.ci_low = m.mean - half_width;
+    m.ci_high = m.mean + half_width;
+    return m;
+}
+
+Measurement measure(const TimingOptions& options, const std::function<void()>& setup,
+    const std::function<void()>& run) {
+    for (int i = 0; i < options.warmup; i++) {
+        if (setup) {
+            setup();
+        }
+        run();
+    }
+
+    std::vector<double> samples;
+    double started = omp_get_wtime();
+    Measurement m;
+
+    for (;;) {
+        if (setup) {
+            setup();
+        }
+        double start = omp_get_wtime();
+        run();
+        samples.push_back((omp_get_wtime() - start) * 1000.0);
+
+        int count = (int)samples.size();
+        if (count < options.min_reps) {
+            continue;
+        }
+        m = summarize(samples, options.outlier_z);
+        if (count >= options.max_reps || m.rel_ci() <= options.target_rel_ci
+            || omp_get_wtime() - started >= options.max_time) {
+            return m;
+        }
+    }
+}
+
+}  // namespace bench
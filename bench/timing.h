@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <functional>
+#include <vector>
+
+// Замер с прогревом и статистикой.
+//
+// Перед замером команда потоков и данные прогреваются warmup запусками вне
+// замера. Затем запуски повторяются, пока относительная полуширина 95%
+// доверительного интервала среднего не станет меньше target_rel_ci (но не
+// меньше min_reps и не больше max_reps запусков или max_time секунд).
+// Выбросы отбрасываются по модифицированному z-score через медиану и MAD.
+
+namespace bench {
+
+struct TimingOptions {
+    int warmup = 1;
+    int min_reps = 5;
+    int max_reps = 100;
+    double target_rel_ci = 0.02;
+    double max_time = 5.0;          // сек на один замер, после min_reps
+    double outlier_z = 3.5;
+};
+
+struct Measurement {
+    std::vector<double> samples;    // мс, без выбросов
+    int reps = 0;                   // всего замеренных запусков
+    int outliers = 0;
+    double median = 0.0;
+    double mean = 0.0;
+    double p10 = 0.0;
+    double p90 = 0.0;
+    double ci_low = 0.0;
+    double ci_high = 0.0;
+
+    double rel_ci() const { return mean > 0 ? (ci_high - ci_low) / 2.0 / mean : 0.0; }
+};
+
+// Квантиль t-распределения Стьюдента для двустороннего 95% интервала.
+double t_quantile_95(int degrees_of_freedom);
+
+double percentile(std::vector<double> values, double fraction);
+
+// Статистика по сырым замерам (мс) с отбрасыванием выбросов.
+Measurement summarize(const std::vector<double>& samples, double outlier_z);
+
+// setup вызывается перед каждым запуском вне замера, run - замеряемый запуск.
+Measurement measure(const TimingOptions& options, const std::function<void()>& setup,
+    const std::function<void()>& run);
+
+}  // namespace bench
@@ -0,0 +1,296 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include "parallel_kernels.hpp"
+#endif
+
+// Исполнители для ядер: OpenMP, собственный пул std::thread и
+// последовательный.
+//
+// Все три предоставляют один и тот же набор методов, и ядро пишется как
+// шаблон над исполнителем:
+//   parallel_for(n, f)                   - f(i) для i из [0, n);
+//   parallel_reduce(n, init, op, value)  - свёртка value(i) операцией op;
+//   parallel_sections(f1, f2, ...)       - независимые функции параллельно;
+//   concurrency()                        - число потоков.
+//
+// pool_backend не использует runtime OpenMP (для сервисов, где он мешает:
+// fork, второй runtime в процессе), openmp_backend собирается только при
+// включённом OpenMP. Потоки пула создаются при первом запросе и живут до
+// разрушения пула; вызывающий поток работает как участник 0. Пул не
+// реентерабелен: один run за раз.
+
+namespace execution {
+
+namespace detail {
+
+constexpr size_t CACHE_LINE = 64;
+
+template <typename T>
+struct alignas(CACHE_LINE) Slot {
+    T value;
+};
+
+}  // namespace detail
+
+class thread_pool {
+private:
+    std::vector<std::thread> workers;      // участники 1..workers.size()
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int participants = 0;
+    int remaining = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void worker_loop(int id) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            if (id >= participants) {
+                continue;
+            }
+            const std::function<void(int)>* current = job;
+            lock.unlock();
+            (*current)(id);
+            lock.lock();
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    void ensure_workers(int count) {
+        while ((int)workers.size() < count) {
+            int id = (int)workers.size() + 1;
+            workers.emplace_back([this, id] { worker_loop(id); });
+        }
+    }
+
+public:
+    thread_pool() = default;
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // job(id) на count участниках, id = 0 - вызывающий поток.
+    void run(int count, const std::function<void(int)>& task) {
+        if (count <= 1) {
+            task(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ensure_workers(count - 1);
+            job = &task;
+            participants = count;
+            remaining = count - 1;
+            generation++;
+        }
+        wake.notify_all();
+        task(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return remaining == 0; });
+    }
+
+    static thread_pool& instance() {
+        static thread_pool pool;
+        return pool;
+    }
+};
+
+enum class partition {
+    static_blocks,     // непрерывный блок n / threads на участника
+    dynamic_chunks     // порции chunk из общего атомарного счётчика
+};
+
+class pool_backend {
+private:
+    thread_pool* pool;
+    int threads;
+    partition kind;
+    int64_t chunk;
+
+    template <typename F>
+    void for_share(int64_t n, int id, std::atomic<int64_t>& next, F& f) const {
+        if (kind == partition::static_blocks) {
+            int64_t begin = n * id / threads;
+            int64_t end = n * (id + 1) / threads;
+            for (int64_t i = begin; i < end; i++) {
+                f(i);
+            }
+            return;
+        }
+        for (int64_t begin = next.fetch_add(chunk); begin < n; begin = next.fetch_add(chunk)) {
+            int64_t end = std::min(n, begin + chunk);
+            for (int64_t i = begin; i < end; i++) {
+                f(i);
+            }
+        }
+    }
+
+public:
+    explicit pool_backend(int threads, partition kind = partition::static_blocks, int64_t chunk = 1,
+        thread_pool& pool = thread_pool::instance())
+        : pool(&pool), threads(std::max(1, threads)), kind(kind), chunk(std::max<int64_t>(1, chunk)) {}
+
+    int concurrency() const { return threads; }
+
+    template <typename F>
+    void parallel_for(int64_t n, F f) const {
+        std::atomic<int64_t> next(0);
+        pool->run(threads, [&](int id) { for_share(n, id, next, f); });
+    }
+
+    template <typename T, typename Op, typename Value>
+    T parallel_reduce(int64_t n, T init, Op op, Value value) const {
+        std::vector<detail::Slot<T>> slots((size_t)threads, detail::Slot<T>{ T() });
+        std::vector<char> used((size_t)threads, 0);
+        std::atomic<int64_t> next(0);
+        pool->run(threads, [&](int id) {
+            bool first = true;
+            T local = T();
+            auto accumulate = [&](int64_t i) {
+                local = first ? (T)value(i) : op(local, (T)value(i));
+                first = false;
+            };
+            for_share(n, id, next, accumulate);
+            slots[id].value = local;
+            used[id] = !first;
+        });
+        T result = init;
+        for (int id = 0; id < threads; id++) {
+            if (used[id]) {
+                result = op(result, slots[id].value);
+            }
+        }
+        return result;
+    }
+
+    template <typename... F>
+    void parallel_sections(F&&... sections) const {
+        std::function<void()> list[] = { std::function<void()>(sections)... };
+        const int64_t count = (int64_t)sizeof...(F);
+        std::atomic<int64_t> next(0);
+        pool->run(std::min<int>(threads, (int)count), [&](int) {
+            for (int64_t s = next.fetch_add(1); s < count; s = next.fetch_add(1)) {
+                list[s]();
+            }
+        });
+    }
+};
+
+class serial_backend {
+public:
+    int concurrency() const { return 1; }
+
+    template <typename F>
+    void parallel_for(int64_t n, F f) const {
+        for (int64_t i = 0; i < n; i++) {
+            f(i);
+        }
+    }
+
+    template <typename T, typename Op, typename Value>
+    T parallel_reduce(int64_t n, T init, Op op, Value value) const {
+        T result = init;
+        for (int64_t i = 0; i < n; i++) {
+            result = op(result, (T)value(i));
+        }
+        return result;
+    }
+
+    template <typename... F>
+    void parallel_sections(F&&... sections) const {
+        (void)std::initializer_list<int>{ (sections(), 0)... };
+    }
+};
+
+#ifdef _OPENMP
+
+// Распределение итераций - тип Schedule из parallel_kernels.hpp.
+template <typename Schedule = parallel_kernels::static_schedule>
+class openmp_backend {
+private:
+    int threads;
+    Schedule schedule;
+
+public:
+    explicit openmp_backend(int threads, Schedule schedule = Schedule())
+        : threads(std::max(1, threads)), schedule(schedule) {}
+
+    int concurrency() const { return threads; }
+
+    template <typename F>
+    void parallel_for(int64_t n, F f) const {
+#pragma omp parallel num_threads(threads)
+        parallel_kernels::detail::for_range(n, schedule, f);
+    }
+
+    // identity не нужна: потоки, не получившие итераций, в свёртку не попадают.
+    template <typename T, typename Op, typename Value>
+    T parallel_reduce(int64_t n, T init, Op op, Value value) const {
+        std::vector<detail::Slot<T>> slots((size_t)threads, detail::Slot<T>{ T() });
+        std::vector<char> used((size_t)threads, 0);
+#pragma omp parallel num_threads(threads)
+        {
+            bool first = true;
+            T local = T();
+            parallel_kernels::detail::for_range(n, schedule, [&](int64_t i) {
+                local = first ? (T)value(i) : op(local, (T)value(i));
+                first = false;
+            });
+            slots[omp_get_thread_num()].value = local;
+            used[omp_get_thread_num()] = !first;
+        }
+        T result = init;
+        for (int id = 0; id < threads; id++) {
+            if (used[id]) {
+                result = op(result, slots[id].value);
+            }
+        }
+        return result;
+    }
+
+    template <typename... F>
+    void parallel_sections(F&&... sections) const {
+        std::function<void()> list[] = { std::function<void()>(sections)... };
+        const int count = (int)sizeof...(F);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(std::min(threads, count))
+        for (int s = 0; s < count; s++) {
+            list[s]();
+        }
+    }
+};
+
+#endif
+
+}  // namespace execution
@@ -0,0 +1,254 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Аллокатор на больших страницах с выравниванием 64 байта.
+//
+// Режим выбирается во время выполнения (set_page_mode) и действует на
+// последующие выделения:
+//   page_mode::normal      - обычная куча, выравнивание 64 байта;
+//   page_mode::transparent - анонимные отображения, выровненные на 2 МБ, с
+//                            madvise(MADV_HUGEPAGE) (прозрачные большие
+//                            страницы в режиме madvise или always);
+//   page_mode::hugetlb     - MAP_HUGETLB из заранее выделенного пула
+//                            hugetlbfs (vm.nr_hugepages); если пул пуст,
+//                            выделение идёт как transparent с одним
+//                            предупреждением.
+// Большие выделения (от четверти арены) получают своё отображение; мелкие -
+// например, строки матрицы vector<huge_vector<int>> - нарезаются подряд из
+// общих арен по 64 МБ, чтобы и они лежали на больших страницах. Арена
+// освобождается, когда в ней не осталось живых блоков. Перед каждым блоком -
+// заголовок в 64 байта, поэтому блок освобождается правильно и после смены
+// режима.
+//
+// Вне Linux все режимы работают как normal.
+//
+// Элементы без аргументов конструируются инициализацией по умолчанию:
+// huge_vector<double>(n) и resize(n) не обнуляют память и не касаются
+// страниц - первое касание остаётся за циклом, который заполняет вектор.
+//
+// Пример:
+//   parallel_kernels::set_page_mode(parallel_kernels::page_mode::transparent);
+//   parallel_kernels::huge_vector<double> data(1 << 24);
+
+namespace parallel_kernels {
+
+enum class page_mode { normal, transparent, hugetlb };
+
+inline std::atomic<page_mode>& current_page_mode() {
+    static std::atomic<page_mode> mode(page_mode::normal);
+    return mode;
+}
+
+inline void set_page_mode(page_mode mode) { current_page_mode().store(mode); }
+inline page_mode get_page_mode() { return current_page_mode().load(); }
+
+inline const char* page_mode_name(page_mode mode) {
+    return mode == page_mode::transparent ? "thp" : mode == page_mode::hugetlb ? "hugetlb" : "off";
+}
+
+inline bool parse_page_mode(const std::string& name, page_mode& mode) {
+    for (page_mode m : { page_mode::normal, page_mode::transparent, page_mode::hugetlb }) {
+        if (name == page_mode_name(m)) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace detail {
+
+constexpr size_t PAGE_ALIGNMENT = 64;
+constexpr size_t HUGE_PAGE_SIZE = (size_t)2 << 20;
+constexpr size_t ARENA_SIZE = (size_t)64 << 20;
+
+struct PageArena;
+
+enum BlockKind : uint32_t { BLOCK_HEAP, BLOCK_MAPPED, BLOCK_ARENA };
+
+struct alignas(PAGE_ALIGNMENT) BlockHeader {
+    PageArena* arena;
+    size_t mapped_bytes;
+    BlockKind kind;
+};
+
+struct PageArena {
+    char* base;
+    size_t bytes;
+    size_t used;
+    size_t live;
+};
+
+inline size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+#ifdef __linux__
+
+// Отображение bytes (кратно 2 МБ), выровненное на 2 МБ; nullptr при ошибке.
+inline void* map_pages(size_t bytes, page_mode mode) {
+    if (mode == page_mode::hugetlb) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            return p;
+        }
+        static std::once_flag warned;
+        std::call_once(warned, [] {
+            std::fprintf(stderr, "MAP_HUGETLB недоступен (пул vm.nr_hugepages пуст?), используются прозрачные большие страницы\n");
+        });
+    }
+    void* raw = mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    char* begin = (char*)raw;
+    char* aligned = (char*)round_up((uintptr_t)begin, HUGE_PAGE_SIZE);
+    if (aligned > begin) {
+        munmap(begin, (size_t)(aligned - begin));
+    }
+    size_t tail = (size_t)(begin + bytes + HUGE_PAGE_SIZE - (aligned + bytes));
+    if (tail > 0) {
+        munmap(aligned + bytes, tail);
+    }
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+    return aligned;
+}
+
+inline void unmap_pages(void* p, size_t bytes) { munmap(p, bytes); }
+
+#endif
+
+class PageAllocator {
+public:
+    void* allocate(size_t bytes) {
+        const size_t total = round_up(bytes, PAGE_ALIGNMENT) + sizeof(BlockHeader);
+        const page_mode mode = get_page_mode();
+#ifdef __linux__
+        if (mode != page_mode::normal) {
+            if (total >= ARENA_SIZE / 4) {
+                const size_t mapped = round_up(total, HUGE_PAGE_SIZE);
+                void* p = map_pages(mapped, mode);
+                if (!p) {
+                    throw std::bad_alloc();
+                }
+                return init_block(p, nullptr, mapped, BLOCK_MAPPED);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!arena || arena->used + total > arena->bytes || arena_mode != mode) {
+                retire_current();
+                void* p = map_pages(ARENA_SIZE, mode);
+                if (!p) {
+                    throw std::bad_alloc();
+                }
+                arena = new PageArena{ (char*)p, ARENA_SIZE, 0, 0 };
+                arena_mode = mode;
+            }
+            void* p = arena->base + arena->used;
+            arena->used += total;
+            arena->live++;
+            return init_block(p, arena, 0, BLOCK_ARENA);
+        }
+#endif
+        void* p = ::operator new(total, std::align_val_t(PAGE_ALIGNMENT));
+        return init_block(p, nullptr, 0, BLOCK_HEAP);
+    }
+
+    void deallocate(void* p) {
+        if (!p) {
+            return;
+        }
+        BlockHeader* header = (BlockHeader*)p - 1;
+#ifdef __linux__
+        if (header->kind == BLOCK_MAPPED) {
+            unmap_pages(header, header->mapped_bytes);
+            return;
+        }
+        if (header->kind == BLOCK_ARENA) {
+            std::lock_guard<std::mutex> lock(mutex);
+            PageArena* owner = header->arena;
+            if (--owner->live == 0) {
+                if (owner == arena) {
+                    owner->used = 0;
+                }
+                else {
+                    unmap_pages(owner->base, owner->bytes);
+                    delete owner;
+                }
+            }
+            return;
+        }
+#endif
+        ::operator delete(header, std::align_val_t(PAGE_ALIGNMENT));
+    }
+
+    static PageAllocator& instance() {
+        // Не разрушается: блоки могут освобождаться деструкторами статических объектов.
+        static PageAllocator* allocator = new PageAllocator;
+        return *allocator;
+    }
+
+private:
+    std::mutex mutex;
+    PageArena* arena = nullptr;
+    page_mode arena_mode = page_mode::normal;
+
+    static void* init_block(void* p, PageArena* owner, size_t mapped, BlockKind kind) {
+        BlockHeader* header = new (p) BlockHeader;
+        header->arena = owner;
+        header->mapped_bytes = mapped;
+        header->kind = kind;
+        return header + 1;
+    }
+
+    void retire_current() {
+#ifdef __linux__
+        if (arena && arena->live == 0) {
+            unmap_pages(arena->base, arena->bytes);
+            delete arena;
+        }
+#endif
+        arena = nullptr;
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+struct huge_page_allocator {
+    typedef T value_type;
+
+    huge_page_allocator() = default;
+    template <typename U>
+    huge_page_allocator(const huge_page_allocator<U>&) {}
+
+    T* allocate(size_t n) { return (T*)detail::PageAllocator::instance().allocate(n * sizeof(T)); }
+    void deallocate(T* p, size_t) { detail::PageAllocator::instance().deallocate(p); }
+
+    template <typename U>
+    void construct(U* p) { ::new ((void*)p) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new ((void*)p) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const huge_page_allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const huge_page_allocator<U>&) const { return false; }
+};
+
+template <typename T>
+using huge_vector = std::vector<T, huge_page_allocator<T>>;
+
+}  // namespace parallel_kernels
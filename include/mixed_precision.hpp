@@ -0,0 +1,165 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "parallel_kernels.hpp"
+
+// Хранение в float32 и bfloat16 с накоплением в double.
+//
+// Данные лабораторных - (rand() % 1000) / 10 или / 100, т.е. около 10 значащих
+// бит: float32 (24 бита мантиссы) хранит их почти точно, bfloat16 (8 бит) -
+// с относительной ошибкой до 2^-9 на элемент. Хранение вдвое или вчетверо
+// уменьшает объём памяти, которую читает ядро, а суммирование идёт в double
+// (wide) или в double с компенсацией Ноймайера (compensated), поэтому ошибка
+// накопления не растёт с длиной.
+//
+// Преобразования и широкие свёртки написаны как циклы omp simd: компилятор
+// векторизует расширение float -> double и сдвиг bfloat16 -> float.
+
+namespace parallel_kernels {
+
+// bfloat16: старшие 16 бит float32.
+struct bfloat16 {
+    uint16_t bits = 0;
+
+    bfloat16() = default;
+    explicit bfloat16(float value) : bits(from_float(value)) {}
+
+    // Округление к ближайшему чётному; NaN остаётся NaN.
+    static uint16_t from_float(float value) {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7FFFFFFFu) > 0x7F800000u) {
+            return (uint16_t)((u >> 16) | 0x0040u);
+        }
+        u += 0x7FFFu + ((u >> 16) & 1u);
+        return (uint16_t)(u >> 16);
+    }
+
+    float to_float() const {
+        uint32_t u = (uint32_t)bits << 16;
+        float value;
+        std::memcpy(&value, &u, sizeof(value));
+        return value;
+    }
+
+    explicit operator float() const { return to_float(); }
+    explicit operator double() const { return to_float(); }
+};
+
+inline double to_double(double value) { return value; }
+inline double to_double(float value) { return value; }
+inline double to_double(bfloat16 value) { return value.to_float(); }
+
+// double -> тип хранения.
+inline void convert(const double* in, double* out, int64_t n) {
+    std::memcpy(out, in, (size_t)n * sizeof(double));
+}
+
+inline void convert(const double* in, float* out, int64_t n) {
+#pragma omp simd
+    for (int64_t i = 0; i < n; i++) {
+        out[i] = (float)in[i];
+    }
+}
+
+inline void convert(const double* in, bfloat16* out, int64_t n) {
+#pragma omp simd
+    for (int64_t i = 0; i < n; i++) {
+        out[i].bits = bfloat16::from_float((float)in[i]);
+    }
+}
+
+template <typename T, typename OutAlloc = std::allocator<T>, typename InAlloc>
+std::vector<T, OutAlloc> convert_vector(const std::vector<double, InAlloc>& values) {
+    std::vector<T, OutAlloc> out(values.size());
+    convert(values.data(), out.data(), (int64_t)values.size());
+    return out;
+}
+
+// Сумма с компенсацией Ноймайера; объединение двух частичных сумм тоже
+// компенсированное.
+struct compensated {
+    double sum = 0.0;
+    double correction = 0.0;
+
+    void add(double value) {
+        double t = sum + value;
+        if (std::fabs(sum) >= std::fabs(value)) {
+            correction += (sum - t) + value;
+        }
+        else {
+            correction += (value - t) + sum;
+        }
+        sum = t;
+    }
+
+    double value() const { return sum + correction; }
+};
+
+struct compensated_plus {
+    compensated operator()(compensated a, const compensated& b) const {
+        a.add(b.sum);
+        a.add(b.correction);
+        return a;
+    }
+};
+
+// Сумма в double при хранении T.
+template <typename T>
+double sum_wide(const T* data, int64_t n, int threads) {
+    double sum = 0.0;
+#pragma omp parallel for simd reduction(+:sum) schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < n; i++) {
+        sum += to_double(data[i]);
+    }
+    return sum;
+}
+
+template <typename T>
+double dot_wide(const T* a, const T* b, int64_t n, int threads) {
+    double sum = 0.0;
+#pragma omp parallel for simd reduction(+:sum) schedule(static) num_threads(threads)
+    for (int64_t i = 0; i < n; i++) {
+        sum += to_double(a[i]) * to_double(b[i]);
+    }
+    return sum;
+}
+
+// Компенсированные варианты: у каждого потока своя компенсированная сумма в
+// ячейке padded_slots, ячейки объединяются последовательно.
+template <typename Value>
+double compensated_reduce(int64_t n, Value value, int threads) {
+    std::vector<detail::Slot<compensated>> slots((size_t)threads);
+#pragma omp parallel num_threads(threads)
+    {
+        compensated local;
+#pragma omp for schedule(static) nowait
+        for (int64_t i = 0; i < n; i++) {
+            local.add(value(i));
+        }
+        slots[omp_get_thread_num()].value = local;
+    }
+    compensated result;
+    for (const detail::Slot<compensated>& slot : slots) {
+        result = compensated_plus()(result, slot.value);
+    }
+    return result.value();
+}
+
+template <typename T>
+double sum_compensated(const T* data, int64_t n, int threads) {
+    return compensated_reduce(n, [data](int64_t i) { return to_double(data[i]); }, threads);
+}
+
+template <typename T>
+double dot_compensated(const T* a, const T* b, int64_t n, int threads) {
+    return compensated_reduce(n, [a, b](int64_t i) { return to_double(a[i]) * to_double(b[i]); }, threads);
+}
+
+}  // namespace parallel_kernels
@@ -0,0 +1,264 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+// Параллельные свёртки OpenMP с выбором стратегии на этапе компиляции.
+//
+// Свёртка transform_reduce складывает value(i) для i из [0, n) операцией op.
+// Тип элементов, тип накопителя, способ объединения частичных результатов
+// потоков (Combine) и распределение итераций (Schedule) - параметры шаблона,
+// поэтому во внутреннем цикле нет ни ветвлений по строкам, ни виртуальных
+// вызовов: каждая комбинация компилируется в свой цикл с литеральной
+// прагмой.
+//
+// Combine:
+//   builtin_combine  - клауза reduction OpenMP (только plus/minimum/maximum
+//                      над арифметическими типами);
+//   atomic_combine   - #pragma omp atomic для суммы, иначе CAS по std::atomic;
+//   critical_combine - именованная критическая секция;
+//   lock_combine     - omp_lock_t;
+//   padded_slots     - ячейка на поток в своей кэш-линии, объединение
+//                      последовательно после региона.
+// Schedule:
+//   static_schedule, dynamic_schedule, guided_schedule - schedule(...) с
+//   порцией chunk (0 - по умолчанию OpenMP); manual_split - непрерывные
+//   блоки n / threads, остаток у последнего потока, без omp for.
+//
+// Пример:
+//   double s = parallel_kernels::sum<parallel_kernels::padded_slots>(data.data(), data.size(), 8);
+//   int m = parallel_kernels::transform_reduce<parallel_kernels::critical_combine>(
+//       rows, std::numeric_limits<int>::min(), parallel_kernels::maximum(),
+//       [&](int64_t i) { return row_min(i); }, threads, parallel_kernels::dynamic_schedule{ 16 });
+
+namespace parallel_kernels {
+
+// Операции свёртки.
+struct plus {
+    template <typename T>
+    T operator()(const T& a, const T& b) const { return a + b; }
+};
+
+struct minimum {
+    template <typename T>
+    T operator()(const T& a, const T& b) const { return b < a ? b : a; }
+};
+
+struct maximum {
+    template <typename T>
+    T operator()(const T& a, const T& b) const { return a < b ? b : a; }
+};
+
+template <typename Op, typename T>
+T identity() {
+    if constexpr (std::is_same<Op, minimum>::value) {
+        return std::numeric_limits<T>::max();
+    }
+    else if constexpr (std::is_same<Op, maximum>::value) {
+        return std::numeric_limits<T>::lowest();
+    }
+    else {
+        return T();
+    }
+}
+
+// Распределение итераций.
+struct static_schedule { int chunk = 0; };
+struct dynamic_schedule { int chunk = 1; };
+struct guided_schedule { int chunk = 1; };
+struct manual_split {};
+
+// Объединение частичных результатов.
+struct builtin_combine {};
+struct atomic_combine {};
+struct critical_combine {};
+struct lock_combine {};
+struct padded_slots {};
+
+constexpr size_t CACHE_LINE = 64;
+
+namespace detail {
+
+// Обход [0, n) внутри параллельного региона; без неявного барьера в конце.
+template <typename Schedule, typename F>
+inline void for_range(int64_t n, const Schedule& schedule, F&& f) {
+    if constexpr (std::is_same<Schedule, static_schedule>::value) {
+        if (schedule.chunk > 0) {
+#pragma omp for schedule(static, schedule.chunk) nowait
+            for (int64_t i = 0; i < n; i++) {
+                f(i);
+            }
+        }
+        else {
+#pragma omp for schedule(static) nowait
+            for (int64_t i = 0; i < n; i++) {
+                f(i);
+            }
+        }
+    }
+    else if constexpr (std::is_same<Schedule, dynamic_schedule>::value) {
+#pragma omp for schedule(dynamic, schedule.chunk) nowait
+        for (int64_t i = 0; i < n; i++) {
+            f(i);
+        }
+    }
+    else if constexpr (std::is_same<Schedule, guided_schedule>::value) {
+#pragma omp for schedule(guided, schedule.chunk) nowait
+        for (int64_t i = 0; i < n; i++) {
+            f(i);
+        }
+    }
+    else {
+        static_assert(std::is_same<Schedule, manual_split>::value, "неизвестное распределение итераций");
+        const int64_t thread = omp_get_thread_num();
+        const int64_t threads = omp_get_num_threads();
+        const int64_t chunk = n / threads;
+        const int64_t begin = thread * chunk;
+        const int64_t end = thread == threads - 1 ? n : begin + chunk;
+        for (int64_t i = begin; i < end; i++) {
+            f(i);
+        }
+    }
+}
+
+template <typename Acc>
+struct alignas(CACHE_LINE) Slot {
+    Acc value;
+};
+
+}  // namespace detail
+
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename Acc,
+    typename Op, typename Value>
+Acc transform_reduce(int64_t n, Acc init, Op op, Value value, int threads, Schedule schedule = Schedule()) {
+    if constexpr (std::is_same<Combine, builtin_combine>::value) {
+        static_assert(std::is_arithmetic<Acc>::value, "builtin_combine требует арифметический накопитель");
+        Acc result = identity<Op, Acc>();
+        if constexpr (std::is_same<Op, plus>::value) {
+#pragma omp parallel num_threads(threads) reduction(+:result)
+            detail::for_range(n, schedule, [&](int64_t i) { result += value(i); });
+        }
+        else if constexpr (std::is_same<Op, minimum>::value) {
+#pragma omp parallel num_threads(threads) reduction(min:result)
+            detail::for_range(n, schedule, [&](int64_t i) { result = op(result, (Acc)value(i)); });
+        }
+        else {
+            static_assert(std::is_same<Op, maximum>::value, "builtin_combine поддерживает plus, minimum, maximum");
+#pragma omp parallel num_threads(threads) reduction(max:result)
+            detail::for_range(n, schedule, [&](int64_t i) { result = op(result, (Acc)value(i)); });
+        }
+        return op(init, result);
+    }
+    else if constexpr (std::is_same<Combine, padded_slots>::value) {
+        std::vector<detail::Slot<Acc>> slots((size_t)threads, detail::Slot<Acc>{ identity<Op, Acc>() });
+#pragma omp parallel num_threads(threads)
+        {
+            Acc local = identity<Op, Acc>();
+            detail::for_range(n, schedule, [&](int64_t i) { local = op(local, (Acc)value(i)); });
+            slots[omp_get_thread_num()].value = local;
+        }
+        Acc result = init;
+        for (const detail::Slot<Acc>& slot : slots) {
+            result = op(result, slot.value);
+        }
+        return result;
+    }
+    else if constexpr (std::is_same<Combine, atomic_combine>::value) {
+        if constexpr (std::is_same<Op, plus>::value && std::is_arithmetic<Acc>::value) {
+            Acc result = init;
+#pragma omp parallel num_threads(threads)
+            {
+                Acc local = Acc();
+                detail::for_range(n, schedule, [&](int64_t i) { local += value(i); });
+#pragma omp atomic
+                result += local;
+            }
+            return result;
+        }
+        else {
+            std::atomic<Acc> result(init);
+#pragma omp parallel num_threads(threads)
+            {
+                Acc local = identity<Op, Acc>();
+                detail::for_range(n, schedule, [&](int64_t i) { local = op(local, (Acc)value(i)); });
+                Acc current = result.load(std::memory_order_relaxed);
+                while (!result.compare_exchange_weak(current, op(current, local), std::memory_order_relaxed)) {
+                }
+            }
+            return result.load();
+        }
+    }
+    else if constexpr (std::is_same<Combine, critical_combine>::value) {
+        Acc result = init;
+#pragma omp parallel num_threads(threads)
+        {
+            Acc local = identity<Op, Acc>();
+            detail::for_range(n, schedule, [&](int64_t i) { local = op(local, (Acc)value(i)); });
+#pragma omp critical(parallel_kernels_combine)
+            result = op(result, local);
+        }
+        return result;
+    }
+    else {
+        static_assert(std::is_same<Combine, lock_combine>::value, "неизвестная стратегия объединения");
+        Acc result = init;
+        omp_lock_t lock;
+        omp_init_lock(&lock);
+#pragma omp parallel num_threads(threads)
+        {
+            Acc local = identity<Op, Acc>();
+            detail::for_range(n, schedule, [&](int64_t i) { local = op(local, (Acc)value(i)); });
+            omp_set_lock(&lock);
+            result = op(result, local);
+            omp_unset_lock(&lock);
+        }
+        omp_destroy_lock(&lock);
+        return result;
+    }
+}
+
+// Свёртка массива; Acc по умолчанию - тип элементов.
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename Acc = void,
+    typename T, typename Op>
+auto reduce(const T* data, int64_t n, Op op, int threads, Schedule schedule = Schedule()) {
+    typedef typename std::conditional<std::is_void<Acc>::value, T, Acc>::type Result;
+    return transform_reduce<Combine>(n, identity<Op, Result>(), op,
+        [data](int64_t i) { return (Result)data[i]; }, threads, schedule);
+}
+
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename Acc = void, typename T>
+auto sum(const T* data, int64_t n, int threads, Schedule schedule = Schedule()) {
+    return reduce<Combine, Schedule, Acc>(data, n, plus(), threads, schedule);
+}
+
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename T>
+T min(const T* data, int64_t n, int threads, Schedule schedule = Schedule()) {
+    return reduce<Combine, Schedule>(data, n, minimum(), threads, schedule);
+}
+
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename T>
+T max(const T* data, int64_t n, int threads, Schedule schedule = Schedule()) {
+    return reduce<Combine, Schedule>(data, n, maximum(), threads, schedule);
+}
+
+// Скалярное произведение с накопителем Acc (например, long long для int).
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename Acc, typename T>
+Acc dot(const T* a, const T* b, int64_t n, int threads, Schedule schedule = Schedule()) {
+    return transform_reduce<Combine>(n, Acc(), plus(),
+        [a, b](int64_t i) { return (Acc)a[i] * (Acc)b[i]; }, threads, schedule);
+}
+
+// Максимум из минимумов строк; row_min(i) - минимум строки i (или identity
+// maximum, если строку надо пропустить).
+template <typename Combine = builtin_combine, typename Schedule = static_schedule, typename RowMin>
+auto max_of_row_mins(int64_t rows, RowMin row_min, int threads, Schedule schedule = Schedule()) {
+    typedef decltype(row_min(int64_t())) T;
+    return transform_reduce<Combine>(rows, identity<maximum, T>(), maximum(), row_min, threads, schedule);
+}
+
+}  // namespace parallel_kernels
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+
+// Настраиваемые пороги ядер, например размер, начиная с которого цикл
+// выгодно распараллеливать.
+//
+// Значения измеряет ompbench --tune FILE (накладные расходы регионов OpenMP
+// против стоимости элемента) и пишет в файл строками
+//   <имя> <потоков> <значение>
+// ('#' - комментарий). Файл берётся из переменной PK_TUNING_FILE, по
+// умолчанию ompbench_tuning.txt в текущем каталоге, и читается один раз.
+// Для числа потоков без своей строки берётся строка с ближайшим меньшим
+// числом потоков (или наименьшим, если меньших нет). Переменная окружения
+// PK_<ИМЯ> в верхнем регистре задаёт значение для любого числа потоков и
+// важнее файла. Без файла и переменной - значение по умолчанию из кода.
+//
+// Пример:
+//   if (threads > 1 && n >= parallel_kernels::tuned_value("dot_product_cutoff", threads, 1000)) ...
+
+namespace parallel_kernels {
+
+namespace detail {
+
+typedef std::map<std::string, std::map<int, int64_t>> TuningTable;
+
+inline TuningTable load_tuning_table() {
+    TuningTable table;
+    const char* path = std::getenv("PK_TUNING_FILE");
+    std::ifstream file(path && *path ? path : "ompbench_tuning.txt");
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name;
+        int threads;
+        long long value;
+        if (fields >> name >> threads >> value) {
+            table[name][threads] = (int64_t)value;
+        }
+    }
+    return table;
+}
+
+}  // namespace detail
+
+inline int64_t tuned_value(const std::string& name, int threads, int64_t fallback) {
+    static const detail::TuningTable table = detail::load_tuning_table();
+
+    std::string variable = "PK_";
+    for (char c : name) {
+        variable += (char)std::toupper((unsigned char)c);
+    }
+    if (const char* value = std::getenv(variable.c_str())) {
+        if (*value) {
+            return (int64_t)std::atoll(value);
+        }
+    }
+
+    auto entry = table.find(name);
+    if (entry == table.end() || entry->second.empty()) {
+        return fallback;
+    }
+    auto it = entry->second.upper_bound(threads);
+    return it == entry->second.begin() ? it->second : std::prev(it)->second;
+}
+
+}  // namespace parallel_kernels
@@ -1,203 +1,367 @@
 ﻿#include <iostream>
 #include <omp.h>
 #include <vector>
-#include <climits>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <windows.h>
-#include <iomanip>
+#include <memory>
+#include <string>
+#include <algorithm>
+
+#include "bench.h"
+#include "dataset.h"
+#include "huge_pages.hpp"
+#include "parallel_kernels.hpp"
+#include "range_query.h"
 
 using namespace std;
+namespace pk = parallel_kernels;
 
 class ParallelMinMaxFinder {
-private:
-    vector<int> generate_test_data(int size) {
-        vector<int> data(size);
-        for (int i = 0; i < size; i++) {
-            data[i] = (rand() * rand()) % 1000000;
-        }
-        return data;
-    }
-
 public:
-    int find_max_with_reduction(const vector<int>& data, int threads) {
-        int max_val = INT_MIN;
-#pragma omp parallel for reduction(max:max_val) num_threads(threads)
-        for (int i = 0; i < data.size(); i++) {
-            if (data[i] > max_val) max_val = data[i];
-        }
-        return max_val;
+    // Равномерно в [0, 1000000); значение зависит только от seed и индекса.
+    static int test_value(uint64_t seed, int64_t i) {
+        return (int)bench::random_below(bench::random_bits(seed, 0, (uint64_t)i), 1000000);
     }
 
-    int find_max_manual_split(const vector<int>& data, int threads) {
-        int chunk_size = data.size() / threads;
-        vector<int> local_maxes(threads, INT_MIN);
-
-#pragma omp parallel num_threads(threads)
-        {
-            int thread_id = omp_get_thread_num();
-            int start = thread_id * chunk_size;
-            int end = (thread_id == threads - 1) ? data.size() : start + chunk_size;
+    pk::huge_vector<int> generate_test_data(const bench::Config& config, int size) {
+        return bench::cached_vector<int>(config, "minmax.uniform_1e6", size,
+            [&config](int64_t i) { return test_value(config.seed, i); });
+    }
 
-            for (int i = start; i < end; i++) {
-                if (data[i] > local_maxes[thread_id]) {
-                    local_maxes[thread_id] = data[i];
-                }
-            }
-        }
+    // Встроенная редукция OpenMP.
+    int find_max_with_reduction(const pk::huge_vector<int>& data, int threads) {
+        return pk::max<pk::builtin_combine>(data.data(), (int64_t)data.size(), threads);
+    }
 
-        int global_max = INT_MIN;
-        for (int i = 0; i < threads; i++) {
-            if (local_maxes[i] > global_max) {
-                global_max = local_maxes[i];
-            }
-        }
-        return global_max;
+    // Ручное разбиение на непрерывные блоки, частичные результаты - в ячейках
+    // потоков на разных кэш-линиях.
+    int find_max_manual_split(const pk::huge_vector<int>& data, int threads) {
+        return pk::max<pk::padded_slots, pk::manual_split>(data.data(), (int64_t)data.size(), threads);
     }
 
-    int find_min_with_reduction(const vector<int>& data, int threads) {
-        int min_val = INT_MAX;
-#pragma omp parallel for reduction(min:min_val) num_threads(threads)
-        for (int i = 0; i < data.size(); i++) {
-            if (data[i] < min_val) min_val = data[i];
-        }
-        return min_val;
+    int find_min_with_reduction(const pk::huge_vector<int>& data, int threads) {
+        return pk::min<pk::builtin_combine>(data.data(), (int64_t)data.size(), threads);
     }
 
-    int find_min_manual_split(const vector<int>& data, int threads) {
-        int chunk_size = data.size() / threads;
-        vector<int> local_mins(threads, INT_MAX);
+    int find_min_manual_split(const pk::huge_vector<int>& data, int threads) {
+        return pk::min<pk::padded_slots, pk::manual_split>(data.data(), (int64_t)data.size(), threads);
+    }
 
+    // Префиксные суммы в два прохода по непрерывным блокам потоков: сначала
+    // каждый поток суммирует свой блок, после барьера считает смещение блока
+    // по суммам предыдущих блоков и сканирует блок от этого смещения. Данные
+    // читаются дважды, зато без последовательного участка.
+    void prefix_sum(const pk::huge_vector<int>& data, vector<long long>& out, bool inclusive, int threads) {
+        const int64_t n = (int64_t)data.size();
+        const int* values = data.data();
+        long long* sums = out.data();
+        vector<pk::detail::Slot<long long>> block_sums((size_t)threads);
 #pragma omp parallel num_threads(threads)
         {
-            int thread_id = omp_get_thread_num();
-            int start = thread_id * chunk_size;
-            int end = (thread_id == threads - 1) ? data.size() : start + chunk_size;
+            const int thread = omp_get_thread_num();
+            const int team = omp_get_num_threads();
+            const int64_t begin = n * thread / team;
+            const int64_t end = n * (thread + 1) / team;
+
+            long long block_sum = 0;
+#pragma omp simd reduction(+:block_sum)
+            for (int64_t i = begin; i < end; i++) {
+                block_sum += values[i];
+            }
+            block_sums[thread].value = block_sum;
+#pragma omp barrier
 
-            for (int i = start; i < end; i++) {
-                if (data[i] < local_mins[thread_id]) {
-                    local_mins[thread_id] = data[i];
+            long long running = 0;
+            for (int t = 0; t < thread; t++) {
+                running += block_sums[t].value;
+            }
+            if (inclusive) {
+                for (int64_t i = begin; i < end; i++) {
+                    running += values[i];
+                    sums[i] = running;
                 }
             }
-        }
-
-        int global_min = INT_MAX;
-        for (int i = 0; i < threads; i++) {
-            if (local_mins[i] < global_min) {
-                global_min = local_mins[i];
+            else {
+                for (int64_t i = begin; i < end; i++) {
+                    sums[i] = running;
+                    running += values[i];
+                }
             }
         }
-        return global_min;
     }
 
-    void finding() {
-        ofstream out_max("max_result_omp1.csv");
-        ofstream out_min("min_result_omp1.csv");
-
-        out_max << "Size,Threads,Reduction_Time,Manual_Time,Speedup_Reduction,Efficiency_Reduction,Speedup_Manual,Efficiency_Manual\n";
-        out_min << "Size,Threads,Reduction_Time,Manual_Time,Speedup_Reduction,Efficiency_Reduction,Speedup_Manual,Efficiency_Manual\n";
+    void inclusive_scan(const pk::huge_vector<int>& data, vector<long long>& out, int threads) {
+        prefix_sum(data, out, true, threads);
+    }
 
-        srand(time(0));
+    void exclusive_scan(const pk::huge_vector<int>& data, vector<long long>& out, int threads) {
+        prefix_sum(data, out, false, threads);
+    }
 
-        int sizes[] = { 100000, 250000, 500000, 1000000, 2500000, 5000000 };
-        int thread_counts[] = { 1, 2, 4, 8, 16 };
+    // Множитель для bin_index: floor(bins * 2^32 / (hi - lo + 1)), поэтому номер
+    // корзины всегда меньше bins, а считается умножением и сдвигом без деления.
+    static uint64_t bin_scale(int lo, int hi, int bins) {
+        const uint64_t range = (uint64_t)((int64_t)hi - lo) + 1;
+        return ((uint64_t)min<int64_t>(bins, (int64_t)range) << 32) / range;
+    }
 
-        for (int size : sizes) {
-            cout << "\nЭлементов: " << size << endl;
-            vector<int> test_data = generate_test_data(size);
+    static uint32_t bin_index(int value, int lo, uint64_t scale) {
+        return (uint32_t)(((uint64_t)((uint32_t)value - (uint32_t)lo) * scale) >> 32);
+    }
 
-            double base_time_reduction_max = 0.0;
-            double base_time_manual_max = 0.0;
-            double base_time_reduction_min = 0.0;
-            double base_time_manual_min = 0.0;
+    // Индексы для пакетов запросов минимума на отрезке (range_query.h),
+    // строятся параллельно.
+    SparseTable<int, pk::minimum> build_min_sparse_table(const pk::huge_vector<int>& data, int threads) {
+        SparseTable<int, pk::minimum> table;
+        table.build(data.data(), (int64_t)data.size(), threads);
+        return table;
+    }
 
-            cout << "\n  Поиск максимума:" << endl;
-            for (int threads : thread_counts) {
-                double start = omp_get_wtime();
-                int max_reduction = find_max_with_reduction(test_data, threads);
-                double time_reduction = (omp_get_wtime() - start) * 1000.0;
+    BlockIndex<int, pk::minimum> build_min_block_index(const pk::huge_vector<int>& data, int64_t block, int threads) {
+        BlockIndex<int, pk::minimum> index;
+        index.build(data.data(), (int64_t)data.size(), block, threads);
+        return index;
+    }
 
-                start = omp_get_wtime();
-                int max_manual = find_max_manual_split(test_data, threads);
-                double time_manual = (omp_get_wtime() - start) * 1000.0;
+    // Пакет запросов сканированием каждого отрезка - база для сравнения с индексами.
+    void range_min_linear(const pk::huge_vector<int>& data, const vector<RangeQuery>& queries, vector<int>& out, int threads) {
+        const int* values = data.data();
+        answer_queries(queries, out.data(), [values](int64_t l, int64_t r) {
+            return range_scan<pk::minimum>(values, l, r);
+        }, threads);
+    }
 
-                if (threads == 1) {
-                    base_time_reduction_max = time_reduction;
-                    base_time_manual_max = time_manual;
+    static const int HISTOGRAM_BATCH = 256;
+
+    // Гистограмма значений из [lo, hi] в bins корзинах. У каждого потока свои
+    // корзины в отдельных кэш-линиях; номера корзин для порции из HISTOGRAM_BATCH
+    // элементов считаются циклом omp simd, потом увеличиваются счётчики. После
+    // барьера корзины потоков сливаются параллельно по номеру корзины.
+    vector<long long> histogram(const pk::huge_vector<int>& data, int lo, int hi, int bins, int threads) {
+        const int64_t n = (int64_t)data.size();
+        const int* values = data.data();
+        const uint64_t scale = bin_scale(lo, hi, bins);
+        const int64_t stride = (bins + 7) / 8 * 8;
+        vector<long long> storage((size_t)(threads * stride) + pk::CACHE_LINE / sizeof(long long));
+        long long* local = storage.data()
+            + (pk::CACHE_LINE - (uintptr_t)storage.data() % pk::CACHE_LINE) % pk::CACHE_LINE / sizeof(long long);
+        vector<long long> result((size_t)bins);
+#pragma omp parallel num_threads(threads)
+        {
+            long long* counts = local + omp_get_thread_num() * stride;
+            uint32_t index[HISTOGRAM_BATCH];
+#pragma omp for schedule(static)
+            for (int64_t batch = 0; batch < n; batch += HISTOGRAM_BATCH) {
+                const int64_t count = min<int64_t>(HISTOGRAM_BATCH, n - batch);
+#pragma omp simd
+                for (int64_t k = 0; k < count; k++) {
+                    index[k] = bin_index(values[batch + k], lo, scale);
+                }
+                for (int64_t k = 0; k < count; k++) {
+                    counts[index[k]]++;
                 }
+            }
 
-                double speedup_reduction = (threads == 1) ? 1.0 : base_time_reduction_max / time_reduction;
-                double efficiency_reduction = speedup_reduction / threads;
-
-                double speedup_manual = (threads == 1) ? 1.0 : base_time_manual_max / time_manual;
-                double efficiency_manual = speedup_manual / threads;
-
-                out_max << size << "," << threads << ","
-                    << fixed << setprecision(3) << time_reduction << ","
-                    << time_manual << ","
-                    << speedup_reduction << "," << efficiency_reduction << ","
-                    << speedup_manual << "," << efficiency_manual << "\n";
-
-                cout << "   Потоки: " << setw(2) << threads
-                    << "    Время (редукция): " << setw(8) << time_reduction << " ms"
-                    << "    Время (без редукции): " << setw(8) << time_manual << " ms"
-                    << "    Ускорение (редукция): " << setw(6) << speedup_reduction
-                    << "    Эффективность (редукция): " << setw(6) << efficiency_reduction
-                    << "    Ускорение (ручной): " << setw(6) << speedup_manual
-                    << "    Эффективность (ручной): " << setw(6) << efficiency_manual << endl;
+            const int team = omp_get_num_threads();
+#pragma omp for schedule(static)
+            for (int b = 0; b < bins; b++) {
+                long long total = 0;
+                for (int t = 0; t < team; t++) {
+                    total += local[t * stride + b];
+                }
+                result[b] = total;
             }
+        }
+        return result;
+    }
+};
 
-            cout << "\n  Поиск минимума:" << endl;
-            for (int threads : thread_counts) {
-                double start = omp_get_wtime();
-                int min_reduction = find_min_with_reduction(test_data, threads);
-                double time_reduction = (omp_get_wtime() - start) * 1000.0;
+namespace {
 
-                start = omp_get_wtime();
-                int min_manual = find_min_manual_split(test_data, threads);
-                double time_manual = (omp_get_wtime() - start) * 1000.0;
+// Контрольное значение префиксных сумм: элементы в трёх точках (разные
+// блоки потоков) и последний.
+double scan_checksum(const vector<long long>& sums) {
+    const size_t n = sums.size();
+    return n == 0 ? 0.0 : (double)sums[n / 3] + (double)sums[2 * n / 3] + (double)sums[n - 1];
+}
 
-                if (threads == 1) {
-                    base_time_reduction_min = time_reduction;
-                    base_time_manual_min = time_manual;
-                }
+// Контрольное значение гистограммы: сумма count * (номер корзины + 1).
+double histogram_checksum(const vector<long long>& counts) {
+    double checksum = 0.0;
+    for (size_t b = 0; b < counts.size(); b++) {
+        checksum += (double)counts[b] * (b + 1);
+    }
+    return checksum;
+}
 
-                double speedup_reduction = (threads == 1) ? 1.0 : base_time_reduction_min / time_reduction;
-                double efficiency_reduction = speedup_reduction / threads;
-
-                double speedup_manual = (threads == 1) ? 1.0 : base_time_manual_min / time_manual;
-                double efficiency_manual = speedup_manual / threads;
-
-                out_min << size << "," << threads << ","
-                    << fixed << setprecision(3) << time_reduction << ","
-                    << time_manual << ","
-                    << speedup_reduction << "," << efficiency_reduction << ","
-                    << speedup_manual << "," << efficiency_manual << "\n";
-
-                cout << "   Потоки: " << setw(2) << threads
-                    << "    Время (редукция): " << setw(8) << time_reduction << " ms"
-                    << "    Время (без редукции): " << setw(8) << time_manual << " ms"
-                    << "    Ускорение (редукция): " << setw(6) << speedup_reduction
-                    << "    Эффективность (редукция): " << setw(6) << efficiency_reduction
-                    << "    Ускорение (ручной): " << setw(6) << speedup_manual
-                    << "    Эффективность (ручной): " << setw(6) << efficiency_manual << endl;
+// Варианты scan и histogram - следующие шаги конвейера над тем же вектором:
+// префиксные суммы в long long и гистограмма по диапазону [min, max] данных
+// (границы считаются вне замера). Параметр bins - число корзин.
+bench::Workload prepare_minmax(int64_t size, const bench::Config& config) {
+    const int bins = (int)max<int64_t>(1, config.param_int("bins", 256));
+    auto finder = make_shared<ParallelMinMaxFinder>();
+    auto data = make_shared<pk::huge_vector<int>>(finder->generate_test_data(config, (int)size));
+    auto sums = make_shared<vector<long long>>(config.wants_variant("inclusive_scan")
+        || config.wants_variant("exclusive_scan") ? (size_t)size : 0);
+    const int lo = data->empty() ? 0 : *min_element(data->begin(), data->end());
+    const int hi = data->empty() ? 0 : *max_element(data->begin(), data->end());
+
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        if (variant == "max_reduction") return finder->find_max_with_reduction(*data, threads);
+        if (variant == "max_manual") return finder->find_max_manual_split(*data, threads);
+        if (variant == "min_reduction") return finder->find_min_with_reduction(*data, threads);
+        if (variant == "inclusive_scan") {
+            finder->inclusive_scan(*data, *sums, threads);
+            return scan_checksum(*sums);
+        }
+        if (variant == "exclusive_scan") {
+            finder->exclusive_scan(*data, *sums, threads);
+            return scan_checksum(*sums);
+        }
+        if (variant == "histogram") return histogram_checksum(finder->histogram(*data, lo, hi, bins, threads));
+        return finder->find_min_manual_split(*data, threads);
+    };
+    workload.reference = [=](const string& variant) -> double {
+        if (variant == "inclusive_scan" || variant == "exclusive_scan") {
+            vector<long long> expected(data->size());
+            long long running = 0;
+            for (size_t i = 0; i < data->size(); i++) {
+                running += variant == "inclusive_scan" ? (*data)[i] : 0;
+                expected[i] = running;
+                running += variant == "exclusive_scan" ? (*data)[i] : 0;
             }
-            cout << endl;
+            return scan_checksum(expected);
         }
+        if (variant == "histogram") {
+            vector<long long> expected((size_t)bins);
+            const uint64_t scale = ParallelMinMaxFinder::bin_scale(lo, hi, bins);
+            for (int value : *data) {
+                expected[ParallelMinMaxFinder::bin_index(value, lo, scale)]++;
+            }
+            return histogram_checksum(expected);
+        }
+        return variant.compare(0, 3, "max") == 0 ? hi : lo;
+    };
+    // Скан читает вход дважды и пишет long long; гистограмма читает один раз.
+    workload.bytes = [size](const string& variant) {
+        return variant.find("scan") != string::npos ? (double)size * (2 * sizeof(int) + sizeof(long long))
+            : (double)size * sizeof(int);
+    };
+    workload.place = [data, sums](int threads) {
+        bench::place_vector(*data, threads);
+        bench::place_vector(*sums, threads);
+    };
+    workload.flops = [size](const string& variant) {
+        return variant.find("scan") != string::npos ? 2.0 * size : (double)size;
+    };
+    return workload;
+}
 
-        out_max.close();
-        out_min.close();
+const bench::Registrar minmax_registrar({
+    "minmax", "Минимум, максимум, префиксные суммы и гистограмма вектора (open_mp_1)",
+    { "max_reduction", "max_manual", "min_reduction", "min_manual", "inclusive_scan", "exclusive_scan", "histogram" },
+    { 100000, 250000, 500000, 1000000, 2500000, 5000000 },
+    prepare_minmax,
+    { "bins=256 - число корзин гистограммы" }
+});
+
+// Пакет запросов минимума на отрезке: linear сканирует каждый отрезок,
+// sparse_table и block отвечают по индексу. Индекс строится в setup при
+// смене варианта или числа потоков, время построения - колонка Build(ms).
+// Отрезки: начало равномерно по массиву, длина равномерно в [1, max_span].
+// Параметры: queries, max_span, block.
+bench::Workload prepare_range_query(int64_t size, const bench::Config& config) {
+    const int64_t query_count = config.param_int("queries", 100000);
+    const int64_t max_span = max<int64_t>(1, config.param_int("max_span", 10000));
+    const int64_t block = max<int64_t>(1, config.param_int("block", 64));
+    const uint64_t seed = config.seed;
+
+    auto finder = make_shared<ParallelMinMaxFinder>();
+    auto data = make_shared<pk::huge_vector<int>>(finder->generate_test_data(config, (int)size));
+    auto queries = make_shared<vector<RangeQuery>>((size_t)query_count);
+    for (int64_t q = 0; q < query_count; q++) {
+        int64_t l = (int64_t)(bench::random_bits(seed, 10, (uint64_t)q) % (uint64_t)size);
+        int64_t span = 1 + (int64_t)(bench::random_bits(seed, 11, (uint64_t)q) % (uint64_t)min(max_span, size - l));
+        (*queries)[q] = RangeQuery{ l, l + span };
     }
-};
+    auto answers = make_shared<vector<int>>((size_t)query_count);
+
+    struct Indexes {
+        string variant;
+        int threads = 0;
+        double build_ms = 0.0;
+        SparseTable<int, pk::minimum> table;
+        BlockIndex<int, pk::minimum> blocks;
+    };
+    auto indexes = make_shared<Indexes>();
+
+    auto checksum = [](const vector<int>& values) {
+        double sum = 0.0;
+        for (int value : values) {
+            sum += value;
+        }
+        return sum;
+    };
 
-int main() {
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
+    bench::Workload workload;
+    workload.setup = [=](const string& variant, int threads) {
+        if (variant == "linear" || (indexes->variant == variant && indexes->threads == threads)) {
+            return;
+        }
+        double start = omp_get_wtime();
+        if (variant == "sparse_table") {
+            indexes->table = finder->build_min_sparse_table(*data, threads);
+        }
+        else {
+            indexes->blocks = finder->build_min_block_index(*data, block, threads);
+        }
+        indexes->build_ms = (omp_get_wtime() - start) * 1000.0;
+        indexes->variant = variant;
+        indexes->threads = threads;
+    };
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        bench::RunResult result;
+        double start = omp_get_wtime();
+        double index_mb = 0.0;
+        if (variant == "linear") {
+            finder->range_min_linear(*data, *queries, *answers, threads);
+        }
+        else if (variant == "sparse_table") {
+            const SparseTable<int, pk::minimum>& table = indexes->table;
+            answer_queries(*queries, answers->data(), [&table](int64_t l, int64_t r) { return table.query(l, r); }, threads);
+            index_mb = table.memory_bytes() / 1048576.0;
+        }
+        else {
+            const BlockIndex<int, pk::minimum>& blocks = indexes->blocks;
+            answer_queries(*queries, answers->data(), [&blocks](int64_t l, int64_t r) { return blocks.query(l, r); }, threads);
+            index_mb = blocks.memory_bytes() / 1048576.0;
+        }
+        double elapsed = omp_get_wtime() - start;
+        result.value = checksum(*answers);
+        result.metrics.push_back({ "Build(ms)", variant == "linear" ? 0.0 : indexes->build_ms });
+        result.metrics.push_back({ "Index_MB", index_mb });
+        result.metrics.push_back({ "MQueries_per_sec", elapsed > 0 ? query_count / elapsed / 1e6 : 0.0 });
+        return result;
+    };
+    workload.reference = [=](const string&) -> double {
+        vector<int> expected(queries->size());
+        for (size_t q = 0; q < queries->size(); q++) {
+            expected[q] = *min_element(data->begin() + (*queries)[q].l, data->begin() + (*queries)[q].r);
+        }
+        return checksum(expected);
+    };
+    workload.elements = [=](const string&) { return (double)query_count; };
+    workload.place = [data](int threads) { bench::place_vector(*data, threads); };
+    return workload;
+}
 
-    ParallelMinMaxFinder finder;
-    finder.finding();
+const bench::Registrar range_query_registrar({
+    "range_query", "Пакеты запросов минимума на отрезке: сканирование, разреженная таблица, блочный индекс (open_mp_1)",
+    { "linear", "sparse_table", "block" },
+    { 1000000, 5000000 },
+    prepare_range_query,
+    { "queries=100000 - запросов в пакете", "max_span=10000 - наибольшая длина отрезка",
+      "block=64 - размер блока индекса block" }
+});
 
-    system("pause");
-    return 0;
-}
+}  // namespace
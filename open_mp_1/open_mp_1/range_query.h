@@ -0,0 +1,165 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "parallel_kernels.hpp"
+
+// Индексы для многократных запросов минимума/максимума на отрезке [l, r).
+//
+// SparseTable - разреженная таблица: уровень k хранит op по окнам длины 2^k,
+// запрос - op двух перекрывающихся окон, O(1). Память n * (log2 n + 1)
+// элементов. Уровни строятся в одном параллельном регионе, между уровнями -
+// неявный барьер omp for.
+//
+// BlockIndex - массив делится на блоки по block элементов, разреженная таблица
+// строится только по значениям блоков: память в block раз меньше. Запрос -
+// неполные крайние блоки сканируются циклом omp simd, полные между ними -
+// запросом к таблице блоков. Данные не копируются: индекс ссылается на массив,
+// который должен жить дольше индекса.
+//
+// Op - parallel_kernels::minimum или parallel_kernels::maximum.
+
+struct RangeQuery {
+    int64_t l;
+    int64_t r;
+};
+
+inline int floor_log2(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
+
+// op по [l, r), l < r.
+template <typename Op, typename T>
+T range_scan(const T* data, int64_t l, int64_t r) {
+    T result = data[l];
+    if constexpr (std::is_same<Op, parallel_kernels::minimum>::value) {
+#pragma omp simd reduction(min:result)
+        for (int64_t i = l + 1; i < r; i++) {
+            result = data[i] < result ? data[i] : result;
+        }
+    }
+    else {
+        static_assert(std::is_same<Op, parallel_kernels::maximum>::value, "range_scan поддерживает minimum и maximum");
+#pragma omp simd reduction(max:result)
+        for (int64_t i = l + 1; i < r; i++) {
+            result = data[i] > result ? data[i] : result;
+        }
+    }
+    return result;
+}
+
+template <typename T, typename Op>
+class SparseTable {
+public:
+    void build(const T* data, int64_t n, int threads) {
+        const int count = n > 0 ? floor_log2((uint64_t)n) + 1 : 0;
+        levels.clear();
+        lengths.clear();
+        for (int k = 0; k < count; k++) {
+            lengths.push_back(n - ((int64_t)1 << k) + 1);
+            // new T[] без инициализации: первое касание - в параллельном цикле.
+            levels.emplace_back(new T[(size_t)lengths.back()]);
+        }
+        Op op;
+#pragma omp parallel num_threads(threads)
+        {
+            if (count > 0) {
+                T* level = levels[0].get();
+#pragma omp for simd schedule(static)
+                for (int64_t i = 0; i < n; i++) {
+                    level[i] = data[i];
+                }
+            }
+            for (int k = 1; k < count; k++) {
+                const T* prev = levels[k - 1].get();
+                T* level = levels[k].get();
+                const int64_t half = (int64_t)1 << (k - 1);
+#pragma omp for simd schedule(static)
+                for (int64_t i = 0; i < lengths[k]; i++) {
+                    level[i] = op(prev[i], prev[i + half]);
+                }
+            }
+        }
+    }
+
+    T query(int64_t l, int64_t r) const {
+        const int k = floor_log2((uint64_t)(r - l));
+        const T* level = levels[k].get();
+        return Op()(level[l], level[r - ((int64_t)1 << k)]);
+    }
+
+    size_t memory_bytes() const {
+        size_t bytes = 0;
+        for (int64_t length : lengths) {
+            bytes += (size_t)length * sizeof(T);
+        }
+        return bytes;
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>> levels;
+    std::vector<int64_t> lengths;
+};
+
+template <typename T, typename Op>
+class BlockIndex {
+public:
+    void build(const T* values, int64_t n, int64_t block_size, int threads) {
+        data = values;
+        block = block_size;
+        const int64_t blocks = (n + block - 1) / block;
+        std::vector<T> block_values((size_t)blocks);
+#pragma omp parallel for schedule(static) num_threads(threads)
+        for (int64_t b = 0; b < blocks; b++) {
+            block_values[b] = range_scan<Op>(data, b * block, std::min(n, (b + 1) * block));
+        }
+        summary.build(block_values.data(), blocks, threads);
+    }
+
+    T query(int64_t l, int64_t r) const {
+        const int64_t first = l / block;
+        const int64_t last = (r - 1) / block;
+        if (first == last) {
+            return range_scan<Op>(data, l, r);
+        }
+        Op op;
+        T result = op(range_scan<Op>(data, l, (first + 1) * block), range_scan<Op>(data, last * block, r));
+        if (last > first + 1) {
+            result = op(result, summary.query(first + 1, last));
+        }
+        return result;
+    }
+
+    size_t memory_bytes() const { return summary.memory_bytes(); }
+
+private:
+    const T* data = nullptr;
+    int64_t block = 1;
+    SparseTable<T, Op> summary;
+};
+
+// Пакет запросов параллельно по запросам; query(l, r) - ответ на один.
+// Порции dynamic: у линейного сканирования стоимость запросов разная.
+template <typename T, typename Query>
+void answer_queries(const std::vector<RangeQuery>& queries, T* out, Query query, int threads) {
+    const int64_t count = (int64_t)queries.size();
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads)
+    for (int64_t q = 0; q < count; q++) {
+        out[q] = query(queries[q].l, queries[q].r);
+    }
+}
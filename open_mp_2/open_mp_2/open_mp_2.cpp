@@ -1,93 +1,76 @@
-﻿#include <iostream>
-#include <omp.h>
+﻿#include <omp.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <map>
-#include <windows.h>
+#include <memory>
+#include <string>
 
-using namespace std;
-
-void scalar_product(const vector<int>& vec1, const vector<int>& vec2, long long& result, int num_threads) {
-    result = 0;
+#include "bench.h"
+#include "dataset.h"
+#include "execution.hpp"
+#include "huge_pages.hpp"
+#include "parallel_kernels.hpp"
 
-#pragma omp parallel num_threads(num_threads)
-    {
-        long long local_sum = 0;
-
-#pragma omp for
-        for (int i = 0; i < vec1.size(); i++) {
-            local_sum += (long long)vec1[i] * vec2[i];
-        }
+using namespace std;
+namespace pk = parallel_kernels;
 
-#pragma omp atomic
-        result += local_sum;
-    }
+// Векторы на больших страницах (режим задаёт --huge-pages), выровнены на 64 байта.
+void scalar_product(const pk::huge_vector<int>& vec1, const pk::huge_vector<int>& vec2, long long& result,
+    int num_threads) {
+    result = pk::dot<pk::atomic_combine, pk::static_schedule, long long>(
+        vec1.data(), vec2.data(), (int64_t)vec1.size(), num_threads);
 }
 
-int main() {
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("results_omp2.csv");
-
-    output << "Threads,Size,Time(ms),Speedup,Efficiency(%)\n";
-
-    srand(static_cast<unsigned int>(time(0)));
-
-    vector<int> sizes = { 500000, 1000000, 5000000, 10000000 };
-    vector<int> threads = { 1, 2, 4, 8, 16 };
-
-    map<int, double> base_times;
-
-
-    for (int size : sizes) {
-        cout << "\nРазмер векторов: " << size << endl;
-        vector<int> vec1(size);
-        vector<int> vec2(size);
-
-        for (int i = 0; i < size; i++) {
-            vec1[i] = rand() % 1000;  
-            vec2[i] = rand() % 1000;
-        }
-
-        for (int t : threads) {
-            const int repetitions = 10;  
-            double total_time = 0.0;
-
-            for (int rep = 0; rep < repetitions; rep++) {
-                long long result;
-                double start = omp_get_wtime();
-
-                scalar_product(vec1, vec2, result, t);
-
-                double end = omp_get_wtime();
-                total_time += (end - start) * 1000.0;  
-            }
-
-            double avg_time = total_time / repetitions;
-
-            if (t == 1) {
-                base_times[size] = avg_time;
-            }
-
-            double base_time = base_times[size];
-            double speedup = base_time / avg_time;
-            double efficiency = (speedup / t) * 100.0;
-
-            output << t << "," << size << "," << fixed << setprecision(3) << avg_time
-                << "," << speedup << "," << efficiency << "\n";
+// То же на исполнителе из execution.hpp: OpenMP, пул потоков или последовательно.
+template <typename Backend>
+long long scalar_product(const Backend& backend, const pk::huge_vector<int>& vec1, const pk::huge_vector<int>& vec2) {
+    const int* a = vec1.data();
+    const int* b = vec2.data();
+    return backend.parallel_reduce((int64_t)vec1.size(), 0LL, pk::plus(),
+        [a, b](int64_t i) { return (long long)a[i] * b[i]; });
+}
 
-            cout << "   Потоков: " << setw(2) << t
-                << "    Время: " << setw(8) << avg_time << " мс"
-                << "    Ускорение: " << setw(6) << speedup << "x"
-                << "    Эффективность: " << setw(6) << efficiency << "%" << endl;
+namespace {
+
+// Элементы векторов равномерны в [0, 1000), у каждого вектора свой поток генератора.
+bench::Workload prepare_scalar_product(int64_t size, const bench::Config& config) {
+    const uint64_t seed = config.seed;
+    auto vec1 = make_shared<pk::huge_vector<int>>(bench::cached_vector<int, pk::huge_page_allocator<int>>(
+        config, "scalar_product.vec1.uniform_1000", size,
+        [seed](int64_t i) { return (int)bench::random_below(bench::random_bits(seed, 1, (uint64_t)i), 1000); }));
+    auto vec2 = make_shared<pk::huge_vector<int>>(bench::cached_vector<int, pk::huge_page_allocator<int>>(
+        config, "scalar_product.vec2.uniform_1000", size,
+        [seed](int64_t i) { return (int)bench::random_below(bench::random_bits(seed, 2, (uint64_t)i), 1000); }));
+
+    bench::Workload workload;
+    workload.run = [vec1, vec2](const string& variant, int threads) -> bench::RunResult {
+        if (variant == "openmp") return (double)scalar_product(execution::openmp_backend<>(threads), *vec1, *vec2);
+        if (variant == "pool") return (double)scalar_product(execution::pool_backend(threads), *vec1, *vec2);
+        if (variant == "serial") return (double)scalar_product(execution::serial_backend(), *vec1, *vec2);
+        long long result;
+        scalar_product(*vec1, *vec2, result, threads);
+        return (double)result;
+    };
+    workload.reference = [vec1, vec2](const string&) -> double {
+        long long result = 0;
+        for (size_t i = 0; i < vec1->size(); i++) {
+            result += (long long)(*vec1)[i] * (*vec2)[i];
         }
-    }
+        return (double)result;
+    };
+    workload.bytes = [size](const string&) { return 2.0 * size * sizeof(int); };
+    workload.place = [vec1, vec2](int threads) {
+        bench::place_vector(*vec1, threads);
+        bench::place_vector(*vec2, threads);
+    };
+    workload.flops = [size](const string&) { return 2.0 * size; };
+    return workload;
+}
 
-    output.close();
+const bench::Registrar scalar_product_registrar({
+    "scalar_product", "Скалярное произведение векторов (open_mp_2)",
+    { "atomic", "openmp", "pool", "serial" },
+    { 500000, 1000000, 5000000, 10000000 },
+    prepare_scalar_product
+});
 
-    return 0;
-}
+}  // namespace
@@ -1,13 +1,15 @@
 ﻿#define _USE_MATH_DEFINES 
 
-#include <iostream>
 #include <omp.h>
 #include <vector>
 #include <cmath>
-#include <fstream>
-#include <iomanip>
-#include <map>
-#include <windows.h>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
+#include "bench.h"
+#include "dataset.h"
 
 using namespace std;
 
@@ -24,70 +26,174 @@ double calculate_integral(double a, double b, int n, int num_threads) {
     return sum * h;
 }
 
+struct IntegralTask {
+    double a;
+    double b;
+    int n;
+};
+
+// Пакет интегралов sin^2 одним параллельным регионом.
+//
+// Интегралы сортируются по убыванию n и группируются по INTEGRAL_LANES: в
+// группе векторные линии - разные интегралы с близким n, линии с i >= n
+// маскируются. Группы раздаются потокам schedule(dynamic, 1) от самых дорогих
+// (n первого интеграла группы), поэтому нагрузка выравнивается по n.
+//
+// sin(a + i * h) считается поворотом: (s, c) -> (s cos h + c sin h,
+// c cos h - s sin h) - только умножения и сложения, которые векторизуются
+// (вызов sin в цикле omp simd без -ffast-math не векторизуется). Каждые
+// INTEGRAL_ANCHOR шагов s и c пересчитываются через sin/cos, так что ошибка
+// не накапливается дольше этого числа шагов.
+const int INTEGRAL_LANES = 8;
+const int INTEGRAL_ANCHOR = 256;
+
+void calculate_integrals(const vector<IntegralTask>& tasks, vector<double>& results, int num_threads) {
+    const int64_t count = (int64_t)tasks.size();
+    results.assign((size_t)count, 0.0);
+    vector<int64_t> order((size_t)count);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&tasks](int64_t x, int64_t y) { return tasks[x].n > tasks[y].n; });
+    const int64_t groups = (count + INTEGRAL_LANES - 1) / INTEGRAL_LANES;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t g = 0; g < groups; g++) {
+        double a[INTEGRAL_LANES], h[INTEGRAL_LANES], sin_h[INTEGRAL_LANES], cos_h[INTEGRAL_LANES];
+        double s[INTEGRAL_LANES], c[INTEGRAL_LANES], sum[INTEGRAL_LANES];
+        int n[INTEGRAL_LANES];
+        for (int k = 0; k < INTEGRAL_LANES; k++) {
+            int64_t t = g * INTEGRAL_LANES + k;
+            const IntegralTask task = t < count ? tasks[order[t]] : IntegralTask{ 0.0, 0.0, 0 };
+            a[k] = task.a;
+            n[k] = task.n;
+            h[k] = task.n > 0 ? (task.b - task.a) / task.n : 0.0;
+            sin_h[k] = sin(h[k]);
+            cos_h[k] = cos(h[k]);
+            sum[k] = 0.0;
+        }
+        const int max_n = n[0];
 
-int main() {
-
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("result_omp3.csv");
-
-    output << "Threads,Intervals,Time(ms),Result,Speedup,Efficiency(%)\n";
-
-    double a = 0.0;
-    double b = M_PI;  
-
-    vector<long long> intervals = { 1000000, 5000000, 10000000, 50000000 };
-    vector<int> threads = { 1, 2, 4, 8, 16 };
-
-    map<long long, double> base_times;
-
-    for (long long n : intervals) {
-        cout << "Количество интервалов: " << n << endl;
-
-        for (int t : threads) {
-            const int repetitions = 5;  
-            double total_time = 0.0;
-            double final_result = 0.0;
-
-            for (int rep = 0; rep < repetitions; rep++) {
-                double start = omp_get_wtime();
-                double result = calculate_integral(a, b, n, t);
-                double end = omp_get_wtime();
-                total_time += (end - start) * 1000.0;  
-
-                if (rep == 0) final_result = result;  
+        for (int start = 0; start < max_n; start += INTEGRAL_ANCHOR) {
+            for (int k = 0; k < INTEGRAL_LANES; k++) {
+                s[k] = sin(a[k] + start * h[k]);
+                c[k] = cos(a[k] + start * h[k]);
             }
+            const int end = min(max_n, start + INTEGRAL_ANCHOR);
+            for (int i = start; i < end; i++) {
+#pragma omp simd
+                for (int k = 0; k < INTEGRAL_LANES; k++) {
+                    sum[k] += i < n[k] ? s[k] * s[k] : 0.0;
+                    double next = s[k] * cos_h[k] + c[k] * sin_h[k];
+                    c[k] = c[k] * cos_h[k] - s[k] * sin_h[k];
+                    s[k] = next;
+                }
+            }
+        }
 
-            double avg_time = total_time / repetitions;
-
-            if (t == 1) {
-                base_times[n] = avg_time;
+        for (int k = 0; k < INTEGRAL_LANES; k++) {
+            int64_t t = g * INTEGRAL_LANES + k;
+            if (t < count) {
+                results[order[t]] = sum[k] * h[k];
             }
+        }
+    }
+}
 
-            double base_time = base_times[n];
-            double speedup = base_time / avg_time;
-            double efficiency = (speedup / t) * 100.0;
 
-            output << t << "," << n << "," << fixed << setprecision(3) << avg_time
-                << "," << scientific << setprecision(10) << final_result
-                << "," << fixed << setprecision(3) << speedup
-                << "," << efficiency << "\n";
+namespace {
+
+// Интеграл sin^2(x) на [0, pi]; size - число интервалов.
+bench::Workload prepare_integral(int64_t size, const bench::Config&) {
+    const double a = 0.0;
+    const double b = M_PI;
+    const double answer = (b - a) / 2.0 - (sin(2.0 * b) - sin(2.0 * a)) / 4.0;
+
+    bench::Workload workload;
+    workload.run = [=](const string&, int threads) -> bench::RunResult {
+        bench::RunResult result = calculate_integral(a, b, (int)size, threads);
+        result.metrics.push_back({ "Abs_Error", fabs(result.value - answer) });
+        return result;
+    };
+    // Для периодической sin^2 на целом периоде формула прямоугольников точна.
+    workload.reference = [=](const string&) { return answer; };
+    // Память не используется; считаются x = a + i * h, произведение и сумма,
+    // вызовы sin не входят, поэтому доля от пика занижена.
+    workload.flops = [size](const string&) { return 4.0 * size; };
+    return workload;
+}
 
-            cout << "   Потоков: " << setw(2) << t
-                << "    Время: " << setw(10) << avg_time << " мс"
-                << "    Ускорение: " << setw(6) << speedup << "x"
-                << "    Эффективность: " << setw(6) << efficiency << "%"
-                << "    Результат: " << scientific << setprecision(6) << final_result << endl;
-        }
-        cout << endl;
+const bench::Registrar integral_registrar({
+    "integral", "Интеграл методом прямоугольников (open_mp_3)",
+    { "reduction" },
+    { 1000000, 5000000, 10000000, 50000000 },
+    prepare_integral
+});
+
+// Пакет из size интегралов sin^2 на случайных [a, b], a в [0, 10), длина в
+// (0, 5], n равномерно в [1, max_n]. loop - calculate_integral для каждого
+// интеграла (свой параллельный регион), batched - calculate_integrals.
+// Результат - сумма интегралов, Abs_Error - отклонение от точной суммы.
+bench::Workload prepare_integral_batch(int64_t size, const bench::Config& config) {
+    const int64_t max_n = max<int64_t>(1, config.param_int("max_n", 10000));
+    const uint64_t seed = config.seed;
+    auto tasks = make_shared<vector<IntegralTask>>((size_t)size);
+    double answer = 0.0;
+    for (int64_t t = 0; t < size; t++) {
+        IntegralTask& task = (*tasks)[t];
+        task.a = bench::random_below(bench::random_bits(seed, 0, (uint64_t)t), 10000) / 1000.0;
+        task.b = task.a + (1 + bench::random_below(bench::random_bits(seed, 1, (uint64_t)t), 5000)) / 1000.0;
+        task.n = 1 + (int)bench::random_below(bench::random_bits(seed, 2, (uint64_t)t), (uint32_t)max_n);
+        answer += (task.b - task.a) / 2.0 - (sin(2.0 * task.b) - sin(2.0 * task.a)) / 4.0;
     }
+    auto results = make_shared<vector<double>>();
 
-    output.close();
+    auto total = [](const vector<double>& values) {
+        double sum = 0.0;
+        for (double value : values) {
+            sum += value;
+        }
+        return sum;
+    };
 
-    double answer = (b - a) / 2.0 - (sin(2.0 * b) - sin(2.0 * a)) / 4.0;
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        if (variant == "batched") {
+            calculate_integrals(*tasks, *results, threads);
+        }
+        else {
+            results->resize(tasks->size());
+            for (size_t t = 0; t < tasks->size(); t++) {
+                const IntegralTask& task = (*tasks)[t];
+                (*results)[t] = calculate_integral(task.a, task.b, task.n, threads);
+            }
+        }
+        bench::RunResult result = total(*results);
+        result.metrics.push_back({ "Abs_Error", fabs(result.value - answer) });
+        return result;
+    };
+    // Эталон - те же интегралы последовательно по формуле прямоугольников.
+    workload.reference = [=](const string&) {
+        double sum = 0.0;
+        for (const IntegralTask& task : *tasks) {
+            sum += calculate_integral(task.a, task.b, task.n, 1);
+        }
+        return sum;
+    };
+    workload.elements = [=](const string&) {
+        double steps = 0.0;
+        for (const IntegralTask& task : *tasks) {
+            steps += task.n;
+        }
+        return steps;
+    };
+    return workload;
+}
 
-    cout << "Решение: " << fixed << setprecision(10) << answer << endl;
+const bench::Registrar integral_batch_registrar({
+    "integral_batch", "Пакет интегралов: цикл calculate_integral против векторизации по интегралам (open_mp_3)",
+    { "loop", "batched" },
+    { 1000, 5000, 10000 },
+    prepare_integral_batch,
+    { "max_n=10000 - наибольшее число интервалов интеграла" }
+});
 
-    return 0;
-}
+}  // namespace
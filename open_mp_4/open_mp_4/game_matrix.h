@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+#include <omp.h>
+
+// Анализ платёжной матрицы игры за один проход: максимин (max по строкам
+// минимума строки), минимакс (min по столбцам максимума столбца) и седловые
+// точки.
+//
+// Строки делятся между потоками статически панелями по GAME_PANEL_ROWS.
+// Панель обходится тайлами по tile_cols столбцов: в тайле каждая строка
+// панели обновляет свой минимум и максимумы столбцов в буфере потока, так что
+// участок буфера (tile_cols элементов) остаётся в L1, пока по нему проходят
+// все строки панели, а матрица читается один раз и только по строкам. Буферы
+// потоков выровнены на кэш-линию и сливаются в конце параллельным циклом по
+// столбцам.
+//
+// Седловая точка - элемент, минимальный в строке и максимальный в столбце;
+// они есть, только если maximin == minimax = v. Тогда седловые - ровно все
+// пары (i, j) с минимумом строки i и максимумом столбца j, равными v: a[i][j]
+// не меньше первого и не больше второго. Поэтому координаты хранятся как два
+// списка, строк и столбцов, и повторного прохода по матрице не нужно.
+
+const int64_t GAME_PANEL_ROWS = 16;
+const int64_t GAME_TILE_COLS = 1024;
+
+struct GameAnalysis {
+    int maximin = std::numeric_limits<int>::min();
+    int minimax = std::numeric_limits<int>::max();
+    std::vector<int64_t> saddle_rows;   // седловые точки - все пары (saddle_rows[a], saddle_cols[b])
+    std::vector<int64_t> saddle_cols;
+
+    int64_t saddle_points() const { return (int64_t)saddle_rows.size() * (int64_t)saddle_cols.size(); }
+};
+
+// Итог по минимумам строк и максимумам столбцов.
+inline GameAnalysis summarize_game(const std::vector<int>& row_min, const std::vector<int>& col_max) {
+    GameAnalysis result;
+    for (int value : row_min) {
+        result.maximin = std::max(result.maximin, value);
+    }
+    for (int value : col_max) {
+        result.minimax = std::min(result.minimax, value);
+    }
+    if (result.maximin == result.minimax) {
+        for (size_t i = 0; i < row_min.size(); i++) {
+            if (row_min[i] == result.maximin) {
+                result.saddle_rows.push_back((int64_t)i);
+            }
+        }
+        for (size_t j = 0; j < col_max.size(); j++) {
+            if (col_max[j] == result.minimax) {
+                result.saddle_cols.push_back((int64_t)j);
+            }
+        }
+    }
+    return result;
+}
+
+// Матрица - vector строк одинаковой длины (vector<int> или huge_vector<int>).
+template <typename Row>
+GameAnalysis analyze_game_matrix(const std::vector<Row>& matrix, int num_threads, int64_t tile_cols = GAME_TILE_COLS) {
+    const int64_t rows = (int64_t)matrix.size();
+    const int64_t cols = rows > 0 ? (int64_t)matrix[0].size() : 0;
+    // Шаг буферов кратен 16 int: буфер каждого потока с начала кэш-линии.
+    const int64_t stride = (cols + 15) / 16 * 16;
+    std::unique_ptr<int[], void (*)(int*)> buffers(
+        (int*)::operator new((size_t)(stride * num_threads) * sizeof(int), std::align_val_t(64)),
+        [](int* p) { ::operator delete(p, std::align_val_t(64)); });
+    std::vector<int> row_min((size_t)rows);
+    std::vector<int> col_max((size_t)cols);
+    int* all = buffers.get();
+    int* mins = row_min.data();
+    int* maxs = col_max.data();
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        const int team = omp_get_num_threads();
+        // Буфер заполняет свой поток: первое касание на его узле NUMA.
+        int* local = all + stride * omp_get_thread_num();
+        std::fill(local, local + cols, std::numeric_limits<int>::min());
+
+#pragma omp for schedule(static)
+        for (int64_t first = 0; first < rows; first += GAME_PANEL_ROWS) {
+            const int64_t last = std::min(rows, first + GAME_PANEL_ROWS);
+            for (int64_t i = first; i < last; i++) {
+                mins[i] = std::numeric_limits<int>::max();
+            }
+            for (int64_t j0 = 0; j0 < cols; j0 += tile_cols) {
+                const int64_t j1 = std::min(cols, j0 + tile_cols);
+                for (int64_t i = first; i < last; i++) {
+                    const int* row = matrix[i].data();
+                    int m = mins[i];
+#pragma omp simd reduction(min:m)
+                    for (int64_t j = j0; j < j1; j++) {
+                        const int value = row[j];
+                        m = value < m ? value : m;
+                        local[j] = value > local[j] ? value : local[j];
+                    }
+                    mins[i] = m;
+                }
+            }
+        }
+
+#pragma omp for schedule(static)
+        for (int64_t j = 0; j < cols; j++) {
+            int m = std::numeric_limits<int>::min();
+            for (int t = 0; t < team; t++) {
+                m = std::max(m, all[stride * t + j]);
+            }
+            maxs[j] = m;
+        }
+    }
+    return summarize_game(row_min, col_max);
+}
+
+// Для сравнения: минимумы по строкам и второй проход по столбцам с шагом в
+// строку - на каждый элемент столбца своя кэш-линия.
+template <typename Row>
+GameAnalysis analyze_game_matrix_two_pass(const std::vector<Row>& matrix, int num_threads) {
+    const int64_t rows = (int64_t)matrix.size();
+    const int64_t cols = rows > 0 ? (int64_t)matrix[0].size() : 0;
+    std::vector<int> row_min((size_t)rows);
+    std::vector<int> col_max((size_t)cols);
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int64_t i = 0; i < rows; i++) {
+        row_min[i] = *std::min_element(matrix[i].begin(), matrix[i].end());
+    }
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int64_t j = 0; j < cols; j++) {
+        int m = std::numeric_limits<int>::min();
+        for (int64_t i = 0; i < rows; i++) {
+            m = std::max(m, matrix[i][j]);
+        }
+        col_max[j] = m;
+    }
+    return summarize_game(row_min, col_max);
+}
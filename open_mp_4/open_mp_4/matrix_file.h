@@ -0,0 +1,189 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "parallel_kernels.hpp"
+
+// Бинарный файл матрицы: MatrixFileHeader, затем rows * cols значений int32 по строкам.
+// Матрица может быть больше оперативной памяти: и генерация, и поиск максимина
+// идут панелями по panel_rows строк.
+
+static const char MATRIX_FILE_MAGIC[8] = { 'O', 'M', 'P', 'M', 'A', 'T', '1', '\n' };
+
+#pragma pack(push, 1)
+struct MatrixFileHeader {
+    char magic[8];
+    int64_t rows;
+    int64_t cols;
+    uint32_t element_size;
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+struct StreamingStats {
+    int64_t rows = 0;
+    int64_t cols = 0;
+    int panels = 0;
+    double time = 0.0;       // сек, от открытия файла до результата
+    double read_wait = 0.0;  // сек, которые потоки простаивали в ожидании панели
+
+    double rows_per_sec() const { return time > 0 ? rows / time : 0.0; }
+    double gb_per_sec() const { return time > 0 ? (double)rows * cols * sizeof(int) / time / 1e9 : 0.0; }
+};
+
+inline uint64_t matrix_row_seed(uint64_t seed, int64_t row) {
+    return seed * 0xD1B54A32D192ED03ull + (uint64_t)row * 0x9E3779B97F4A7C15ull;
+}
+
+inline uint64_t splitmix64_next(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline bool write_matrix_header(std::ofstream& file, int64_t rows, int64_t cols) {
+    MatrixFileHeader header{};
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.rows = rows;
+    header.cols = cols;
+    header.element_size = sizeof(int);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return (bool)file;
+}
+
+inline bool write_matrix_file(const std::string& filename, const std::vector<std::vector<int>>& matrix) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    int64_t cols = matrix.empty() ? 0 : (int64_t)matrix[0].size();
+    if (!file.is_open() || !write_matrix_header(file, (int64_t)matrix.size(), cols)) {
+        return false;
+    }
+    for (const std::vector<int>& row : matrix) {
+        file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(int));
+    }
+    return (bool)file;
+}
+
+template <typename Alloc>
+bool read_matrix_file(const std::string& filename, std::vector<std::vector<int, Alloc>>& matrix) {
+    std::ifstream file(filename, std::ios::binary);
+    MatrixFileHeader header{};
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) != 0 || header.element_size != sizeof(int)) {
+        return false;
+    }
+    matrix.assign((size_t)header.rows, std::vector<int, Alloc>((size_t)header.cols));
+    for (std::vector<int, Alloc>& row : matrix) {
+        if (!file.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(int))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Генерация без матрицы в памяти: панель заполняется параллельно (строка зависит
+// только от seed и своего номера) и дописывается в файл.
+inline bool generate_matrix_file(const std::string& filename, int64_t rows, int64_t cols, uint64_t seed,
+    int64_t panel_rows, int num_threads) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() || !write_matrix_header(file, rows, cols)) {
+        return false;
+    }
+
+    std::vector<int> panel((size_t)(panel_rows * cols));
+    for (int64_t first = 0; first < rows; first += panel_rows) {
+        int64_t count = std::min(panel_rows, rows - first);
+
+#pragma omp parallel for num_threads(num_threads)
+        for (int64_t r = 0; r < count; r++) {
+            uint64_t state = matrix_row_seed(seed, first + r);
+            int* row = panel.data() + r * cols;
+            for (int64_t j = 0; j < cols; j++) {
+                row[j] = (int)(splitmix64_next(state) % 10000);
+            }
+        }
+
+        file.write(reinterpret_cast<const char*>(panel.data()), count * cols * sizeof(int));
+        if (!file) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Максимин по панели строк: та же схема, что в find_maxmin (локальный максимум
+// и critical), но по непрерывному буферу.
+inline int panel_maxmin(const int* panel, int64_t rows, int64_t cols, int num_threads) {
+    return parallel_kernels::max_of_row_mins<parallel_kernels::critical_combine>(rows, [panel, cols](int64_t i) {
+        const int* row = panel + i * cols;
+        return *std::min_element(row, row + cols);
+    }, num_threads);
+}
+
+// Потоковый максимин: пока команда OpenMP сворачивает панель p, отдельный
+// поток чтения загружает панель p + 1 во второй буфер.
+inline int find_maxmin_streaming(const std::string& filename, int num_threads, int64_t panel_rows, StreamingStats& stats) {
+    stats = StreamingStats();
+    double start = omp_get_wtime();
+
+    std::ifstream file(filename, std::ios::binary);
+    MatrixFileHeader header{};
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) != 0 || header.element_size != sizeof(int)) {
+        return std::numeric_limits<int>::min();
+    }
+
+    const int64_t rows = header.rows;
+    const int64_t cols = header.cols;
+    panel_rows = std::max<int64_t>(1, std::min(panel_rows, rows));
+
+    // Буферы без инициализации: обнулять их бессмысленно, всё равно будут перезаписаны чтением.
+    std::unique_ptr<int[]> buffers[2] = {
+        std::unique_ptr<int[]>(new int[(size_t)(panel_rows * cols)]),
+        std::unique_ptr<int[]>(new int[(size_t)(panel_rows * cols)])
+    };
+
+    auto read_panel = [&](int buffer, int64_t first) -> int64_t {
+        int64_t count = std::min(panel_rows, rows - first);
+        file.read(reinterpret_cast<char*>(buffers[buffer].get()), count * cols * sizeof(int));
+        return file ? count : 0;
+    };
+
+    int max_of_mins = std::numeric_limits<int>::min();
+    int current = 0;
+    std::future<int64_t> pending = std::async(std::launch::async, read_panel, current, (int64_t)0);
+
+    for (int64_t first = 0; first < rows;) {
+        double wait_start = omp_get_wtime();
+        int64_t count = pending.get();
+        stats.read_wait += omp_get_wtime() - wait_start;
+        if (count == 0) {
+            return std::numeric_limits<int>::min();
+        }
+
+        if (first + count < rows) {
+            pending = std::async(std::launch::async, read_panel, current ^ 1, first + count);
+        }
+
+        int panel_result = panel_maxmin(buffers[current].get(), count, cols, num_threads);
+        max_of_mins = std::max(max_of_mins, panel_result);
+
+        stats.panels++;
+        first += count;
+        current ^= 1;
+    }
+
+    stats.rows = rows;
+    stats.cols = cols;
+    stats.time = omp_get_wtime() - start;
+    return max_of_mins;
+}
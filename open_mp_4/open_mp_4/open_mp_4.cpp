@@ -1,112 +1,199 @@
-﻿#define NOMINMAX
-
-#include <iostream>
-#include <omp.h>
+﻿#include <omp.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <windows.h>
 #include <limits>
-#include <iomanip>
-#include <map>
 #include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "bench.h"
+#include "dataset.h"
+#include "game_matrix.h"
+#include "huge_pages.hpp"
+#include "matrix_file.h"
+#include "parallel_kernels.hpp"
 
 using namespace std;
+namespace pk = parallel_kernels;
+
+// Строки матрицы на больших страницах (режим задаёт --huge-pages): мелкие
+// строки нарезаются подряд из общих арен, крупные получают свои отображения.
+int find_maxmin(const vector<pk::huge_vector<int>>& matrix, int num_threads) {
+    return pk::max_of_row_mins<pk::critical_combine>((int64_t)matrix.size(), [&matrix](int64_t i) {
+        return *min_element(matrix[i].begin(), matrix[i].end());
+    }, num_threads);
+}
 
-int find_maxmin(const vector<vector<int>>& matrix, int num_threads) {
-    int n = matrix.size();
-    int max_of_mins = numeric_limits<int>::min();
-
-#pragma omp parallel num_threads(num_threads)
-    {
-        int local_max_of_mins = numeric_limits<int>::min();
 
-#pragma omp for
-        for (int i = 0; i < n; i++) {
-            int min_in_row = *min_element(matrix[i].begin(), matrix[i].end());
-            if (min_in_row > local_max_of_mins) {
-                local_max_of_mins = min_in_row;
-            }
+namespace {
+
+// Элементы матрицы равномерны в [0, 10000).
+bench::Workload prepare_maximin(int64_t size, const bench::Config& config) {
+    const uint64_t seed = config.seed;
+    auto matrix = make_shared<vector<pk::huge_vector<int>>>(bench::cached_matrix<int, pk::huge_page_allocator<int>>(
+        config, "maximin.uniform_10000", size, size, [seed, size](int64_t i, int64_t j) {
+            return (int)bench::random_below(bench::random_bits(seed, 0, (uint64_t)(i * size + j)), 10000);
+        }));
+
+    bench::Workload workload;
+    workload.run = [matrix](const string&, int threads) -> bench::RunResult {
+        return find_maxmin(*matrix, threads);
+    };
+    workload.reference = [matrix](const string&) -> double {
+        int max_of_mins = numeric_limits<int>::min();
+        for (const pk::huge_vector<int>& row : *matrix) {
+            max_of_mins = max(max_of_mins, *min_element(row.begin(), row.end()));
         }
-
-#pragma omp critical
-        {
-            if (local_max_of_mins > max_of_mins) {
-                max_of_mins = local_max_of_mins;
-            }
-        }
-    }
-
-    return max_of_mins;
+        return max_of_mins;
+    };
+    workload.elements = [size](const string&) { return (double)size * size; };
+    workload.bytes = [size](const string&) { return (double)size * size * sizeof(int); };
+    workload.place = [matrix](int threads) { bench::place_rows(*matrix, threads); };
+    workload.flops = [size](const string&) { return (double)size * size; };
+    return workload;
 }
 
+const bench::Registrar maximin_registrar({
+    "maximin", "Максимин матрицы в памяти (open_mp_4)",
+    { "critical" },
+    { 1000, 2000, 5000, 10000 },
+    prepare_maximin
+});
+
+// Потоковый максимин из файла против вычисления по матрице в памяти.
+// Файл генерируется панелями, поэтому для варианта streaming размер может
+// превышать оперативную память; матрица в памяти строится только если
+// запрошен вариант in_memory.
+// Параметры: file (имя файла), panel_mb (размер панели чтения).
+bench::Workload prepare_maximin_stream(int64_t size, const bench::Config& config) {
+    const int64_t panel_bytes = config.param_int("panel_mb", 32) << 20;
+    const int64_t panel_rows = max<int64_t>(1, panel_bytes / (size * (int64_t)sizeof(int)));
+
+    // Файл удаляется вместе с последней копией нагрузки.
+    shared_ptr<string> filename(new string(config.param("file", "matrix_stream.bin")), [](string* name) {
+        remove(name->c_str());
+        delete name;
+    });
+    if (!generate_matrix_file(*filename, size, size, config.seed, panel_rows, omp_get_num_procs())) {
+        throw runtime_error("ошибка записи файла " + *filename);
+    }
 
-int main() {
-
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("result_omp4.csv");
-
-    output << "Threads,Size,Time(ms),Result,Speedup,Efficiency(%)\n";
-
-    srand(static_cast<unsigned int>(time(0)));
-
-    vector<int> sizes = { 1000, 2000, 5000, 10000 };
-    vector<int> threads = { 1, 2, 4, 8, 16 };
-
-    map<int, double> base_times;
-
-    for (int size : sizes) {
-        cout << "Размер матрицы: " << size << "x" << size << endl;
-
-        vector<vector<int>> matrix(size, vector<int>(size));
+    auto matrix = make_shared<vector<pk::huge_vector<int>>>();
+    if (config.wants_variant("in_memory") && !read_matrix_file(*filename, *matrix)) {
+        throw runtime_error("ошибка чтения файла " + *filename);
+    }
 
-#pragma omp parallel for num_threads(8)
-        for (int i = 0; i < size; i++) {
-            for (int j = 0; j < size; j++) {
-                matrix[i][j] = rand() % 10000;  
-            }
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        bench::RunResult result;
+        double time = 0.0;
+        int64_t rows = size;
+        if (variant == "in_memory") {
+            double start = omp_get_wtime();
+            result.value = find_maxmin(*matrix, threads);
+            time = omp_get_wtime() - start;
+            result.metrics.push_back({ "Panel_Rows", (double)size });
         }
+        else {
+            StreamingStats stats;
+            result.value = find_maxmin_streaming(*filename, threads, panel_rows, stats);
+            time = stats.time;
+            result.metrics.push_back({ "Panel_Rows", (double)panel_rows });
+            result.metrics.push_back({ "Read_Wait(ms)", stats.read_wait * 1000.0 });
+        }
+        result.metrics.push_back({ "Rows_per_sec", time > 0 ? rows / time : 0.0 });
+        return result;
+    };
+    // Оба варианта сверяются с однопоточным потоковым проходом по файлу.
+    workload.reference = [=](const string&) -> double {
+        StreamingStats stats;
+        return find_maxmin_streaming(*filename, 1, panel_rows, stats);
+    };
+    workload.elements = [size](const string&) { return (double)size * size; };
+    workload.bytes = [size](const string&) { return (double)size * size * sizeof(int); };
+    workload.place = [matrix](int threads) { bench::place_rows(*matrix, threads); };
+    workload.flops = [size](const string&) { return (double)size * size; };
+    return workload;
+}
 
-        for (int t : threads) {
-            const int repetitions = 5;  
-            double total_time = 0.0;
-            int final_result = 0;
-
-            for (int rep = 0; rep < repetitions; rep++) {
-                double start = omp_get_wtime();
-                int result = find_maxmin(matrix, t);
-                double end = omp_get_wtime();
-                total_time += (end - start) * 1000.0;  
-
-                if (rep == 0) final_result = result;  
-            }
-
-            double avg_time = total_time / repetitions;
-
-            if (t == 1) {
-                base_times[size] = avg_time;
+// Анализ матрицы игры: максимин, минимакс и седловые точки. Матрица uniform -
+// та же, что у maximin; в saddle строке size / 3 и столбцу 2 * size / 3
+// заданы значения не меньше и не больше 5000, а на их пересечении - 5000,
+// поэтому седловая точка есть. Result - maximin * 10000 + minimax (элементы в
+// [0, 10000)).
+bench::Workload prepare_game_matrix(int64_t size, const bench::Config& config) {
+    const uint64_t seed = config.seed;
+    const string kind = config.param("matrix", "saddle");
+    const int64_t tile_cols = max<int64_t>(16, config.param_int("tile_cols", GAME_TILE_COLS));
+    shared_ptr<vector<pk::huge_vector<int>>> matrix;
+    if (kind == "uniform") {
+        matrix = make_shared<vector<pk::huge_vector<int>>>(bench::cached_matrix<int, pk::huge_page_allocator<int>>(
+            config, "maximin.uniform_10000", size, size, [seed, size](int64_t i, int64_t j) {
+                return (int)bench::random_below(bench::random_bits(seed, 0, (uint64_t)(i * size + j)), 10000);
+            }));
+    }
+    else {
+        const int64_t saddle_row = size / 3;
+        const int64_t saddle_col = 2 * size / 3;
+        matrix = make_shared<vector<pk::huge_vector<int>>>(bench::cached_matrix<int, pk::huge_page_allocator<int>>(
+            config, "game_matrix.saddle_10000", size, size, [=](int64_t i, int64_t j) {
+                int value = (int)bench::random_below(bench::random_bits(seed, 0, (uint64_t)(i * size + j)), 10000);
+                if (i == saddle_row && j == saddle_col) return 5000;
+                if (i == saddle_row) return 5000 + value / 2;
+                if (j == saddle_col) return value / 2;
+                return value;
+            }));
+    }
+    auto encode = [](const GameAnalysis& game) { return (double)game.maximin * 10000.0 + game.minimax; };
+
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        GameAnalysis game = variant == "blocked" ? analyze_game_matrix(*matrix, threads, tile_cols)
+            : analyze_game_matrix_two_pass(*matrix, threads);
+        bench::RunResult result = encode(game);
+        result.metrics.push_back({ "Maximin", (double)game.maximin });
+        result.metrics.push_back({ "Minimax", (double)game.minimax });
+        result.metrics.push_back({ "Saddle_Points", (double)game.saddle_points() });
+        return result;
+    };
+    workload.reference = [=](const string&) -> double {
+        GameAnalysis game;
+        vector<int> col_max((size_t)size, numeric_limits<int>::min());
+        for (const pk::huge_vector<int>& row : *matrix) {
+            int row_min = numeric_limits<int>::max();
+            for (int64_t j = 0; j < size; j++) {
+                row_min = min(row_min, row[j]);
+                col_max[j] = max(col_max[j], row[j]);
             }
-
-            double base_time = base_times[size];
-            double speedup = base_time / avg_time;
-            double efficiency = (speedup / t) * 100.0;
-
-            output << t << "," << size << "," << fixed << setprecision(3) << avg_time
-                << "," << final_result << "," << speedup << "," << efficiency << "\n";
-
-            cout << "   Потоков: " << setw(2) << t
-                << "    Время: " << setw(10) << avg_time << " мс"
-                << "    Ускорение: " << setw(6) << fixed << setprecision(2) << speedup << "x"
-                << "    Эффективность: " << setw(6) << efficiency << "%"
-                << "    Максимин: " << final_result << endl;
+            game.maximin = max(game.maximin, row_min);
         }
-        cout << endl;
-    }
-
-    output.close();
-
-    return 0;
+        game.minimax = *min_element(col_max.begin(), col_max.end());
+        return encode(game);
+    };
+    workload.elements = [size](const string&) { return (double)size * size; };
+    workload.bytes = [size](const string&) { return (double)size * size * sizeof(int); };
+    workload.place = [matrix](int threads) { bench::place_rows(*matrix, threads); };
+    workload.flops = [size](const string&) { return 2.0 * size * size; };
+    return workload;
 }
+
+const bench::Registrar game_matrix_registrar({
+    "game_matrix", "Максимин, минимакс и седловые точки за один блочный проход (open_mp_4)",
+    { "two_pass", "blocked" },
+    { 1000, 2000, 5000, 10000 },
+    prepare_game_matrix,
+    { "matrix=saddle - матрица: saddle (с седловой точкой) или uniform",
+      "tile_cols=1024 - ширина тайла blocked, столбцов" }
+});
+
+const bench::Registrar maximin_stream_registrar({
+    "maximin_stream", "Максимин матрицы из файла панелями (open_mp_4)",
+    { "in_memory", "streaming" },
+    { 1000, 2000, 5000, 10000 },
+    prepare_maximin_stream,
+    { "file=matrix_stream.bin - временный файл матрицы", "panel_mb=32 - размер панели чтения, МБ" }
+});
+
+}  // namespace
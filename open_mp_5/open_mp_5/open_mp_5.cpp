@@ -1,19 +1,21 @@
-﻿#define NOMINMAX  
-
-#include <iostream>
-#include <omp.h>
+﻿#include <omp.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <windows.h>
 #include <map>
+#include <memory>
 #include <string>
 #include <algorithm>
-#include <iomanip>
 #include <limits>
+#include <iostream>
+#include <stdexcept>
+
+#include "bench.h"
+#include "dataset.h"
+#include "parallel_kernels.hpp"
+#include "row_min.h"
 
 using namespace std;
+namespace pk = parallel_kernels;
 
 enum MatrixType {
     DIAGONAL,      
@@ -22,170 +24,127 @@ enum MatrixType {
 };
 
 
-vector<vector<int>> create_special_matrix(int size, MatrixType type) {
-    vector<vector<int>> matrix(size, vector<int>(size, 0));
-
-    switch (type) {
-    case DIAGONAL:
-        for (int i = 0; i < size; i++) {
-            matrix[i][i] = rand() % 100 + 1;
-        }
-        break;
-
-    case TRIANGULAR:
-        for (int i = 0; i < size; i++) {
-            for (int j = i; j < size; j++) {
-                matrix[i][j] = rand() % 100 + 1;
-            }
-        }
-        break;
+// Ненулевые элементы равномерны в [1, 100]; у каждого типа свой набор в кэше.
+vector<vector<int>> create_special_matrix(const bench::Config& config, int size, MatrixType type) {
+    static const char* const generators[] = {
+        "maximin_schedule.diagonal_1_100", "maximin_schedule.triangular_1_100", "maximin_schedule.banded_1_100"
+    };
+    const uint64_t seed = config.seed;
+    return bench::cached_matrix<int>(config, generators[type], size, size, [=](int64_t i, int64_t j) {
+        bool nonzero = type == DIAGONAL ? i == j : type == TRIANGULAR ? j >= i : j >= i - 2 && j <= i + 2;
+        return nonzero ? (int)bench::random_below(bench::random_bits(seed, type, (uint64_t)(i * size + j)), 100) + 1 : 0;
+    });
+}
 
-    case BANDED:
-        for (int i = 0; i < size; i++) {
-            int start = max(0, i - 2);
-            int end = min(size - 1, i + 2);
-            for (int j = start; j <= end; j++) {
-                matrix[i][j] = rand() % 100 + 1;
-            }
-        }
-        break;
-    }
-    return matrix;
+// Минимум ненулевых элементов строки; для строки из одних нулей - наименьшее
+// int, чтобы она не влияла на максимум. nonzero_min - реализация из row_min.h,
+// по умолчанию AVX-512/AVX2 по процессору, без перехода на каждом элементе.
+inline int nonzero_row_min(const vector<int>& row, NonzeroMinFunction nonzero_min = default_nonzero_min()) {
+    int min_in_row = nonzero_min(row.data(), (int64_t)row.size());
+    return min_in_row == numeric_limits<int>::max() ? numeric_limits<int>::min() : min_in_row;
 }
 
-int find_maximin_schedule(const vector<vector<int>>& matrix, int num_threads, const string& schedule_type, int chunk_size = 10) {
-    int n = (int)matrix.size();
-    int global_max_of_mins = numeric_limits<int>::min();
+// Каждый поток копит свой максимум и объединяет его в critical - при любом
+// schedule. Стратегия выбирается типом Schedule на этапе компиляции.
+template <typename Schedule>
+int find_maximin_schedule(const vector<vector<int>>& matrix, int num_threads, Schedule schedule,
+    NonzeroMinFunction nonzero_min = default_nonzero_min()) {
+    return pk::max_of_row_mins<pk::critical_combine>((int64_t)matrix.size(), [&matrix, nonzero_min](int64_t i) {
+        return nonzero_row_min(matrix[i], nonzero_min);
+    }, num_threads, schedule);
+}
 
-#pragma omp parallel num_threads(num_threads)
-    {
-        int local_max_of_mins = numeric_limits<int>::min();
+namespace {
 
-        string effective_schedule = schedule_type;
+const char* const MATRIX_TYPE_NAMES[] = { "diagonal", "triangular", "banded" };
 
-        if (effective_schedule == "static") {
-#pragma omp for schedule(static, chunk_size)
-            for (int i = 0; i < n; i++) {
-                int min_in_row = numeric_limits<int>::max();
-                for (int j = 0; j < (int)matrix[i].size(); j++) {
-                    if (matrix[i][j] != 0 && matrix[i][j] < min_in_row) {  
-                        min_in_row = matrix[i][j];
-                    }
-                }
-                if (min_in_row != numeric_limits<int>::max() && min_in_row > local_max_of_mins) {
-                    local_max_of_mins = min_in_row;
-                }
+// Вариант - "<тип матрицы>/<стратегия>", например banded/guided.
+// Матрица каждого типа строится один раз при первом обращении, вне замера.
+// Параметр chunk - размер порции для schedule, row_min - реализация минимума
+// строки (branch - исходный цикл с переходом, для сравнения).
+bench::Workload prepare_maximin_schedule(int64_t size, const bench::Config& config) {
+    const int chunk_size = (int)config.param_int("chunk", 10);
+    const string row_min_name = config.param("row_min", "auto");
+    RowMinKernel row_min;
+    if (!parse_row_min_kernel(row_min_name, row_min)) {
+        throw runtime_error("неизвестная реализация row_min: " + row_min_name);
+    }
+    RowMinKernel selected;
+    const NonzeroMinFunction nonzero_min = select_nonzero_min(row_min, &selected);
+    cerr << "Минимум строки: " << row_min_kernel_name(selected) << "\n";
+    auto matrices = make_shared<map<string, vector<vector<int>>>>();
+
+    auto split_variant = [](const string& variant) {
+        size_t slash = variant.find('/');
+        return make_pair(variant.substr(0, slash), variant.substr(slash + 1));
+    };
+
+    bench::Workload workload;
+    workload.setup = [=](const string& variant, int) {
+        string type_name = split_variant(variant).first;
+        if (matrices->count(type_name) == 0) {
+            int type_idx = 0;
+            while (type_name != MATRIX_TYPE_NAMES[type_idx]) {
+                type_idx++;
             }
+            (*matrices)[type_name] = create_special_matrix(config, (int)size, static_cast<MatrixType>(type_idx));
         }
-        else if (effective_schedule == "dynamic") {
-#pragma omp for schedule(dynamic, chunk_size)
-            for (int i = 0; i < n; i++) {
-                int min_in_row = numeric_limits<int>::max();
-                for (int j = 0; j < (int)matrix[i].size(); j++) {
-                    if (matrix[i][j] != 0 && matrix[i][j] < min_in_row) {
-                        min_in_row = matrix[i][j];
-                    }
-                }
-                if (min_in_row != numeric_limits<int>::max() && min_in_row > global_max_of_mins) {
-                    global_max_of_mins = min_in_row;
-                }
-            }
+    };
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        auto parts = split_variant(variant);
+        const vector<vector<int>>& matrix = matrices->at(parts.first);
+        if (parts.second == "static") {
+            return find_maximin_schedule(matrix, threads, pk::static_schedule{ chunk_size }, nonzero_min);
         }
-        else if (effective_schedule == "guided") {
-#pragma omp for schedule(guided, chunk_size)
-            for (int i = 0; i < n; i++) {
-                int min_in_row = numeric_limits<int>::max();
-                for (int j = 0; j < (int)matrix[i].size(); j++) {
-                    if (matrix[i][j] != 0 && matrix[i][j] < min_in_row) {
-                        min_in_row = matrix[i][j];
-                    }
-                }
-                if (min_in_row != numeric_limits<int>::max() && min_in_row > global_max_of_mins) {
-                    global_max_of_mins = min_in_row;
+        if (parts.second == "dynamic") {
+            return find_maximin_schedule(matrix, threads, pk::dynamic_schedule{ chunk_size }, nonzero_min);
+        }
+        return find_maximin_schedule(matrix, threads, pk::guided_schedule{ chunk_size }, nonzero_min);
+    };
+    workload.reference = [=](const string& variant) -> double {
+        int max_of_mins = numeric_limits<int>::min();
+        for (const vector<int>& row : matrices->at(split_variant(variant).first)) {
+            int min_in_row = numeric_limits<int>::max();
+            for (int value : row) {
+                if (value != 0 && value < min_in_row) {
+                    min_in_row = value;
                 }
             }
-        }
-#pragma omp critical
-        {
-            if (local_max_of_mins > global_max_of_mins) {
-                global_max_of_mins = local_max_of_mins;
+            if (min_in_row != numeric_limits<int>::max()) {
+                max_of_mins = max(max_of_mins, min_in_row);
             }
         }
-    }
-
-    return global_max_of_mins;
+        return max_of_mins;
+    };
+    workload.elements = [size](const string&) { return (double)size * size; };
+    // Нули тоже читаются: пропускается только сравнение с минимумом строки.
+    workload.bytes = [size](const string&) { return (double)size * size * sizeof(int); };
+    workload.place = [matrices](int threads) {
+        for (auto& item : *matrices) {
+            bench::place_rows(item.second, threads);
+        }
+    };
+    workload.flops = [size](const string&) { return 2.0 * size * size; };
+    return workload;
 }
 
-int main() {
-
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("result_omp5.csv");
-    output << "Matrix_Type,Size,Threads,Strategy,Time(ms),Result,Speedup,Efficiency(%)\n";
-
-    srand((unsigned int)time(0));
-
-    vector<int> sizes = { 1000, 5000 };
-    vector<int> threads = { 1, 2, 4, 8 };
-    vector<string> schedules = { "static", "dynamic", "guided" };
-
-    vector<string> type_names = { "Диагональная", "Треугольная", "Ленточная" };
-    vector<string> type_names_en = { "diagonal", "triangular", "banded" };
-
-    map<pair<string, int>, double> base_times;
-
-    for (int type_idx = 0; type_idx <= BANDED; type_idx++) {
-        MatrixType type = static_cast<MatrixType>(type_idx);
-
-        cout << "\n" << type_names[type_idx] << " матрица" << endl;
-
-        for (int size : sizes) {
-            cout << "\n  Размер: " << size << "x" << size << endl;
-
-            auto matrix = create_special_matrix(size, type);
-
-            for (int t : threads) {
-                for (const string& schedule : schedules) {
-                    const int repetitions = 5;
-                    double total_time = 0.0;
-                    int final_result = 0;
-
-                    for (int rep = 0; rep < repetitions; rep++) {
-                        double start = omp_get_wtime();
-                        int result = find_maximin_schedule(matrix, t, schedule);
-                        double end = omp_get_wtime();
-                        total_time += (end - start) * 1000.0;
-
-                        if (rep == 0) final_result = result;
-                    }
-
-                    double avg_time = total_time / repetitions;
-
-                    if (t == 1) {
-                        base_times[{type_names_en[type_idx], size}] = avg_time;
-                    }
-
-                    double base_time = base_times[{type_names_en[type_idx], size}];
-                    double speedup = (t == 1) ? 1.0 : (base_time / avg_time);
-                    double efficiency = (speedup / t) * 100.0;
-
-                    output << type_names_en[type_idx] << "," << size << "," << t << ","
-                        << schedule << "," << fixed << setprecision(3) << avg_time << ","
-                        << final_result << "," << speedup << "," << efficiency << "\n";
-
-                    cout << "   Потоков: " << setw(2) << t
-                        << "    Стратегия: " << setw(8) << schedule
-                        << "    Время: " << setw(8) << avg_time << " мс"
-                        << "    Ускорение: " << setw(5) << fixed << setprecision(2) << speedup << "x"
-                        << "    Эффективность: " << setw(5) << efficiency << "%"
-                        << "    Результат: " << final_result << endl;
-                }
-            }
+vector<string> maximin_schedule_variants() {
+    vector<string> variants;
+    for (const char* type_name : MATRIX_TYPE_NAMES) {
+        for (const char* schedule : { "static", "dynamic", "guided" }) {
+            variants.push_back(string(type_name) + "/" + schedule);
         }
     }
+    return variants;
+}
 
-    output.close();
+const bench::Registrar maximin_schedule_registrar({
+    "maximin_schedule", "Максимин специальных матриц при разных schedule (open_mp_5)",
+    maximin_schedule_variants(),
+    { 1000, 5000 },
+    prepare_maximin_schedule,
+    { "chunk=10 - размер порции schedule",
+      "row_min=auto - минимум строки: auto, avx512, avx2, simd, branch" }
+});
 
-    return 0;
-}
+}  // namespace
@@ -0,0 +1,163 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ROW_MIN_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+// Минимум ненулевых элементов строки без условного перехода на элемент.
+//
+// Нули заменяются на INT_MAX сравнением и смешиванием (blend), после чего
+// берётся обычный минимум по 8 (AVX2) или 16 (AVX-512, маска вместо blend)
+// элементов за инструкцию; хвост строки у AVX-512 читается маскированной
+// загрузкой. Реализация выбирается во время выполнения по CPUID
+// (__builtin_cpu_supports учитывает и поддержку регистров ОС), поэтому
+// бинарник без -march=native работает на любом x86-64. На других
+// платформах и в MSVC - переносимый цикл omp simd с тем же отображением нулей.
+//
+// Результат - INT_MAX, если в строке нет ненулевых элементов.
+
+enum class RowMinKernel { automatic, avx512, avx2, simd, branch };
+
+inline const char* row_min_kernel_name(RowMinKernel kernel) {
+    switch (kernel) {
+    case RowMinKernel::avx512: return "avx512";
+    case RowMinKernel::avx2: return "avx2";
+    case RowMinKernel::simd: return "simd";
+    case RowMinKernel::branch: return "branch";
+    default: return "auto";
+    }
+}
+
+inline bool parse_row_min_kernel(const std::string& name, RowMinKernel& kernel) {
+    for (RowMinKernel k : { RowMinKernel::automatic, RowMinKernel::avx512, RowMinKernel::avx2, RowMinKernel::simd,
+             RowMinKernel::branch }) {
+        if (name == row_min_kernel_name(k)) {
+            kernel = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Исходный цикл лабораторной: переход на каждом элементе.
+inline int nonzero_min_branch(const int* data, int64_t n) {
+    int min_in_row = std::numeric_limits<int>::max();
+    for (int64_t i = 0; i < n; i++) {
+        if (data[i] != 0 && data[i] < min_in_row) {
+            min_in_row = data[i];
+        }
+    }
+    return min_in_row;
+}
+
+inline int nonzero_min_simd(const int* data, int64_t n) {
+    const int none = std::numeric_limits<int>::max();
+    int result = none;
+#pragma omp simd reduction(min:result)
+    for (int64_t i = 0; i < n; i++) {
+        int value = data[i] == 0 ? none : data[i];
+        result = value < result ? value : result;
+    }
+    return result;
+}
+
+#ifdef ROW_MIN_X86_DISPATCH
+
+__attribute__((target("avx2")))
+inline int nonzero_min_avx2(const int* data, int64_t n) {
+    const __m256i none = _mm256_set1_epi32(std::numeric_limits<int>::max());
+    const __m256i zero = _mm256_setzero_si256();
+    // Два аккумулятора: цепочки min не ждут друг друга.
+    __m256i min0 = none;
+    __m256i min1 = none;
+    int64_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 8));
+        a = _mm256_blendv_epi8(a, none, _mm256_cmpeq_epi32(a, zero));
+        b = _mm256_blendv_epi8(b, none, _mm256_cmpeq_epi32(b, zero));
+        min0 = _mm256_min_epi32(min0, a);
+        min1 = _mm256_min_epi32(min1, b);
+    }
+    if (i + 8 <= n) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        min0 = _mm256_min_epi32(min0, _mm256_blendv_epi8(a, none, _mm256_cmpeq_epi32(a, zero)));
+        i += 8;
+    }
+    __m256i m = _mm256_min_epi32(min0, min1);
+    __m128i h = _mm_min_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+    int result = _mm_cvtsi128_si32(h);
+    for (; i < n; i++) {
+        int value = data[i] == 0 ? std::numeric_limits<int>::max() : data[i];
+        result = value < result ? value : result;
+    }
+    return result;
+}
+
+__attribute__((target("avx512f")))
+inline int nonzero_min_avx512(const int* data, int64_t n) {
+    const __m512i none = _mm512_set1_epi32(std::numeric_limits<int>::max());
+    __m512i min0 = none;
+    __m512i min1 = none;
+    int64_t i = 0;
+    // Маска ненулевых элементов: нули просто не участвуют в min.
+    for (; i + 32 <= n; i += 32) {
+        __m512i a = _mm512_loadu_si512(data + i);
+        __m512i b = _mm512_loadu_si512(data + i + 16);
+        min0 = _mm512_mask_min_epi32(min0, _mm512_test_epi32_mask(a, a), min0, a);
+        min1 = _mm512_mask_min_epi32(min1, _mm512_test_epi32_mask(b, b), min1, b);
+    }
+    for (; i < n; i += 16) {
+        const int64_t left = n - i;
+        const __mmask16 tail = left >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << left) - 1);
+        __m512i a = _mm512_maskz_loadu_epi32(tail, data + i);
+        min0 = _mm512_mask_min_epi32(min0, _mm512_test_epi32_mask(a, a), min0, a);
+    }
+    return _mm512_reduce_min_epi32(_mm512_min_epi32(min0, min1));
+}
+
+#endif
+
+typedef int (*NonzeroMinFunction)(const int* data, int64_t n);
+
+// Функция для kernel; automatic - лучшая из поддерживаемых процессором.
+// Недоступная явно заданная реализация заменяется на simd.
+inline NonzeroMinFunction select_nonzero_min(RowMinKernel kernel, RowMinKernel* selected = nullptr) {
+    RowMinKernel chosen = kernel;
+#ifdef ROW_MIN_X86_DISPATCH
+    const bool has_avx512 = __builtin_cpu_supports("avx512f");
+    const bool has_avx2 = __builtin_cpu_supports("avx2");
+#else
+    const bool has_avx512 = false;
+    const bool has_avx2 = false;
+#endif
+    if (chosen == RowMinKernel::automatic) {
+        chosen = has_avx512 ? RowMinKernel::avx512 : has_avx2 ? RowMinKernel::avx2 : RowMinKernel::simd;
+    }
+    if ((chosen == RowMinKernel::avx512 && !has_avx512) || (chosen == RowMinKernel::avx2 && !has_avx2)) {
+        chosen = RowMinKernel::simd;
+    }
+    if (selected) {
+        *selected = chosen;
+    }
+    switch (chosen) {
+#ifdef ROW_MIN_X86_DISPATCH
+    case RowMinKernel::avx512: return nonzero_min_avx512;
+    case RowMinKernel::avx2: return nonzero_min_avx2;
+#endif
+    case RowMinKernel::branch: return nonzero_min_branch;
+    default: return nonzero_min_simd;
+    }
+}
+
+inline NonzeroMinFunction default_nonzero_min() {
+    static const NonzeroMinFunction function = select_nonzero_min(RowMinKernel::automatic);
+    return function;
+}
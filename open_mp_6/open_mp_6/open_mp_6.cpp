@@ -1,21 +1,18 @@
-﻿#define NOMINMAX
-
-#include <iostream>
-#include <omp.h>
+﻿#include <omp.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
 #include <cmath>
-#include <windows.h>
-#include <map>
 #include <string>
-#include <iomanip>
-#include <limits>
+#include <algorithm>
+
+#include "bench.h"
+#include "execution.hpp"
+#include "parallel_kernels.hpp"
 
 using namespace std;
+namespace pk = parallel_kernels;
 
-void uneven_workload(int iteration, int vector_size) {
+double uneven_workload(int iteration, int vector_size) {
     vector<double> vec(vector_size);
     double result = 0.0;
 
@@ -61,106 +58,80 @@ void uneven_workload(int iteration, int vector_size) {
         }
     }
 
-    (void)result;
+    return result;
 }
 
-double test_schedule(const string& schedule_type, int num_iterations, int num_threads, int vector_size) {
-    double start_time = omp_get_wtime();
+// Время замеряет вызывающий; возвращается контрольная сумма результатов итераций.
+template <typename Schedule>
+double test_schedule(Schedule schedule, int num_iterations, int num_threads, int vector_size) {
+    return pk::transform_reduce<pk::builtin_combine>((int64_t)num_iterations, 0.0, pk::plus(), [vector_size](int64_t i) {
+        return uneven_workload((int)i, vector_size);
+    }, num_threads, schedule);
+}
 
-    if (schedule_type == "static") {
-#pragma omp parallel for num_threads(num_threads) schedule(static)
-        for (int i = 0; i < num_iterations; i++) {
-            uneven_workload(i, vector_size);
-        }
+// Тот же цикл на исполнителе из execution.hpp; openmp_* - исполнитель OpenMP с
+// тем же schedule, что и static/dynamic/guided, но со свёрткой исполнителя,
+// как у pool_* и serial.
+template <typename Backend>
+double test_schedule_on(const Backend& backend, int num_iterations, int vector_size) {
+    return backend.parallel_reduce((int64_t)num_iterations, 0.0, pk::plus(), [vector_size](int64_t i) {
+        return uneven_workload((int)i, vector_size);
+    });
+}
+
+double test_schedule(const string& schedule_type, int num_iterations, int num_threads, int vector_size) {
+    if (schedule_type == "pool_static") {
+        return test_schedule_on(execution::pool_backend(num_threads), num_iterations, vector_size);
     }
-    else if (schedule_type == "dynamic") {
-#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 10)
-        for (int i = 0; i < num_iterations; i++) {
-            uneven_workload(i, vector_size);
-        }
+    if (schedule_type == "pool_dynamic") {
+        return test_schedule_on(execution::pool_backend(num_threads, execution::partition::dynamic_chunks, 10),
+            num_iterations, vector_size);
     }
-    else if (schedule_type == "guided") {
-#pragma omp parallel for num_threads(num_threads) schedule(guided, 10)
-        for (int i = 0; i < num_iterations; i++) {
-            uneven_workload(i, vector_size);
-        }
+    if (schedule_type == "openmp_static") {
+        return test_schedule_on(execution::openmp_backend<pk::static_schedule>(num_threads), num_iterations, vector_size);
     }
-
-    return (omp_get_wtime() - start_time) * 1000.0;
-}
-
-int main() {
-
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("result_omp6.csv");
-    output << "Schedule_Type,Vector_Size,Iterations,Threads,Time(ms),Speedup,Efficiency(%)\n";
-
-    srand((unsigned int)time(0));
-
-    vector<int> vector_sizes = { 1000, 5000, 10000 };
-    vector<int> iterations_list = { 200 };  
-    vector<int> threads_list = { 1, 2, 4, 8, 16 };
-    vector<string> schedules = { "static", "dynamic", "guided" };
-
-    map<pair<string, int>, double> base_times;
-
-    cout << "Однопоточный случай:" << endl;
-    for (int vector_size : vector_sizes) {
-        for (const string& schedule : schedules) {
-            const int repetitions = 5;
-            double total_time = 0.0;
-
-            for (int rep = 0; rep < repetitions; rep++) {
-                double time_ms = test_schedule(schedule, iterations_list[0], 1, vector_size);
-                total_time += time_ms;
-            }
-
-            double avg_time = total_time / repetitions;
-            base_times[{schedule, vector_size}] = avg_time;
-
-            cout << "   Размер: " << setw(6) << vector_size
-                << "    Стратегия: " << setw(8) << schedule
-                << "    Время: " << setw(8) << avg_time << " мс" << endl;
-        }
+    if (schedule_type == "openmp_dynamic") {
+        return test_schedule_on(execution::openmp_backend<pk::dynamic_schedule>(num_threads, pk::dynamic_schedule{ 10 }),
+            num_iterations, vector_size);
     }
+    if (schedule_type == "openmp_guided") {
+        return test_schedule_on(execution::openmp_backend<pk::guided_schedule>(num_threads, pk::guided_schedule{ 10 }),
+            num_iterations, vector_size);
+    }
+    if (schedule_type == "serial") return test_schedule_on(execution::serial_backend(), num_iterations, vector_size);
+    if (schedule_type == "static") return test_schedule(pk::static_schedule(), num_iterations, num_threads, vector_size);
+    if (schedule_type == "dynamic") return test_schedule(pk::dynamic_schedule{ 10 }, num_iterations, num_threads, vector_size);
+    return test_schedule(pk::guided_schedule{ 10 }, num_iterations, num_threads, vector_size);
+}
 
+namespace {
 
-    for (int vector_size : vector_sizes) {
-        cout << "\nРазмер вектора: " << vector_size << endl;
-
-        for (int threads : threads_list) {
-            if (threads == 1) continue;
-
-            for (const string& schedule : schedules) {
-                const int repetitions = 5;
-                double total_time = 0.0;
-
-                for (int rep = 0; rep < repetitions; rep++) {
-                    double time_ms = test_schedule(schedule, iterations_list[0], threads, vector_size);
-                    total_time += time_ms;
-                }
-
-                double avg_time = total_time / repetitions;
-                double base_time = base_times[{schedule, vector_size}];
-                double speedup = base_time / avg_time;
-                double efficiency = (speedup / threads) * 100.0;
-
-                output << schedule << "," << vector_size << "," << iterations_list[0]
-                    << "," << threads << "," << fixed << setprecision(3) << avg_time
-                    << "," << speedup << "," << efficiency << "\n";
+// size - длина вектора в одной итерации; параметр iterations - число итераций.
+bench::Workload prepare_schedule(int64_t size, const bench::Config& config) {
+    const int iterations = (int)config.param_int("iterations", 200);
 
-                cout << "   Потоков: " << setw(2) << threads
-                    << "    Стратегия: " << setw(8) << schedule
-                    << "    Время: " << setw(8) << avg_time << " мс"
-                    << "    Ускорение: " << setw(5) << fixed << setprecision(2) << speedup << "x"
-                    << "    Эффективность: " << setw(5) << efficiency << "%" << endl;
-            }
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        return test_schedule(variant, iterations, threads, (int)size);
+    };
+    workload.reference = [=](const string&) -> double {
+        double checksum = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            checksum += uneven_workload(i, (int)size);
         }
-    }
+        return checksum;
+    };
+    workload.elements = [=](const string&) { return (double)iterations * size; };
+    return workload;
+}
 
-    output.close();
+const bench::Registrar schedule_registrar({
+    "schedule", "Неравномерная нагрузка при разных schedule (open_mp_6)",
+    { "static", "dynamic", "guided", "openmp_static", "openmp_dynamic", "openmp_guided", "pool_static", "pool_dynamic",
+      "serial" },
+    { 1000, 5000, 10000 },
+    prepare_schedule,
+    { "iterations=200 - число итераций цикла" }
+});
 
-    return 0;
-}
+}  // namespace
@@ -1,240 +1,141 @@
-﻿#define NOMINMAX
-
-#include <iostream>
-#include <omp.h>
+﻿#include <omp.h>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <cmath>
-#include <windows.h>
-#include <map>
+#include <memory>
 #include <string>
-#include <iomanip>
-#include <limits>
+
+#include "bench.h"
+#include "dataset.h"
+#include "execution.hpp"
+#include "huge_pages.hpp"
+#include "mixed_precision.hpp"
+#include "parallel_kernels.hpp"
 
 using namespace std;
+namespace pk = parallel_kernels;
 
-vector<double> generate_data(int size) {
-    vector<double> data(size);
-    for (int i = 0; i < size; i++) {
-        data[i] = (rand() % 1000) / 10.0;  
-    }
-    return data;
+// Значения (0..999) / 10 - как rand() % 1000 / 10.0, но воспроизводимо.
+pk::huge_vector<double> generate_data(const bench::Config& config, int size) {
+    const uint64_t seed = config.seed;
+    return bench::cached_vector<double>(config, "reduction.uniform_1000_div10", size,
+        [seed](int64_t i) { return bench::random_below(bench::random_bits(seed, 0, (uint64_t)i), 1000) / 10.0; });
 }
 
-double reduction_atomic(const vector<double>& data, int num_threads) {
-    double sum = 0.0;
-    double start_time = omp_get_wtime();
-
-#pragma omp parallel num_threads(num_threads)
-    {
-        double local_sum = 0.0;
-
-#pragma omp for
-        for (int i = 0; i < data.size(); i++) {
-            local_sum += data[i];
-        }
-
-#pragma omp atomic
-        sum += local_sum;
-    }
-
-    double end_time = omp_get_wtime();
-    return (end_time - start_time) * 1000.0;
+double reduction_atomic(const pk::huge_vector<double>& data, int num_threads) {
+    return pk::sum<pk::atomic_combine>(data.data(), (int64_t)data.size(), num_threads);
 }
 
-double reduction_critical(const vector<double>& data, int num_threads) {
-    double sum = 0.0;
-    double start_time = omp_get_wtime();
-
-#pragma omp parallel num_threads(num_threads)
-    {
-        double local_sum = 0.0;
-
-#pragma omp for
-        for (int i = 0; i < data.size(); i++) {
-            local_sum += data[i];
-        }
+double reduction_critical(const pk::huge_vector<double>& data, int num_threads) {
+    return pk::sum<pk::critical_combine>(data.data(), (int64_t)data.size(), num_threads);
+}
 
-#pragma omp critical
-        {
-            sum += local_sum;
-        }
-    }
+double reduction_lock(const pk::huge_vector<double>& data, int num_threads) {
+    return pk::sum<pk::lock_combine>(data.data(), (int64_t)data.size(), num_threads);
+}
 
-    double end_time = omp_get_wtime();
-    return (end_time - start_time) * 1000.0;
+double reduction_builtin(const pk::huge_vector<double>& data, int num_threads) {
+    return pk::sum<pk::builtin_combine>(data.data(), (int64_t)data.size(), num_threads);
 }
 
-double reduction_lock(const vector<double>& data, int num_threads) {
-    double sum = 0.0;
-    omp_lock_t lock;
-    omp_init_lock(&lock);
+// Частичные суммы в ячейках потоков на разных кэш-линиях, без синхронизации.
+double reduction_padded(const pk::huge_vector<double>& data, int num_threads) {
+    return pk::sum<pk::padded_slots>(data.data(), (int64_t)data.size(), num_threads);
+}
 
-    double start_time = omp_get_wtime();
+// Сумма на исполнителе из execution.hpp (OpenMP, пул потоков, последовательно).
+template <typename Backend>
+double reduction_backend(const Backend& backend, const pk::huge_vector<double>& data) {
+    const double* values = data.data();
+    return backend.parallel_reduce((int64_t)data.size(), 0.0, pk::plus(), [values](int64_t i) { return values[i]; });
+}
 
-#pragma omp parallel num_threads(num_threads)
-    {
-        double local_sum = 0.0;
+// Сумма при хранении T с накоплением в double, обычным или компенсированным.
+template <typename T, typename Alloc>
+double reduction_precision(const vector<T, Alloc>& data, bool compensated, int num_threads) {
+    return compensated ? pk::sum_compensated(data.data(), (int64_t)data.size(), num_threads)
+        : pk::sum_wide(data.data(), (int64_t)data.size(), num_threads);
+}
 
-#pragma omp for
-        for (int i = 0; i < data.size(); i++) {
-            local_sum += data[i];
+namespace {
+
+bench::Workload prepare_reduction(int64_t size, const bench::Config& config) {
+    auto data = make_shared<pk::huge_vector<double>>(generate_data(config, (int)size));
+
+    bench::Workload workload;
+    workload.run = [data](const string& variant, int threads) -> bench::RunResult {
+        if (variant == "atomic") return reduction_atomic(*data, threads);
+        if (variant == "critical") return reduction_critical(*data, threads);
+        if (variant == "lock") return reduction_lock(*data, threads);
+        if (variant == "padded") return reduction_padded(*data, threads);
+        if (variant == "openmp") return reduction_backend(execution::openmp_backend<>(threads), *data);
+        if (variant == "pool") return reduction_backend(execution::pool_backend(threads), *data);
+        if (variant == "serial") return reduction_backend(execution::serial_backend(), *data);
+        return reduction_builtin(*data, threads);
+    };
+    workload.reference = [data](const string&) -> double {
+        double sum = 0.0;
+        for (double value : *data) {
+            sum += value;
         }
-
-        omp_set_lock(&lock);
-        sum += local_sum;
-        omp_unset_lock(&lock);
-    }
-
-    double end_time = omp_get_wtime();
-    omp_destroy_lock(&lock);
-
-    return (end_time - start_time) * 1000.0;
+        return sum;
+    };
+    workload.bytes = [size](const string&) { return (double)size * sizeof(double); };
+    workload.place = [data](int threads) { bench::place_vector(*data, threads); };
+    workload.flops = [size](const string&) { return (double)size; };
+    return workload;
 }
 
-double reduction_builtin(const vector<double>& data, int num_threads) {
-    double sum = 0.0;
-    double start_time = omp_get_wtime();
-
-#pragma omp parallel for reduction(+:sum) num_threads(num_threads)
-    for (int i = 0; i < data.size(); i++) {
-        sum += data[i];
-    }
-
-    double end_time = omp_get_wtime();
-    return (end_time - start_time) * 1000.0;
+const bench::Registrar reduction_registrar({
+    "reduction", "Суммирование: atomic, critical, замки, встроенная редукция, ячейки потоков, исполнители OpenMP и пул std::thread (open_mp_7)",
+    { "atomic", "critical", "lock", "reduction", "padded", "openmp", "pool", "serial" },
+    { 100000, 500000, 1000000, 5000000 },
+    prepare_reduction
+});
+
+// Вариант - "<хранение>[_compensated]": f64, f32 или bf16. Результат сверяется
+// с последовательной суммой тех же хранимых значений, а Rel_Error - отклонение
+// от суммы исходных double, т.е. цена уменьшенного хранения.
+bench::Workload prepare_reduction_precision(int64_t size, const bench::Config& config) {
+    auto data = make_shared<pk::huge_vector<double>>(generate_data(config, (int)size));
+    auto data_f32 = make_shared<vector<float>>(pk::convert_vector<float>(*data));
+    auto data_bf16 = make_shared<vector<pk::bfloat16>>(pk::convert_vector<pk::bfloat16>(*data));
+    const double full = reduction_precision(*data, true, 1);
+
+    auto storage = [](const string& variant) { return variant.substr(0, variant.find('_')); };
+
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        bool compensated = variant.find("_compensated") != string::npos;
+        string type = storage(variant);
+        bench::RunResult result = type == "f64" ? reduction_precision(*data, compensated, threads)
+            : type == "f32" ? reduction_precision(*data_f32, compensated, threads)
+            : reduction_precision(*data_bf16, compensated, threads);
+        result.metrics.push_back({ "Rel_Error", fabs(result.value - full) / fabs(full) });
+        return result;
+    };
+    workload.reference = [=](const string& variant) -> double {
+        string type = storage(variant);
+        return type == "f64" ? full : type == "f32" ? reduction_precision(*data_f32, true, 1)
+            : reduction_precision(*data_bf16, true, 1);
+    };
+    workload.bytes = [=](const string& variant) {
+        string type = storage(variant);
+        return (double)size * (type == "f64" ? sizeof(double) : type == "f32" ? sizeof(float) : sizeof(pk::bfloat16));
+    };
+    workload.flops = [size](const string&) { return (double)size; };
+    workload.place = [=](int threads) {
+        bench::place_vector(*data, threads);
+        bench::place_vector(*data_f32, threads);
+        bench::place_vector(*data_bf16, threads);
+    };
+    return workload;
 }
 
-int main() {
+const bench::Registrar reduction_precision_registrar({
+    "reduction_precision", "Суммирование при хранении float32/bfloat16 с накоплением в double (open_mp_7)",
+    { "f64", "f32", "bf16", "f32_compensated", "bf16_compensated" },
+    { 1000000, 5000000, 20000000 },
+    prepare_reduction_precision
+});
 
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
-
-    ofstream output("result_omp7.csv");
-
-    output << "Method,Data_Size,Threads,Time(ms),Speedup,Efficiency(%),Result\n";
-
-    srand(static_cast<unsigned int>(time(0)));
-
-    vector<int> data_sizes = { 100000, 500000, 1000000, 5000000 };
-    vector<int> threads_list = { 1, 2, 4, 8, 16 };
-
-    vector<string> method_names = { "atomic", "critical", "lock", "reduction" };
-    vector<string> method_names_ru = { "Атомарные операции", "Критические секции", "Замки", "Встроенная редукция" };
-
-    map<pair<string, int>, double> base_times;
-
-    cout << "Однопоточный случай:" << endl;
-
-    for (int data_size : data_sizes) {
-        vector<double> data = generate_data(data_size);
-
-        double reference_sum = 0.0;
-        for (double val : data) reference_sum += val;
-
-        for (size_t method_idx = 0; method_idx < method_names.size(); method_idx++) {
-            const string& method = method_names[method_idx];
-            const int repetitions = 7;  
-
-            double total_time = 0.0;
-
-            for (int rep = 0; rep < repetitions; rep++) {
-                double time_ms = 0.0;
-
-                if (method == "atomic") {
-                    time_ms = reduction_atomic(data, 1);
-                }
-                else if (method == "critical") {
-                    time_ms = reduction_critical(data, 1);
-                }
-                else if (method == "lock") {
-                    time_ms = reduction_lock(data, 1);
-                }
-                else if (method == "reduction") {
-                    time_ms = reduction_builtin(data, 1);
-                }
-
-                total_time += time_ms;
-            }
-
-            double avg_time = total_time / repetitions;
-            base_times[{method, data_size}] = avg_time;
-
-            cout << "   Размер: " << setw(8) << data_size
-                << "    Метод: " << setw(25) << method_names_ru[method_idx]
-                << "    Время: " << setw(8) << fixed << setprecision(2) << avg_time << " мс" << endl;
-        }
-        cout << endl;
-    }
-
-    int test_counter = 0;
-    int total_tests = data_sizes.size() * threads_list.size() * method_names.size();
-
-    for (int data_size : data_sizes) {
-        cout << "\nРазмер данных: " << data_size << endl;
-
-        vector<double> data = generate_data(data_size);
-
-        for (int threads : threads_list) {
-            if (threads == 1) continue;
-
-            cout << "\n  Потоков: " << threads << endl;
-
-            for (size_t method_idx = 0; method_idx < method_names.size(); method_idx++) {
-                test_counter++;
-                const string& method = method_names[method_idx];
-
-                const int repetitions = 7;
-                double total_time = 0.0;
-                double final_result = 0.0;
-
-                for (int rep = 0; rep < repetitions; rep++) {
-                    double time_ms = 0.0;
-                    double result = 0.0;
-
-                    if (method == "atomic") {
-                        time_ms = reduction_atomic(data, threads);
-                    }
-                    else if (method == "critical") {
-                        time_ms = reduction_critical(data, threads);
-                    }
-                    else if (method == "lock") {
-                        time_ms = reduction_lock(data, threads);
-                    }
-                    else if (method == "reduction") {
-                        time_ms = reduction_builtin(data, threads);
-                    }
-
-                    total_time += time_ms;
-
-                    if (rep == 0) {
-                        result = 0.0;
-                        for (double val : data) result += val;
-                        final_result = result;
-                    }
-                }
-
-                double avg_time = total_time / repetitions;
-                double base_time = base_times[{method, data_size}];
-                double speedup = base_time / avg_time;
-                double efficiency = (speedup / threads) * 100.0;
-
-                output << method << "," << data_size << "," << threads << ","
-                    << fixed << setprecision(3) << avg_time << ","
-                    << speedup << "," << efficiency << ","
-                    << scientific << setprecision(6) << final_result << "\n";
-
-                cout << "    " << setw(25) << left << method_names_ru[method_idx]
-                    << "    Время: " << setw(8) << fixed << setprecision(2) << avg_time << " мс"
-                    << "    Ускорение: " << setw(5) << fixed << setprecision(2) << speedup << "x"
-                    << "    Эффективность: " << setw(5) << efficiency << "%" << endl;
-            }
-        }
-    }
-
-    output.close();
-
-    return 0;
-}
+}  // namespace
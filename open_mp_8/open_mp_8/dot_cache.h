@@ -0,0 +1,195 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vector_file.h"
+
+// Кэш скалярных произведений рядом с файлом данных (<файл>.dotcache).
+// Для каждой пары и длины обработанного префикса хранится хэш содержимого
+// её чанка и результат. Если при следующем запуске хэш и длина совпали,
+// пара берётся из кэша без чтения данных (v2) или без вычисления (v1).
+//
+// Формат: magic[8], uint32 version, uint32 reserved, int64 count,
+// count x DotCacheEntry, uint32 crc32c всего предыдущего.
+
+static const char DOT_CACHE_MAGIC[8] = { 'O', 'M', 'P', 'D', 'O', 'T', 'C', '1' };
+
+#pragma pack(push, 1)
+struct DotCacheEntry {
+    int64_t pair;
+    int64_t length;
+    uint64_t content_hash;
+    double dot;
+};
+#pragma pack(pop)
+
+struct DotCacheStats {
+    int hits = 0;
+    int misses = 0;
+    double miss_time = 0.0;  // сек на чтение и вычисление промахов
+
+    double hit_rate() const {
+        int total = hits + misses;
+        return total > 0 ? (double)hits / total : 0.0;
+    }
+
+    // Оценка сэкономленного времени: попадания по средней цене промаха.
+    double saved_time() const {
+        return misses > 0 ? hits * (miss_time / misses) : 0.0;
+    }
+};
+
+inline uint64_t mix_hash(uint64_t h, uint64_t v) {
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 29);
+}
+
+// Хэш чанка v2 берётся из индекса: CRC32C хранимых байт, размер, кодирование
+// и позиция пары внутри чанка. Данные читать не нужно.
+inline bool pair_chunk_hash(const VectorFileReader& reader, int64_t pair, uint64_t& hash) {
+    if (reader.version() != 2) {
+        return false;
+    }
+    const VectorFileHeader& header = reader.file_header();
+    const ChunkIndexEntry& entry = reader.chunk_index()[pair / header.pairs_per_chunk];
+
+    hash = mix_hash(0, entry.crc);
+    hash = mix_hash(hash, entry.stored_size);
+    hash = mix_hash(hash, entry.compression);
+    hash = mix_hash(hash, header.dtype);
+    hash = mix_hash(hash, (uint64_t)(pair % header.pairs_per_chunk));
+    return true;
+}
+
+// Для v1 индекса нет: хэшируется сама обработанная часть пары.
+template <typename Alloc>
+uint64_t pair_data_hash(const std::vector<double, Alloc>& vec1, const std::vector<double, Alloc>& vec2) {
+    uint64_t h1 = crc32c(vec1.data(), vec1.size() * sizeof(double));
+    uint64_t h2 = crc32c(vec2.data(), vec2.size() * sizeof(double));
+    return mix_hash(mix_hash(1, h1), h2);
+}
+
+class DotProductCache {
+private:
+    std::map<std::pair<int64_t, int64_t>, DotCacheEntry> entries;
+    bool modified = false;
+
+public:
+    DotCacheStats stats;
+
+    static std::string sidecar_path(const std::string& data_filename) {
+        return data_filename + ".dotcache";
+    }
+
+    size_t size() const { return entries.size(); }
+
+    bool lookup(int64_t pair, int64_t length, uint64_t content_hash, double& dot) const {
+        auto it = entries.find({ pair, length });
+        if (it == entries.end() || it->second.content_hash != content_hash) {
+            return false;
+        }
+        dot = it->second.dot;
+        return true;
+    }
+
+    void store(int64_t pair, int64_t length, uint64_t content_hash, double dot) {
+        entries[{ pair, length }] = DotCacheEntry{ pair, length, content_hash, dot };
+        modified = true;
+    }
+
+    void clear() {
+        entries.clear();
+        modified = true;
+    }
+
+    // Отсутствующий или повреждённый файл означает пустой кэш.
+    bool load(const std::string& path) {
+        entries.clear();
+        modified = false;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        char magic[8];
+        uint32_t version_and_reserved[2];
+        int64_t count = 0;
+        if (!file.read(magic, sizeof(magic)) || memcmp(magic, DOT_CACHE_MAGIC, sizeof(magic)) != 0
+            || !file.read(reinterpret_cast<char*>(version_and_reserved), sizeof(version_and_reserved))
+            || !file.read(reinterpret_cast<char*>(&count), sizeof(count)) || count < 0) {
+            return false;
+        }
+
+        std::vector<DotCacheEntry> list((size_t)count);
+        uint32_t stored_crc = 0;
+        if (!file.read(reinterpret_cast<char*>(list.data()), list.size() * sizeof(DotCacheEntry))
+            || !file.read(reinterpret_cast<char*>(&stored_crc), sizeof(stored_crc))) {
+            return false;
+        }
+
+        uint32_t crc = crc32c(magic, sizeof(magic));
+        crc = crc32c_update(crc, version_and_reserved, sizeof(version_and_reserved));
+        crc = crc32c_update(crc, &count, sizeof(count));
+        crc = crc32c_update(crc, list.data(), list.size() * sizeof(DotCacheEntry));
+        if (crc != stored_crc || version_and_reserved[0] != 1) {
+            return false;
+        }
+
+        for (const DotCacheEntry& entry : list) {
+            entries[{ entry.pair, entry.length }] = entry;
+        }
+        return true;
+    }
+
+    // Запись во временный файл и переименование: прерванное сохранение не портит кэш.
+    bool save(const std::string& path) {
+        if (!modified) {
+            return true;
+        }
+
+        std::vector<DotCacheEntry> list;
+        list.reserve(entries.size());
+        for (const auto& item : entries) {
+            list.push_back(item.second);
+        }
+
+        uint32_t version_and_reserved[2] = { 1, 0 };
+        int64_t count = (int64_t)list.size();
+        uint32_t crc = crc32c(DOT_CACHE_MAGIC, sizeof(DOT_CACHE_MAGIC));
+        crc = crc32c_update(crc, version_and_reserved, sizeof(version_and_reserved));
+        crc = crc32c_update(crc, &count, sizeof(count));
+        crc = crc32c_update(crc, list.data(), list.size() * sizeof(DotCacheEntry));
+
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return false;
+            }
+            file.write(DOT_CACHE_MAGIC, sizeof(DOT_CACHE_MAGIC));
+            file.write(reinterpret_cast<const char*>(version_and_reserved), sizeof(version_and_reserved));
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            file.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(DotCacheEntry));
+            file.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+            if (!file) {
+                return false;
+            }
+        }
+
+        std::remove(path.c_str());
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            return false;
+        }
+        modified = false;
+        return true;
+    }
+};
@@ -0,0 +1,320 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Файл с позиционной записью и чтением: несколько потоков пишут в свои
+// участки без общего указателя позиции (pwrite / WriteFile с OVERLAPPED).
+
+class RandomAccessFile {
+private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+public:
+    RandomAccessFile() = default;
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+    ~RandomAccessFile() { close(); }
+
+#ifdef _WIN32
+    bool is_open() const { return handle != INVALID_HANDLE_VALUE; }
+
+    bool create(const std::string& filename) {
+        handle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return is_open();
+    }
+
+    bool open_read(const std::string& filename) {
+        handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return is_open();
+    }
+
+    bool write_at(const void* data, size_t size, uint64_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            OVERLAPPED ov{};
+            ov.Offset = (DWORD)(offset & 0xFFFFFFFFu);
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD part = (DWORD)std::min<size_t>(size, 1u << 30);
+            DWORD written = 0;
+            if (!WriteFile(handle, p, part, &written, &ov) || written == 0) return false;
+            p += written;
+            offset += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool read_at(void* data, size_t size, uint64_t offset) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            OVERLAPPED ov{};
+            ov.Offset = (DWORD)(offset & 0xFFFFFFFFu);
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD part = (DWORD)std::min<size_t>(size, 1u << 30);
+            DWORD got = 0;
+            if (!ReadFile(handle, p, part, &got, &ov) || got == 0) return false;
+            p += got;
+            offset += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    bool truncate(uint64_t size) {
+        FILE_END_OF_FILE_INFO info{};
+        info.EndOfFile.QuadPart = (LONGLONG)size;
+        return SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+    }
+
+    // На NTFS установка конца файла резервирует место под весь файл.
+    bool preallocate(uint64_t size) { return truncate(size); }
+
+    uint64_t size() const {
+        LARGE_INTEGER s{};
+        return GetFileSizeEx(handle, &s) ? (uint64_t)s.QuadPart : 0;
+    }
+
+    bool sync() { return FlushFileBuffers(handle) != 0; }
+
+    void start_writeback(uint64_t, uint64_t) {}
+    void drop_cached(uint64_t, uint64_t) {}
+
+    void close() {
+        if (is_open()) {
+            CloseHandle(handle);
+            handle = INVALID_HANDLE_VALUE;
+        }
+    }
+#else
+    bool is_open() const { return fd >= 0; }
+
+    bool create(const std::string& filename) {
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        return is_open();
+    }
+
+    bool open_read(const std::string& filename) {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        return is_open();
+    }
+
+    bool write_at(const void* data, size_t size, uint64_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = ::pwrite(fd, p, size, (off_t)offset);
+            if (written <= 0) return false;
+            p += written;
+            offset += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool read_at(void* data, size_t size, uint64_t offset) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t got = ::pread(fd, p, size, (off_t)offset);
+            if (got <= 0) return false;
+            p += got;
+            offset += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    bool truncate(uint64_t size) {
+        return ::ftruncate(fd, (off_t)size) == 0;
+    }
+
+    // Место под файл выделяется целиком до записи: экстенты идут подряд,
+    // а параллельные pwrite не расширяют файл каждый раз заново.
+    bool preallocate(uint64_t size) {
+#ifdef __linux__
+        if (::fallocate(fd, 0, 0, (off_t)size) == 0) return true;
+#endif
+        if (::posix_fallocate(fd, 0, (off_t)size) == 0) return true;
+        return truncate(size);
+    }
+
+    uint64_t size() const {
+        struct stat st;
+        return ::fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    }
+
+    bool sync() {
+#ifdef __linux__
+        return ::fdatasync(fd) == 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
+    }
+
+    // Запустить запись диапазона на диск, не дожидаясь её окончания.
+    void start_writeback(uint64_t offset, uint64_t size) {
+#ifdef __linux__
+        ::sync_file_range(fd, (off_t)offset, (off_t)size, SYNC_FILE_RANGE_WRITE);
+#else
+        (void)offset;
+        (void)size;
+#endif
+    }
+
+    // Дождаться записи диапазона и убрать его из page cache.
+    void drop_cached(uint64_t offset, uint64_t size) {
+#ifdef __linux__
+        ::sync_file_range(fd, (off_t)offset, (off_t)size,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+#ifdef POSIX_FADV_DONTNEED
+        ::posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    void close() {
+        if (is_open()) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+#endif
+};
+
+// Отложенная запись: потоки-генераторы берут свободный буфер, заполняют его и
+// отдают потоку ввода-вывода вместе со смещением. Ограниченный пул буферов
+// даёт обратное давление, а запись на диск запускается сразу после pwrite,
+// так что диск занят всё время, пока генераторы считают следующие участки.
+
+class WriteBehindWriter {
+private:
+    struct Request {
+        std::vector<uint8_t>* buffer;
+        uint64_t offset;
+    };
+
+    RandomAccessFile& file;
+    uint64_t behind_bytes;
+
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> buffers;
+    std::vector<std::vector<uint8_t>*> free_buffers;
+    std::deque<Request> pending;
+    std::deque<std::pair<uint64_t, uint64_t>> in_writeback;
+    uint64_t in_writeback_bytes = 0;
+
+    std::mutex mutex;
+    std::condition_variable buffer_freed;
+    std::condition_variable work_ready;
+    bool closing = false;
+    bool failed = false;
+    uint64_t bytes_written = 0;
+
+    std::thread io_thread;
+
+    void io_loop() {
+        for (;;) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [this] { return closing || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                request = pending.front();
+                pending.pop_front();
+            }
+
+            uint64_t size = request.buffer->size();
+            bool ok = file.write_at(request.buffer->data(), size, request.offset);
+            if (ok) {
+                file.start_writeback(request.offset, size);
+                in_writeback.push_back({ request.offset, size });
+                in_writeback_bytes += size;
+                while (in_writeback_bytes > behind_bytes) {
+                    auto range = in_writeback.front();
+                    in_writeback.pop_front();
+                    in_writeback_bytes -= range.second;
+                    file.drop_cached(range.first, range.second);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) failed = true;
+                bytes_written += size;
+                free_buffers.push_back(request.buffer);
+            }
+            buffer_freed.notify_one();
+        }
+    }
+
+public:
+    WriteBehindWriter(RandomAccessFile& target, int buffer_count, uint64_t max_behind_bytes = 256ull << 20)
+        : file(target), behind_bytes(max_behind_bytes) {
+        for (int i = 0; i < buffer_count; i++) {
+            buffers.emplace_back(new std::vector<uint8_t>());
+            free_buffers.push_back(buffers.back().get());
+        }
+        io_thread = std::thread(&WriteBehindWriter::io_loop, this);
+    }
+
+    ~WriteBehindWriter() { finish(); }
+
+    std::vector<uint8_t>* acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        buffer_freed.wait(lock, [this] { return !free_buffers.empty(); });
+        std::vector<uint8_t>* buffer = free_buffers.back();
+        free_buffers.pop_back();
+        return buffer;
+    }
+
+    void submit(std::vector<uint8_t>* buffer, uint64_t offset) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back({ buffer, offset });
+        }
+        work_ready.notify_one();
+    }
+
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        work_ready.notify_one();
+        if (io_thread.joinable()) {
+            io_thread.join();
+            for (auto& range : in_writeback) {
+                file.drop_cached(range.first, range.second);
+            }
+            in_writeback.clear();
+        }
+        return !failed;
+    }
+
+    uint64_t written() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytes_written;
+    }
+};
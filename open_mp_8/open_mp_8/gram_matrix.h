@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "vector_file.h"
+
+// Матрица Грама G[i][j] = (v_i, v_j) для всех векторов файла.
+//
+// Блок C = A * B^T считается тайлами MC x NC, тайлы распределяются между
+// потоками. Внутри тайла строки A и B упаковываются полосами по MR и NR строк
+// в k-мажорном порядке (блоками по KC элементов, чтобы упаковка помещалась в L2),
+// и микроядро MR x NR держит весь блок C в регистрах.
+//
+// Если все векторы не помещаются в memory_budget, файл обрабатывается панелями:
+// в памяти две панели I и J, считаются блоки G[I, J] для J >= I, нижний
+// треугольник заполняется отражением.
+
+namespace gram {
+
+const int MR = 4;
+const int NR = 8;
+const int KC = 256;
+const int MC = 64;
+const int NC = 64;
+
+// dst[(s * kc + k) * R + r] = src[(s * R + r) * ld + k0 + k]; недостающие строки - нули.
+inline void pack_rows(const double* src, int64_t ld, int rows, int64_t k0, int kc, int R, double* dst) {
+    for (int s = 0; s * R < rows; s++) {
+        double* strip = dst + (int64_t)s * kc * R;
+        for (int r = 0; r < R; r++) {
+            int row = s * R + r;
+            if (row < rows) {
+                const double* line = src + row * ld + k0;
+                for (int k = 0; k < kc; k++) {
+                    strip[k * R + r] = line[k];
+                }
+            }
+            else {
+                for (int k = 0; k < kc; k++) {
+                    strip[k * R + r] = 0.0;
+                }
+            }
+        }
+    }
+}
+
+// c[i * ldc + j] += sum_k a[k * MR + i] * b[k * NR + j]
+#if defined(__AVX2__) && defined(__FMA__)
+inline void micro_kernel(int kc, const double* a, const double* b, double* c, int ldc) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+
+    for (int k = 0; k < kc; k++) {
+        __m256d b0 = _mm256_loadu_pd(b + k * NR);
+        __m256d b1 = _mm256_loadu_pd(b + k * NR + 4);
+        __m256d a0 = _mm256_broadcast_sd(a + k * MR + 0);
+        __m256d a1 = _mm256_broadcast_sd(a + k * MR + 1);
+        c00 = _mm256_fmadd_pd(a0, b0, c00);
+        c01 = _mm256_fmadd_pd(a0, b1, c01);
+        c10 = _mm256_fmadd_pd(a1, b0, c10);
+        c11 = _mm256_fmadd_pd(a1, b1, c11);
+        __m256d a2 = _mm256_broadcast_sd(a + k * MR + 2);
+        __m256d a3 = _mm256_broadcast_sd(a + k * MR + 3);
+        c20 = _mm256_fmadd_pd(a2, b0, c20);
+        c21 = _mm256_fmadd_pd(a2, b1, c21);
+        c30 = _mm256_fmadd_pd(a3, b0, c30);
+        c31 = _mm256_fmadd_pd(a3, b1, c31);
+    }
+
+    __m256d rows[MR][2] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 } };
+    for (int i = 0; i < MR; i++) {
+        double* ci = c + i * ldc;
+        _mm256_storeu_pd(ci, _mm256_add_pd(_mm256_loadu_pd(ci), rows[i][0]));
+        _mm256_storeu_pd(ci + 4, _mm256_add_pd(_mm256_loadu_pd(ci + 4), rows[i][1]));
+    }
+}
+#else
+inline void micro_kernel(int kc, const double* a, const double* b, double* c, int ldc) {
+    double acc[MR][NR] = {};
+    for (int k = 0; k < kc; k++) {
+        const double* bk = b + k * NR;
+        for (int i = 0; i < MR; i++) {
+            double ai = a[k * MR + i];
+#pragma omp simd
+            for (int j = 0; j < NR; j++) {
+                acc[i][j] += ai * bk[j];
+            }
+        }
+    }
+    for (int i = 0; i < MR; i++) {
+        for (int j = 0; j < NR; j++) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+#endif
+
+// C[i * ldc + j] = (A_i, B_j) для A (na x d) и B (nb x d) с непрерывными строками.
+// upper_only: для диагонального блока пропускаются тайлы целиком под диагональю.
+inline void gram_block(const double* A, int64_t na, const double* B, int64_t nb, int64_t d,
+    double* C, int64_t ldc, bool upper_only, int num_threads) {
+    std::vector<std::pair<int64_t, int64_t>> tiles;
+    for (int64_t i0 = 0; i0 < na; i0 += MC) {
+        for (int64_t j0 = 0; j0 < nb; j0 += NC) {
+            if (upper_only && j0 + NC <= i0) {
+                continue;
+            }
+            tiles.push_back({ i0, j0 });
+        }
+    }
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<double> a_pack((size_t)MC * KC);
+        std::vector<double> b_pack((size_t)NC * KC);
+        std::vector<double> c_tile((size_t)MC * NC);
+
+#pragma omp for schedule(dynamic, 1)
+        for (int t = 0; t < (int)tiles.size(); t++) {
+            int64_t i0 = tiles[t].first;
+            int64_t j0 = tiles[t].second;
+            int mc = (int)std::min<int64_t>(MC, na - i0);
+            int nc = (int)std::min<int64_t>(NC, nb - j0);
+            std::fill(c_tile.begin(), c_tile.end(), 0.0);
+
+            for (int64_t k0 = 0; k0 < d; k0 += KC) {
+                int kc = (int)std::min<int64_t>(KC, d - k0);
+                pack_rows(A + i0 * d, d, mc, k0, kc, MR, a_pack.data());
+                pack_rows(B + j0 * d, d, nc, k0, kc, NR, b_pack.data());
+
+                for (int jr = 0; jr < nc; jr += NR) {
+                    for (int ir = 0; ir < mc; ir += MR) {
+                        micro_kernel(kc, a_pack.data() + (int64_t)(ir / MR) * kc * MR,
+                            b_pack.data() + (int64_t)(jr / NR) * kc * NR,
+                            c_tile.data() + ir * NC + jr, NC);
+                    }
+                }
+            }
+
+            for (int i = 0; i < mc; i++) {
+                std::copy(c_tile.data() + i * NC, c_tile.data() + i * NC + nc, C + (i0 + i) * ldc + j0);
+            }
+        }
+    }
+}
+
+struct GramStats {
+    int64_t vectors = 0;
+    int64_t dimension = 0;
+    int64_t panel_vectors = 0;
+    int panels = 0;
+    int panel_loads = 0;
+    double load_time = 0.0;
+    double compute_time = 0.0;
+    bool out_of_core = false;
+};
+
+// Загрузка векторов [first, first + count) в panel (count x length) несколькими
+// читателями: индекс v2 позволяет каждому потоку читать свою часть независимо.
+inline bool load_panel(const std::string& filename, int64_t first, int64_t count, int64_t length,
+    double* panel, int num_threads) {
+    bool ok = true;
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        VectorFileReader reader;
+        bool opened = reader.open(filename);
+
+#pragma omp for schedule(static)
+        for (int64_t v = 0; v < count; v++) {
+            if (!opened || !reader.read_vector(first + v, panel + v * length, length)) {
+#pragma omp atomic write
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+// max_vectors <= 0 - все векторы файла; length - длина обрабатываемого префикса.
+inline bool compute_gram_matrix(const std::string& filename, int64_t max_vectors, int64_t length,
+    size_t memory_budget, int num_threads, std::vector<double>& G, GramStats& stats) {
+    VectorFileReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+
+    const int64_t n = max_vectors > 0 ? std::min(max_vectors, reader.num_vectors()) : reader.num_vectors();
+    const int64_t d = std::min(length, reader.vector_size());
+    const uint64_t vector_bytes = d * sizeof(double);
+
+    stats = GramStats();
+    stats.vectors = n;
+    stats.dimension = d;
+
+    if ((uint64_t)n * vector_bytes <= memory_budget) {
+        stats.panel_vectors = n;
+    }
+    else {
+        stats.panel_vectors = (int64_t)(memory_budget / (2 * vector_bytes));
+        stats.out_of_core = true;
+    }
+    if (stats.panel_vectors < 1) {
+        return false;
+    }
+    stats.panels = (int)((n + stats.panel_vectors - 1) / stats.panel_vectors);
+
+    G.assign((size_t)(n * n), 0.0);
+    std::vector<double> panel_i((size_t)(stats.panel_vectors * d));
+    std::vector<double> panel_j(stats.out_of_core ? panel_i.size() : 0);
+
+    for (int64_t i0 = 0; i0 < n; i0 += stats.panel_vectors) {
+        int64_t ni = std::min(stats.panel_vectors, n - i0);
+
+        double t = omp_get_wtime();
+        if (!load_panel(filename, i0, ni, d, panel_i.data(), num_threads)) {
+            return false;
+        }
+        stats.load_time += omp_get_wtime() - t;
+        stats.panel_loads++;
+
+        t = omp_get_wtime();
+        gram_block(panel_i.data(), ni, panel_i.data(), ni, d, G.data() + i0 * n + i0, n, true, num_threads);
+        stats.compute_time += omp_get_wtime() - t;
+
+        for (int64_t j0 = i0 + ni; j0 < n; j0 += stats.panel_vectors) {
+            int64_t nj = std::min(stats.panel_vectors, n - j0);
+
+            t = omp_get_wtime();
+            if (!load_panel(filename, j0, nj, d, panel_j.data(), num_threads)) {
+                return false;
+            }
+            stats.load_time += omp_get_wtime() - t;
+            stats.panel_loads++;
+
+            t = omp_get_wtime();
+            gram_block(panel_i.data(), ni, panel_j.data(), nj, d, G.data() + i0 * n + j0, n, false, num_threads);
+            stats.compute_time += omp_get_wtime() - t;
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+    for (int64_t i = 1; i < n; i++) {
+        for (int64_t j = 0; j < i; j++) {
+            G[i * n + j] = G[j * n + i];
+        }
+    }
+    return true;
+}
+
+}  // namespace gram
@@ -1,61 +1,102 @@
-﻿#define NOMINMAX
-
-#include <iostream>
+﻿#include <iostream>
 #include <omp.h>
 #include <vector>
 #include <fstream>
-#include <windows.h>
-#include <map>
 #include <iomanip>
 #include <string>
 #include <cmath>
 #include <queue>
 #include <utility> 
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "bench.h"
+#include "vector_file.h"
+#include "dot_cache.h"
+#include "execution.hpp"
+#include "gram_matrix.h"
+#include "sparse_vector.h"
+#include "huge_pages.hpp"
+#include "mixed_precision.hpp"
+#include "tuning.hpp"
 
 using namespace std;
+namespace pk = parallel_kernels;
+
+// Значения вектора зависят только от seed и номера вектора, поэтому любой
+// участок файла можно сгенерировать независимо от остальных и в любом потоке.
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
 
-void generate_vector_file(const string& filename, int num_pairs, int vector_size) {
-    ofstream file(filename, ios::binary);
-    if (!file.is_open()) {
-        cerr << "Ошибка создания файла " << endl;
-        return;
+void fill_random_vector(uint64_t seed, int64_t vector_index, double* vec, int64_t vector_size) {
+    uint64_t state = seed * 0xD1B54A32D192ED03ull + (uint64_t)vector_index * 0x9E3779B97F4A7C15ull;
+    for (int64_t j = 0; j < vector_size; j++) {
+        vec[j] = (splitmix64(state) % 1000) / 100.0;
     }
+}
 
-    file.write(reinterpret_cast<const char*>(&num_pairs), sizeof(int));
-    file.write(reinterpret_cast<const char*>(&vector_size), sizeof(int));
-
-    srand(static_cast<unsigned int>(time(0)));
-
-    vector<double> vec(vector_size);
-    for (int i = 0; i < num_pairs * 2; i++) { 
-        for (int j = 0; j < vector_size; j++) {
-            vec[j] = (rand() % 1000) / 100.0;
-        }
-        file.write(reinterpret_cast<const char*>(vec.data()), sizeof(double) * vector_size);
+bool generate_vector_file(const string& filename, int num_pairs, int vector_size, const VectorFileOptions& options = VectorFileOptions()) {
+    if (!options.force && vector_file_is_current(filename, num_pairs, vector_size, options)) {
+        cerr << "Файл " << filename << " уже содержит " << num_pairs << " пар размера " << vector_size
+            << " (seed " << options.seed << "), генерация пропущена\n";
+        return true;
     }
 
-    file.close();
-    cout << "Файл " << filename << "сгенерирован\n";
-}
-
-bool load_pair(ifstream& file, vector<double>& vec1, vector<double>& vec2, int vector_size) {
-    vec1.resize(vector_size);
-    vec2.resize(vector_size);
+    double start = omp_get_wtime();
+    bool ok = write_vector_file(filename, num_pairs, vector_size, options,
+        [&](int64_t pair, double* vec1, double* vec2) {
+            fill_random_vector(options.seed, 2 * pair, vec1, vector_size);
+            fill_random_vector(options.seed, 2 * pair + 1, vec2, vector_size);
+        });
+    double elapsed = omp_get_wtime() - start;
 
-    if (!file.read(reinterpret_cast<char*>(vec1.data()), sizeof(double) * vector_size)) {
+    if (!ok) {
+        cerr << "Ошибка записи файла " << filename << endl;
         return false;
     }
-    if (!file.read(reinterpret_cast<char*>(vec2.data()), sizeof(double) * vector_size)) {
-        return false;
+
+    double gigabytes = 2.0 * num_pairs * vector_size * (options.version == 1 ? sizeof(double) : dtype_size(options.dtype)) / 1e9;
+    cerr << "Файл " << filename << " сгенерирован (v" << options.version;
+    if (options.version == 2) {
+        cerr << ", " << (options.dtype == DTYPE_FLOAT32 ? "float32" : "float64")
+            << (options.compression == COMPRESSION_SHUFFLE_LZ ? ", shuffle+lz" : "");
     }
+    const ios::fmtflags flags = cerr.flags();
+    const streamsize precision = cerr.precision();
+    cerr << ") за " << fixed << setprecision(2) << elapsed << " сек, "
+        << gigabytes / elapsed << " ГБ/с\n";
+    cerr.flags(flags);
+    cerr.precision(precision);
     return true;
 }
 
-double compute_dot_product(const vector<double>& vec1, const vector<double>& vec2, int num_threads) {
+bool load_pair(VectorFileReader& file, int pair_index, pk::huge_vector<double>& vec1, pk::huge_vector<double>& vec2,
+    int vector_size) {
+    return file.read_pair(pair_index, vec1, vec2, vector_size);
+}
+
+// Короче порога (ompbench --tune, по умолчанию 1000) накладные расходы
+// параллельного региона больше выигрыша, и цикл идёт на одном потоке.
+inline bool parallel_dot_worthwhile(int64_t size, int num_threads) {
+    return num_threads > 1 && size >= pk::tuned_value("dot_product_cutoff", num_threads, 1000);
+}
+
+template <typename Alloc>
+double compute_dot_product(const vector<double, Alloc>& vec1, const vector<double, Alloc>& vec2, int num_threads) {
     double sum = 0.0;
     int size = vec1.size();
 
-    if (num_threads > 1 && size >= 1000) { 
+    if (parallel_dot_worthwhile(size, num_threads)) {
 #pragma omp parallel for reduction(+:sum) num_threads(num_threads)
         for (int i = 0; i < size; i++) {
             sum += vec1[i] * vec2[i];
@@ -70,154 +111,661 @@ double compute_dot_product(const vector<double>& vec1, const vector<double>& vec
     return sum;
 }
 
-double process_vectors_with_sections(const string& filename, int num_pairs, int vector_size, int num_threads) {
-    double total_time = 0.0;
+// То же для хранения float32/bfloat16: элементы расширяются до double,
+// накопление в double, обычное или компенсированное.
+template <typename T, typename Alloc>
+double compute_dot_product(const vector<T, Alloc>& vec1, const vector<T, Alloc>& vec2, int num_threads, bool compensated) {
+    int threads = parallel_dot_worthwhile((int64_t)vec1.size(), num_threads) ? num_threads : 1;
+    return compensated ? pk::dot_compensated(vec1.data(), vec2.data(), (int64_t)vec1.size(), threads)
+        : pk::dot_wide(vec1.data(), vec2.data(), (int64_t)vec1.size(), threads);
+}
+
+struct PairTask {
+    int index = 0;
+    bool cached = false;
+    double dot = 0.0;
+    uint64_t content_hash = 0;
+    double load_time = 0.0;
+    // Буферы пары на больших страницах (режим задаёт --huge-pages).
+    pk::huge_vector<double> vec1, vec2;
+};
+
+// Готовит пару к обработке: берёт результат из кэша или читает данные с диска.
+bool prepare_pair(VectorFileReader& file, int pair_index, int vector_size, DotProductCache* cache, PairTask& task) {
+    task.index = pair_index;
+    task.cached = false;
+
+    double start = omp_get_wtime();
+    bool has_chunk_hash = cache != nullptr && pair_chunk_hash(file, pair_index, task.content_hash);
+    if (has_chunk_hash) {
+#pragma omp critical(dot_cache)
+        task.cached = cache->lookup(pair_index, vector_size, task.content_hash, task.dot);
+        if (task.cached) {
+            return true;
+        }
+    }
+
+    if (!load_pair(file, pair_index, task.vec1, task.vec2, vector_size)) {
+        return false;
+    }
+
+    if (cache != nullptr && !has_chunk_hash) {
+        task.content_hash = pair_data_hash(task.vec1, task.vec2);
+#pragma omp critical(dot_cache)
+        task.cached = cache->lookup(pair_index, vector_size, task.content_hash, task.dot);
+    }
+    task.load_time = omp_get_wtime() - start;
+    return true;
+}
 
-    ifstream file(filename, ios::binary);
-    if (!file.is_open()) {
+double finish_pair(PairTask& task, int vector_size, int num_threads, DotProductCache* cache) {
+    if (task.cached) {
+        if (cache != nullptr) {
+#pragma omp atomic
+            cache->stats.hits++;
+        }
+        return task.dot;
+    }
+
+    double start = omp_get_wtime();
+    double dot = compute_dot_product(task.vec1, task.vec2, num_threads);
+    if (cache != nullptr) {
+        double miss_time = task.load_time + (omp_get_wtime() - start);
+#pragma omp critical(dot_cache)
+        {
+            cache->store(task.index, vector_size, task.content_hash, dot);
+            cache->stats.misses++;
+            cache->stats.miss_time += miss_time;
+        }
+    }
+    return dot;
+}
+
+// Возвращает сумму скалярных произведений всех обработанных пар.
+double process_vectors_with_sections(const string& filename, int num_pairs, int vector_size, int num_threads, DotProductCache* cache = nullptr) {
+    VectorFileReader file;
+    if (!file.open(filename)) {
         cerr << "Ошибка открытия файла: " << filename << endl;
         return 0.0;
     }
 
-    int file_pairs, file_size;
-    file.read(reinterpret_cast<char*>(&file_pairs), sizeof(int));
-    file.read(reinterpret_cast<char*>(&file_size), sizeof(int));
-
-    int pairs_to_process = min(num_pairs, file_pairs);
-    int size_to_process = min(vector_size, file_size);
+    int pairs_to_process = (int)min<int64_t>(num_pairs, file.num_pairs());
+    int size_to_process = (int)min<int64_t>(vector_size, file.vector_size());
 
     vector<double> results(pairs_to_process, 0.0);
     double total_sum = 0.0;
 
-    double start_time = omp_get_wtime();
-
     if (num_threads == 1) {
         for (int i = 0; i < pairs_to_process; i++) {
-            vector<double> vec1, vec2;
-            if (load_pair(file, vec1, vec2, size_to_process)) {
-                results[i] = compute_dot_product(vec1, vec2, num_threads);
+            PairTask task;
+            if (prepare_pair(file, i, size_to_process, cache, task)) {
+                results[i] = finish_pair(task, size_to_process, num_threads, cache);
                 total_sum += results[i];
             }
         }
     }
     else {
-        queue<pair<vector<double>, vector<double>>> q;
-        vector<bool> processed(pairs_to_process, false); 
-
-#pragma omp parallel sections num_threads(2)
-        {
-#pragma omp section
-            {
-                for (int i = 0; i < pairs_to_process; i++) {
-                    vector<double> vec1, vec2;
-                    if (load_pair(file, vec1, vec2, size_to_process)) {
+        queue<PairTask> q;
+        int pairs_loaded = pairs_to_process;
+
+        // Загрузка и вычисление - две секции исполнителя OpenMP: первая читает пары
+        // в очередь, вторая забирает их и считает на оставшихся потоках.
+        auto producer = [&] {
+            for (int i = 0; i < pairs_to_process; i++) {
+                PairTask task;
+                if (prepare_pair(file, i, size_to_process, cache, task)) {
 #pragma omp critical
-                        {
-                            q.push({ vec1, vec2 });
-                        }
-                    }
-                    else {
-                        break;
+                    {
+                        q.push(move(task));
                     }
                 }
-            }
-
-#pragma omp section
-            {
-                int idx = 0;
-                while (idx < pairs_to_process) {
-                    pair<vector<double>, vector<double>> p;
-                    bool got = false;
-
+                else {
 #pragma omp critical
                     {
-                        if (!q.empty()) {
-                            p = q.front();
-                            q.pop();
-                            got = true;
-                        }
+                        pairs_loaded = i;
                     }
+                    break;
+                }
+            }
+        };
+        auto consumer = [&] {
+            int idx = 0;
+            for (;;) {
+                PairTask task;
+                bool got = false;
+                bool done = false;
 
-                    if (got) {
-                        double dot = compute_dot_product(p.first, p.second, num_threads - 1); 
-                        results[idx] = dot;
-#pragma omp atomic
-                        total_sum += dot;
-                        idx++;
+#pragma omp critical
+                {
+                    if (!q.empty()) {
+                        task = move(q.front());
+                        q.pop();
+                        got = true;
                     }
                     else {
-                        Sleep(1); 
+                        done = idx >= pairs_loaded;
                     }
                 }
+
+                if (done) {
+                    break;
+                }
+                if (got) {
+                    double dot = finish_pair(task, size_to_process, num_threads - 1, cache);
+                    results[idx] = dot;
+#pragma omp atomic
+                    total_sum += dot;
+                    idx++;
+                }
+                else {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
             }
-        }
+        };
+        execution::openmp_backend<>(2).parallel_sections(producer, consumer);
     }
 
-    double end_time = omp_get_wtime();
-    total_time = end_time - start_time;
+    return total_sum;
+}
+
+// Обработка с кэшем результатов рядом с файлом: загрузка, обработка, сохранение.
+double process_vectors_incremental(const string& filename, int num_pairs, int vector_size, int num_threads, DotCacheStats& stats) {
+    DotProductCache cache;
+    string sidecar = DotProductCache::sidecar_path(filename);
+    cache.load(sidecar);
+
+    double total_sum = process_vectors_with_sections(filename, num_pairs, vector_size, num_threads, &cache);
 
-    file.close();
+    if (!cache.save(sidecar)) {
+        cerr << "Ошибка записи кэша " << sidecar << endl;
+    }
+    stats = cache.stats;
+    return total_sum;
+}
 
-    cout << " [Сумма всех произведений: " << fixed << setprecision(2) << total_sum << "]";
+// Наивный вариант: для каждого i векторы j >= i заново читаются из файла и
+// передаются в compute_dot_product, т.е. файл перечитывается n раз.
+bool gram_matrix_naive(const string& filename, int64_t n, int vector_size, int num_threads, vector<double>& G) {
+    VectorFileReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+    G.assign((size_t)(n * n), 0.0);
 
-    return total_time;
+    vector<double> vec_i(vector_size), vec_j(vector_size);
+    for (int64_t i = 0; i < n; i++) {
+        if (!reader.read_vector(i, vec_i.data(), vector_size)) {
+            return false;
+        }
+        for (int64_t j = i; j < n; j++) {
+            if (!reader.read_vector(j, vec_j.data(), vector_size)) {
+                return false;
+            }
+            G[i * n + j] = G[j * n + i] = compute_dot_product(vec_i, vec_j, num_threads);
+        }
+    }
+    return true;
 }
 
-int main() {
+namespace {
 
-    SetConsoleOutputCP(1251);
-    SetConsoleCP(1251);
+// Файл удаляется вместе с последней копией нагрузки.
+shared_ptr<string> temporary_file(const string& filename) {
+    return shared_ptr<string>(new string(filename), [](string* name) {
+        remove(name->c_str());
+        remove(DotProductCache::sidecar_path(*name).c_str());
+        delete name;
+    });
+}
 
-    const string filename = "vectors_data.bin"; 
+bool copy_file(const string& from, const string& to) {
+    ifstream in(from, ios::binary);
+    ofstream out(to, ios::binary | ios::trunc);
+    out << in.rdbuf();
+    return in.is_open() && (bool)out;
+}
 
-    cout << "Генерация файла с векторами" << endl;
-    generate_vector_file(filename, 1000, 1000000);  
+VectorFileOptions file_options_from(const bench::Config& config) {
+    VectorFileOptions options;
+    options.seed = config.seed;
+    options.dtype = config.param("dtype", "float64") == "float32" ? DTYPE_FLOAT32 : DTYPE_FLOAT64;
+    options.compression = config.param("compression", "none") == "lz" ? COMPRESSION_SHUFFLE_LZ : COMPRESSION_NONE;
+    return options;
+}
 
-    ofstream output("result_omp8.csv");
-    output << "Pairs,Vector_Size,Threads,Time(sec),Speedup,Efficiency\n";
+const vector<int64_t> FILE_PIPELINE_SIZES = { 5000, 10000, 100000, 500000, 1000000 };
 
-    vector<int> num_pairs_list = { 100, 500, 1000 };
-    vector<int> vector_sizes = { 5000, 10000, 100000, 500000, 1000000 };
-    vector<int> threads_list = { 1, 2, 4, 8 };
+// Конвейер чтение/вычисление на секциях; size - обрабатываемая длина векторов.
+// Файл генерируется один раз под наибольший размер прогона и переиспользуется.
+// Параметры: pairs, file, dtype (float64|float32), compression (none|lz).
+bench::Workload prepare_file_pipeline(int64_t size, const bench::Config& config) {
+    const int pairs = (int)config.param_int("pairs", 100);
+    const string filename = config.param("file", "vectors_data.bin");
+    const vector<int64_t>& sizes = config.sizes.empty() ? FILE_PIPELINE_SIZES : config.sizes;
+    const int file_size = (int)*max_element(sizes.begin(), sizes.end());
 
+    if (!generate_vector_file(filename, pairs, file_size, file_options_from(config))) {
+        throw runtime_error("ошибка записи файла " + filename);
+    }
 
-    map<pair<int, int>, double> base_times;
+    bench::Workload workload;
+    workload.run = [=](const string&, int threads) -> bench::RunResult {
+        return process_vectors_with_sections(filename, pairs, (int)size, threads);
+    };
+    workload.reference = [=](const string&) -> double {
+        return process_vectors_with_sections(filename, pairs, (int)size, 1);
+    };
+    workload.elements = [=](const string&) { return 2.0 * pairs * size; };
+    // Байты - объём прочитанных из файла значений в типе хранения.
+    const double width = (double)dtype_size(file_options_from(config).dtype);
+    workload.bytes = [=](const string&) { return 2.0 * pairs * size * width; };
+    workload.flops = [=](const string&) { return 2.0 * pairs * size; };
+    return workload;
+}
 
-    for (int num_pairs : num_pairs_list) {
-        for (int vector_size : vector_sizes) {
-            cout << "\nПары: " << num_pairs << " Размер: " << vector_size << endl;
+// Скалярное произведение пары векторов в памяти при разном хранении; вариант -
+// "<хранение>[_compensated]". Rel_Error - отклонение от произведения исходных
+// double, сверка - с последовательным произведением хранимых значений.
+bench::Workload prepare_dot_precision(int64_t size, const bench::Config& config) {
+    typedef pk::huge_page_allocator<float> f32_alloc;
+    typedef pk::huge_page_allocator<pk::bfloat16> bf16_alloc;
+    auto vec1 = make_shared<pk::huge_vector<double>>((size_t)size);
+    auto vec2 = make_shared<pk::huge_vector<double>>((size_t)size);
+    fill_random_vector(config.seed, 0, vec1->data(), size);
+    fill_random_vector(config.seed, 1, vec2->data(), size);
+    auto f32 = make_shared<pair<pk::huge_vector<float>, pk::huge_vector<float>>>(
+        pk::convert_vector<float, f32_alloc>(*vec1), pk::convert_vector<float, f32_alloc>(*vec2));
+    auto bf16 = make_shared<pair<pk::huge_vector<pk::bfloat16>, pk::huge_vector<pk::bfloat16>>>(
+        pk::convert_vector<pk::bfloat16, bf16_alloc>(*vec1), pk::convert_vector<pk::bfloat16, bf16_alloc>(*vec2));
+    const double full = compute_dot_product(*vec1, *vec2, 1, true);
+
+    auto storage = [](const string& variant) { return variant.substr(0, variant.find('_')); };
+    auto dot = [=](const string& variant, int threads, bool compensated) {
+        string type = storage(variant);
+        return type == "f64" ? compute_dot_product(*vec1, *vec2, threads, compensated)
+            : type == "f32" ? compute_dot_product(f32->first, f32->second, threads, compensated)
+            : compute_dot_product(bf16->first, bf16->second, threads, compensated);
+    };
+
+    bench::Workload workload;
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        bench::RunResult result = dot(variant, threads, variant.find("_compensated") != string::npos);
+        result.metrics.push_back({ "Rel_Error", fabs(result.value - full) / fabs(full) });
+        return result;
+    };
+    workload.reference = [=](const string& variant) { return dot(variant, 1, true); };
+    workload.bytes = [=](const string& variant) {
+        string type = storage(variant);
+        return 2.0 * size * (type == "f64" ? sizeof(double) : type == "f32" ? sizeof(float) : sizeof(pk::bfloat16));
+    };
+    workload.flops = [size](const string&) { return 2.0 * size; };
+    workload.place = [=](int threads) {
+        bench::place_vector(*vec1, threads);
+        bench::place_vector(*vec2, threads);
+        bench::place_vector(f32->first, threads);
+        bench::place_vector(f32->second, threads);
+        bench::place_vector(bf16->first, threads);
+        bench::place_vector(bf16->second, threads);
+    };
+    return workload;
+}
 
-            for (int threads : threads_list) {
-                double total_time = 0.0;
-                const int repetitions = 3;
+const bench::Registrar dot_precision_registrar({
+    "dot_precision", "Скалярное произведение при хранении float32/bfloat16 (open_mp_8)",
+    { "f64", "f32", "bf16", "f32_compensated", "bf16_compensated" },
+    { 1000000, 5000000, 20000000 },
+    prepare_dot_precision
+});
+
+const bench::Registrar file_pipeline_registrar({
+    "file_pipeline", "Скалярные произведения пар векторов из файла (open_mp_8)",
+    { "sections" },
+    FILE_PIPELINE_SIZES,
+    prepare_file_pipeline,
+    { "pairs=100 - число пар", "file=vectors_data.bin - файл данных, переиспользуется между запусками",
+      "dtype=float64|float32 - тип хранения", "compression=none|lz - сжатие чанков" }
+});
+
+// Сценарии кэша результатов: full - полный пересчёт без кэша, cold - первый
+// запуск с пустым кэшем, unchanged - повтор без изменений, append - в конец
+// дописаны пары, random_modify - случайные пары изменены. Нужное содержимое
+// файла и прогретый кэш готовятся перед каждым повтором вне замера.
+// Параметры: pairs, appended, modified.
+bench::Workload prepare_dot_cache(int64_t size, const bench::Config& config) {
+    enum FileState { NONE, BASE, APPENDED, MODIFIED };
+
+    struct State {
+        int base_pairs;
+        int total_pairs;
+        vector<bool> modified;
+        VectorFileOptions options;
+        FileState file_state = NONE;
+        shared_ptr<string> filename;
+        string sidecar;
+        bool has_snapshot[4] = {};
+
+        string snapshot_path(FileState source) const { return sidecar + "." + to_string((int)source); }
+
+        ~State() {
+            for (FileState source : { BASE, APPENDED }) {
+                remove(snapshot_path(source).c_str());
+            }
+        }
+    };
+
+    auto state = make_shared<State>();
+    state->base_pairs = (int)config.param_int("pairs", 400);
+    state->total_pairs = state->base_pairs + (int)config.param_int("appended", 100);
+    state->options = file_options_from(config);
+    state->options.force = true;
+    state->filename = temporary_file("vectors_cache_demo.bin");
+    state->sidecar = DotProductCache::sidecar_path(*state->filename);
+
+    state->modified.assign(state->total_pairs, false);
+    uint64_t rng = state->options.seed;
+    for (int64_t k = config.param_int("modified", 25); k > 0; k--) {
+        state->modified[splitmix64(rng) % state->modified.size()] = true;
+    }
 
-                for (int rep = 0; rep < repetitions; rep++) {
-                    double time_sec = process_vectors_with_sections(filename, num_pairs, vector_size, threads);
-                    total_time += time_sec;
-                }
+    const int vector_size = (int)size;
 
-                double avg_time = total_time / repetitions;
+    auto write_file = [state, vector_size](FileState target) {
+        if (state->file_state == target) {
+            return;
+        }
+        bool ok = true;
+        if (target == MODIFIED) {
+            ok = write_vector_file(*state->filename, state->total_pairs, vector_size, state->options,
+                [&](int64_t pair, double* vec1, double* vec2) {
+                    uint64_t seed = state->modified[pair] ? state->options.seed + 1 : state->options.seed;
+                    fill_random_vector(seed, 2 * pair, vec1, vector_size);
+                    fill_random_vector(seed, 2 * pair + 1, vec2, vector_size);
+                });
+        }
+        else {
+            ok = generate_vector_file(*state->filename, target == BASE ? state->base_pairs : state->total_pairs,
+                vector_size, state->options);
+        }
+        if (!ok) {
+            throw runtime_error("ошибка записи файла " + *state->filename);
+        }
+        state->file_state = target;
+    };
+
+    // Кэш, прогретый на файле в состоянии source, сохраняется в отдельный файл.
+    auto restore_warm_cache = [state, vector_size, write_file](FileState source, int pairs, int threads) {
+        string snapshot = state->snapshot_path(source);
+        if (!state->has_snapshot[source]) {
+            write_file(source);
+            remove(state->sidecar.c_str());
+            DotCacheStats stats;
+            process_vectors_incremental(*state->filename, pairs, vector_size, threads, stats);
+            copy_file(state->sidecar, snapshot);
+            state->has_snapshot[source] = true;
+        }
+        copy_file(snapshot, state->sidecar);
+    };
+
+    bench::Workload workload;
+    workload.setup = [=](const string& variant, int threads) {
+        if (variant == "full" || variant == "cold") {
+            write_file(BASE);
+            remove(state->sidecar.c_str());
+        }
+        else if (variant == "unchanged") {
+            restore_warm_cache(BASE, state->base_pairs, threads);
+            write_file(BASE);
+        }
+        else if (variant == "append") {
+            restore_warm_cache(BASE, state->base_pairs, threads);
+            write_file(APPENDED);
+        }
+        else {
+            restore_warm_cache(APPENDED, state->total_pairs, threads);
+            write_file(MODIFIED);
+        }
+    };
+    auto pairs_for = [state](const string& variant) {
+        return variant == "full" || variant == "cold" || variant == "unchanged" ? state->base_pairs : state->total_pairs;
+    };
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        int pairs = pairs_for(variant);
+        if (variant == "full") {
+            return process_vectors_with_sections(*state->filename, pairs, vector_size, threads);
+        }
 
-                if (threads == 1) {
-                    base_times[{num_pairs, vector_size}] = avg_time;
-                }
+        DotCacheStats stats;
+        bench::RunResult result = process_vectors_incremental(*state->filename, pairs, vector_size, threads, stats);
+        result.metrics.push_back({ "Hits", (double)stats.hits });
+        result.metrics.push_back({ "Misses", (double)stats.misses });
+        result.metrics.push_back({ "Hit_Rate(%)", stats.hit_rate() * 100.0 });
+        result.metrics.push_back({ "Estimated_Saved(ms)", stats.saved_time() * 1000.0 });
+        return result;
+    };
+    // Полный последовательный пересчёт без кэша по текущему содержимому файла.
+    workload.reference = [=](const string& variant) -> double {
+        return process_vectors_with_sections(*state->filename, pairs_for(variant), vector_size, 1);
+    };
+    workload.elements = [=](const string& variant) { return 2.0 * pairs_for(variant) * vector_size; };
+    return workload;
+}
 
-                double speedup = (threads == 1) ? 1.0 : (base_times[{num_pairs, vector_size}] / avg_time);
-                double efficiency = speedup / threads;
+const bench::Registrar dot_cache_registrar({
+    "dot_cache", "Инкрементальная обработка с кэшем скалярных произведений (open_mp_8)",
+    { "full", "cold", "unchanged", "append", "random_modify" },
+    { 100000 },
+    prepare_dot_cache,
+    { "pairs=400 - пар в исходном файле", "appended=100 - дописываемых пар", "modified=25 - изменяемых пар",
+      "dtype=float64|float32 - тип хранения", "compression=none|lz - сжатие чанков" }
+});
+
+// Матрица Грама: naive - попарно через compute_dot_product с перечитыванием
+// файла, tiled - блочное ядро со всеми векторами в памяти, tiled_out_of_core -
+// панелями при бюджете памяти budget_fraction от объёма векторов.
+// size - длина векторов. Параметры: vectors, budget_fraction.
+bench::Workload prepare_gram(int64_t size, const bench::Config& config) {
+    const int64_t n = max<int64_t>(2, config.param_int("vectors", 256));
+    const int vector_size = (int)size;
+    const size_t full_budget = (size_t)n * vector_size * sizeof(double);
+    const size_t small_budget = (size_t)(full_budget * config.param_double("budget_fraction", 0.25));
+    const double flops = (double)n * (n + 1) * vector_size;
+
+    shared_ptr<string> filename = temporary_file("vectors_gram_demo.bin");
+    VectorFileOptions options = file_options_from(config);
+    options.force = true;
+    if (!generate_vector_file(*filename, (int)((n + 1) / 2), vector_size, options)) {
+        throw runtime_error("ошибка записи файла " + *filename);
+    }
 
-                output << num_pairs << "," << vector_size << "," << threads << ","
-                    << fixed << setprecision(4) << avg_time << ","
-                    << speedup << "," << efficiency << "\n";
+    // Эталон - наивная матрица на одном потоке.
+    auto reference = make_shared<vector<double>>();
 
-                cout << "   Потоков: " << setw(2) << threads
-                    << "    Время: " << setw(8) << avg_time << " сек"
-                    << "    Ускорение: " << setw(5) << fixed << setprecision(2) << speedup << "x"
-                    << "    Эффективность: " << setw(5) << fixed << setprecision(2) << efficiency << endl;
+    bench::Workload workload;
+    workload.setup = [=](const string&, int) {
+        if (reference->empty()) {
+            gram_matrix_naive(*filename, n, vector_size, 1, *reference);
+        }
+    };
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        vector<double> G;
+        bench::RunResult result;
+        if (variant == "naive") {
+            gram_matrix_naive(*filename, n, vector_size, threads, G);
+        }
+        else {
+            gram::GramStats stats;
+            size_t budget = variant == "tiled" ? full_budget : small_budget;
+            if (!gram::compute_gram_matrix(*filename, n, vector_size, budget, threads, G, stats)) {
+                throw runtime_error("ошибка вычисления матрицы Грама");
             }
+            result.metrics.push_back({ "Panels", (double)stats.panels });
         }
+        double max_error = 0.0;
+        for (size_t k = 0; k < G.size(); k++) {
+            result.value += G[k];
+            max_error = max(max_error, fabs(G[k] - (*reference)[k]) / max(1.0, fabs((*reference)[k])));
+        }
+        result.metrics.push_back({ "Max_Error", max_error });
+        return result;
+    };
+    workload.reference = [reference](const string&) -> double {
+        double sum = 0.0;
+        for (double value : *reference) {
+            sum += value;
+        }
+        return sum;
+    };
+    workload.elements = [=](const string&) { return (double)n * vector_size; };
+    // naive перечитывает оба вектора для каждой пары, блочные варианты - не
+    // меньше одного прохода по файлу (для панелей это нижняя оценка).
+    const double width = (double)dtype_size(options.dtype);
+    workload.bytes = [=](const string& variant) {
+        double pairs = (double)n * (n + 1) / 2.0;
+        return (variant == "naive" ? 2.0 * pairs : (double)n) * vector_size * width;
+    };
+    workload.flops = [=](const string&) { return flops; };
+    return workload;
+}
+
+const bench::Registrar gram_registrar({
+    "gram", "Матрица Грама векторов файла (open_mp_8)",
+    { "naive", "tiled", "tiled_out_of_core" },
+    { 20000 },
+    prepare_gram,
+    { "vectors=256 - число векторов", "budget_fraction=0.25 - бюджет памяти tiled_out_of_core от объёма векторов" }
+});
+
+// Разреженные векторы плотности density: элемент ненулевой с вероятностью
+// density, значения ненулевых - от 0.01 до 10.
+void fill_sparse_vector(uint64_t seed, int64_t vector_index, double density, double* vec, int64_t vector_size) {
+    uint64_t state = seed * 0xD1B54A32D192ED03ull + (uint64_t)vector_index * 0x9E3779B97F4A7C15ull;
+    const uint64_t threshold = density >= 1.0 ? UINT64_MAX : (uint64_t)(density * 18446744073709551616.0);
+    for (int64_t j = 0; j < vector_size; j++) {
+        uint64_t bits = splitmix64(state);
+        vec[j] = bits < threshold ? (bits % 1000 + 1) / 100.0 : 0.0;
     }
+}
 
-    output.close();
+struct SparseDotData {
+    vector<double> a, b;            // плотные копии для dense и эталона
+    SparseVector sparse_a, sparse_b, sparse_c;
+};
+
+// Скалярное произведение разреженных векторов против плотного ядра.
+// Вариант - "<плотность>/<метод>", плотность в процентах:
+//   dense         - compute_dot_product по плотным a и b;
+//   sparse_dense  - разреженный a на плотный b;
+//   sparse_sparse - пересечение a и b (одинаковая плотность) по пути слияния;
+//   skewed_merge, skewed_gallop - a на c плотности density / skew, слиянием и галопом.
+// Векторы каждой плотности строятся один раз при первом обращении, вне замера.
+bench::Workload prepare_sparse_dot(int64_t size, const bench::Config& config) {
+    if (size >= numeric_limits<int32_t>::max()) {
+        throw runtime_error("длина разреженного вектора больше 2^31 - 1");
+    }
+    const double skew = config.param_double("skew", 64);
+    if (skew < 1) {
+        throw runtime_error("skew должен быть не меньше 1");
+    }
+    auto data = make_shared<map<string, SparseDotData>>();
+
+    auto split_variant = [](const string& variant) {
+        size_t slash = variant.find('/');
+        return make_pair(variant.substr(0, slash), variant.substr(slash + 1));
+    };
+    auto data_for = [=](const string& variant) -> const SparseDotData& {
+        return data->at(split_variant(variant).first);
+    };
+
+    bench::Workload workload;
+    workload.setup = [=](const string& variant, int threads) {
+        string density_name = split_variant(variant).first;
+        if (data->count(density_name) == 0) {
+            const double density = atof(density_name.c_str()) / 100.0;
+            SparseDotData& d = (*data)[density_name];
+            vector<double> c((size_t)size);
+            d.a.resize((size_t)size);
+            d.b.resize((size_t)size);
+            fill_sparse_vector(config.seed, 0, density, d.a.data(), size);
+            fill_sparse_vector(config.seed, 1, density, d.b.data(), size);
+            fill_sparse_vector(config.seed, 2, density / skew, c.data(), size);
+            d.sparse_a = make_sparse(d.a.data(), size, threads);
+            d.sparse_b = make_sparse(d.b.data(), size, threads);
+            d.sparse_c = make_sparse(c.data(), size, threads);
+        }
+    };
+    workload.run = [=](const string& variant, int threads) -> bench::RunResult {
+        const SparseDotData& d = data_for(variant);
+        const string method = split_variant(variant).second;
+        bench::RunResult result;
+        if (method == "dense") {
+            result.value = compute_dot_product(d.a, d.b, threads);
+        }
+        else if (method == "sparse_dense") {
+            result.value = sparse_dense_dot(d.sparse_a, d.b.data(), threads);
+        }
+        else if (method == "sparse_sparse") {
+            result.value = sparse_sparse_dot(d.sparse_a, d.sparse_b, threads);
+        }
+        else {
+            IntersectMode mode = method == "skewed_merge" ? IntersectMode::merge : IntersectMode::gallop;
+            result.value = sparse_sparse_dot(d.sparse_a, d.sparse_c, threads, mode);
+        }
+        const bool skewed = method.compare(0, 6, "skewed") == 0;
+        result.metrics.push_back({ "NNZ_A", (double)d.sparse_a.nnz() });
+        result.metrics.push_back({ "NNZ_B", (double)(skewed ? d.sparse_c : d.sparse_b).nnz() });
+        return result;
+    };
+    // Эталон - последовательно: плотный цикл по a и b, для skewed - сбор a по индексам c.
+    workload.reference = [=](const string& variant) -> double {
+        const SparseDotData& d = data_for(variant);
+        double sum = 0.0;
+        if (split_variant(variant).second.compare(0, 6, "skewed") == 0) {
+            for (int64_t k = 0; k < d.sparse_c.nnz(); k++) {
+                sum += d.sparse_c.value[k] * d.a[d.sparse_c.index[k]];
+            }
+        }
+        else {
+            for (int64_t i = 0; i < size; i++) {
+                sum += d.a[i] * d.b[i];
+            }
+        }
+        return sum;
+    };
+    workload.elements = [size](const string&) { return (double)size; };
+    // Байты: плотные значения, пары (индекс, значение) и для sparse_dense - по
+    // значению b на ненулевой элемент a (нижняя оценка: на деле кэш-линия).
+    // Галоп читает c целиком и примерно по кэш-линии a на элемент c.
+    workload.bytes = [=](const string& variant) {
+        const SparseDotData& d = data_for(variant);
+        const string method = split_variant(variant).second;
+        const double pair_bytes = sizeof(int32_t) + sizeof(double);
+        const double na = (double)d.sparse_a.nnz();
+        const double nc = (double)d.sparse_c.nnz();
+        return method == "dense" ? 2.0 * sizeof(double) * size
+            : method == "sparse_dense" ? na * (pair_bytes + sizeof(double))
+            : method == "sparse_sparse" ? (na + (double)d.sparse_b.nnz()) * pair_bytes
+            : method == "skewed_merge" ? (na + nc) * pair_bytes
+            : nc * (pair_bytes + 64.0);
+    };
+    return workload;
+}
 
-    return 0;
+vector<string> sparse_dot_variants() {
+    vector<string> variants;
+    for (const char* density : { "0.1%", "1%", "10%" }) {
+        for (const char* method : { "dense", "sparse_dense", "sparse_sparse", "skewed_merge", "skewed_gallop" }) {
+            variants.push_back(string(density) + "/" + method);
+        }
+    }
+    return variants;
 }
+
+const bench::Registrar sparse_dot_registrar({
+    "sparse_dot", "Скалярное произведение разреженных векторов (open_mp_8)",
+    sparse_dot_variants(),
+    { 1000000, 4000000 },
+    prepare_sparse_dot,
+    { "skew=64 - во сколько раз c реже a в вариантах skewed" }
+});
+
+}  // namespace
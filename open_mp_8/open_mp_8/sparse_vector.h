@@ -0,0 +1,205 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <omp.h>
+
+// Разреженные векторы: пары (индекс, значение) по возрастанию индексов, и
+// скалярные произведения без чтения нулей.
+//
+// sparse_dense_dot - сбор значений плотного вектора по индексам разреженного,
+// параллельно по ненулевым элементам.
+//
+// sparse_sparse_dot - пересечение списков индексов. Путь слияния двух списков
+// (длина na + nb) делится между потоками на равные отрезки; граница отрезка
+// находится двоичным поиском по диагонали и сдвигается на начало своего
+// индекса в обоих списках, чтобы совпадающая пара не разошлась по соседним
+// отрезкам. Так каждый поток получает поровну элементов независимо от того,
+// как распределены индексы. Внутри отрезка - слияние без условных переходов,
+// а если один список длиннее другого в GALLOP_RATIO раз и больше - галоп:
+// для каждого индекса короткого списка позиция в длинном ищется
+// экспоненциальными шагами и двоичным поиском до блока из GALLOP_BLOCK
+// элементов, а в блоке число меньших индексов считается векторным циклом.
+//
+// Индексы - int32_t: длина вектора до 2^31 - 1.
+
+const int64_t GALLOP_RATIO = 32;
+const int64_t GALLOP_BLOCK = 16;
+
+struct SparseVector {
+    int64_t size = 0;               // длина соответствующего плотного вектора
+    std::vector<int32_t> index;
+    std::vector<double> value;
+
+    int64_t nnz() const { return (int64_t)index.size(); }
+};
+
+enum class IntersectMode { automatic, merge, gallop };
+
+// Ненулевые элементы dense[0, n): подсчёт по статическим блокам потоков,
+// смещения блоков и заполнение тем же разбиением.
+inline SparseVector make_sparse(const double* dense, int64_t n, int threads) {
+    SparseVector result;
+    result.size = n;
+    std::vector<int64_t> offsets((size_t)threads + 1, 0);
+#pragma omp parallel num_threads(threads)
+    {
+        const int team = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        const int64_t begin = n * t / team;
+        const int64_t end = n * (t + 1) / team;
+        int64_t count = 0;
+        for (int64_t i = begin; i < end; i++) {
+            count += dense[i] != 0.0;
+        }
+        offsets[t + 1] = count;
+#pragma omp barrier
+#pragma omp single
+        {
+            for (int k = 0; k < team; k++) {
+                offsets[k + 1] += offsets[k];
+            }
+            result.index.resize((size_t)offsets[team]);
+            result.value.resize((size_t)offsets[team]);
+        }
+        int64_t out = offsets[t];
+        for (int64_t i = begin; i < end; i++) {
+            if (dense[i] != 0.0) {
+                result.index[out] = (int32_t)i;
+                result.value[out] = dense[i];
+                out++;
+            }
+        }
+    }
+    return result;
+}
+
+inline double sparse_dense_dot(const SparseVector& a, const double* dense, int threads) {
+    const int32_t* index = a.index.data();
+    const double* value = a.value.data();
+    const int64_t nnz = a.nnz();
+    double sum = 0.0;
+#pragma omp parallel for simd schedule(static) reduction(+:sum) num_threads(threads)
+    for (int64_t k = 0; k < nnz; k++) {
+        sum += value[k] * dense[index[k]];
+    }
+    return sum;
+}
+
+// Позиции (ia, ib) в списках, с которых начинается отрезок пути слияния
+// diagonal: ia + ib = diagonal до сдвига на начало индекса.
+inline void merge_path_split(const int32_t* a, int64_t na, const int32_t* b, int64_t nb, int64_t diagonal,
+    int64_t& ia, int64_t& ib) {
+    int64_t lo = std::max<int64_t>(0, diagonal - nb);
+    int64_t hi = std::min(diagonal, na);
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < b[diagonal - mid - 1]) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    ia = lo;
+    ib = diagonal - lo;
+    // Всё до границы не больше key, поэтому сдвиг - не больше чем на элемент.
+    const int32_t key = std::min(ia < na ? a[ia] : std::numeric_limits<int32_t>::max(),
+        ib < nb ? b[ib] : std::numeric_limits<int32_t>::max());
+    if (ia > 0 && a[ia - 1] == key) {
+        ia--;
+    }
+    if (ib > 0 && b[ib - 1] == key) {
+        ib--;
+    }
+}
+
+// Слияние a[ia, ea) и b[ib, eb): продвигаются оба указателя с индексом не
+// больше другого, совпадение добавляет произведение.
+inline double intersect_merge(const SparseVector& a, int64_t ia, int64_t ea, const SparseVector& b, int64_t ib,
+    int64_t eb) {
+    const int32_t* ai = a.index.data();
+    const int32_t* bi = b.index.data();
+    const double* av = a.value.data();
+    const double* bv = b.value.data();
+    double sum = 0.0;
+    while (ia < ea && ib < eb) {
+        const int32_t x = ai[ia];
+        const int32_t y = bi[ib];
+        sum += x == y ? av[ia] * bv[ib] : 0.0;
+        ia += x <= y;
+        ib += y <= x;
+    }
+    return sum;
+}
+
+// Галоп коротким списком s[is, es) по длинному l[il, el).
+inline double intersect_gallop(const SparseVector& s, int64_t is, int64_t es, const SparseVector& l, int64_t il,
+    int64_t el) {
+    const int32_t* li = l.index.data();
+    double sum = 0.0;
+    int64_t pos = il;
+    for (int64_t k = is; k < es && pos < el; k++) {
+        const int32_t x = s.index[k];
+        // Инвариант: li[< pos] < x; после шагов li[hi - 1] >= x или hi = el.
+        int64_t step = GALLOP_BLOCK;
+        while (pos + step <= el && li[pos + step - 1] < x) {
+            pos += step;
+            step *= 2;
+        }
+        int64_t hi = std::min(pos + step, el);
+        while (hi - pos > GALLOP_BLOCK) {
+            int64_t mid = pos + (hi - pos) / 2;
+            if (li[mid] < x) {
+                pos = mid + 1;
+            }
+            else {
+                hi = mid + 1;
+            }
+        }
+        int64_t less = 0;
+#pragma omp simd reduction(+:less)
+        for (int64_t p = pos; p < hi; p++) {
+            less += li[p] < x;
+        }
+        pos += less;
+        if (pos < el && li[pos] == x) {
+            sum += s.value[k] * l.value[pos];
+        }
+    }
+    return sum;
+}
+
+inline double intersect_range(const SparseVector& a, int64_t ia, int64_t ea, const SparseVector& b, int64_t ib,
+    int64_t eb, IntersectMode mode) {
+    const int64_t la = ea - ia;
+    const int64_t lb = eb - ib;
+    if (mode == IntersectMode::automatic) {
+        const int64_t shorter = std::max<int64_t>(1, std::min(la, lb));
+        mode = std::max(la, lb) >= GALLOP_RATIO * shorter ? IntersectMode::gallop : IntersectMode::merge;
+    }
+    if (mode == IntersectMode::merge) {
+        return intersect_merge(a, ia, ea, b, ib, eb);
+    }
+    return la <= lb ? intersect_gallop(a, ia, ea, b, ib, eb) : intersect_gallop(b, ib, eb, a, ia, ea);
+}
+
+inline double sparse_sparse_dot(const SparseVector& a, const SparseVector& b, int threads,
+    IntersectMode mode = IntersectMode::automatic) {
+    const int64_t na = a.nnz();
+    const int64_t nb = b.nnz();
+    const int64_t total = na + nb;
+    double sum = 0.0;
+#pragma omp parallel num_threads(threads) reduction(+:sum)
+    {
+        const int team = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        int64_t ia, ib, ea, eb;
+        merge_path_split(a.index.data(), na, b.index.data(), nb, total * t / team, ia, ib);
+        merge_path_split(a.index.data(), na, b.index.data(), nb, total * (t + 1) / team, ea, eb);
+        sum += intersect_range(a, ia, ea, b, ib, eb, mode);
+    }
+    return sum;
+}
@@ -0,0 +1,667 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "file_io.h"
+
+// Формат файла векторов.
+//
+// v1 (исходный): int num_pairs, int vector_size, затем 2 * num_pairs векторов double.
+//
+// v2: [VectorFileHeader][ChunkIndexEntry x num_chunks][чанки]
+//   Чанк содержит pairs_per_chunk пар подряд (vec1, vec2, vec1, vec2, ...) в типе dtype.
+//   Сжатый чанк - это побайтовая перестановка (shuffle) элементов и LZ4-подобный блок.
+//   Для каждого чанка в индексе хранится смещение, размер и CRC32C хранимых байт,
+//   поэтому пару k можно прочитать без чтения предыдущих и несколькими читателями сразу.
+
+enum VectorDType : uint32_t {
+    DTYPE_FLOAT64 = 0,
+    DTYPE_FLOAT32 = 1
+};
+
+enum VectorCompression : uint32_t {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_SHUFFLE_LZ = 1
+};
+
+static const char VECTOR_FILE_MAGIC[8] = { 'O', 'M', 'P', 'V', 'E', 'C', '\r', '\n' };
+static const uint32_t VECTOR_FILE_VERSION = 2;
+static const uint32_t VECTOR_FILE_COMPLETE = 1;
+
+#pragma pack(push, 1)
+struct VectorFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t dtype;
+    uint32_t compression;
+    int64_t num_pairs;
+    int64_t vector_size;
+    int64_t pairs_per_chunk;
+    int64_t num_chunks;
+    uint64_t index_offset;
+    uint64_t data_offset;
+    uint64_t seed;
+    uint64_t reserved[3];
+    uint32_t index_crc;
+    uint32_t flags;
+    uint32_t header_crc;
+};
+
+struct ChunkIndexEntry {
+    uint64_t offset;
+    uint64_t stored_size;
+    uint32_t crc;
+    uint32_t compression;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(VectorFileHeader) == 116, "VectorFileHeader layout");
+static_assert(sizeof(ChunkIndexEntry) == 24, "ChunkIndexEntry layout");
+
+struct VectorFileOptions {
+    int version = 2;
+    VectorDType dtype = DTYPE_FLOAT64;
+    VectorCompression compression = COMPRESSION_NONE;
+    int64_t pairs_per_chunk = 0;  // 0 - подобрать так, чтобы чанк был около 4 МБ
+    uint64_t seed = 1;
+    int threads = 0;              // 0 - omp_get_max_threads()
+    bool force = false;           // перезаписать, даже если файл уже совпадает по форме и seed
+};
+
+inline size_t dtype_size(uint32_t dtype) {
+    return dtype == DTYPE_FLOAT32 ? sizeof(float) : sizeof(double);
+}
+
+inline int64_t default_pairs_per_chunk(int64_t vector_size, uint32_t dtype) {
+    const int64_t target_bytes = 4 << 20;
+    int64_t pair_bytes = 2 * vector_size * (int64_t)dtype_size(dtype);
+    return std::max<int64_t>(1, target_bytes / std::max<int64_t>(1, pair_bytes));
+}
+
+// ---------------------------------------------------------------------------
+// CRC32C (Castagnoli), табличный slice-by-8.
+
+inline const uint32_t* crc32c_tables() {
+    static uint32_t tables[8][256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            }
+            tables[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int t = 1; t < 8; t++) {
+                tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return &tables[0][0];
+}
+
+inline uint32_t crc32c_update(uint32_t crc, const void* data, size_t size) {
+    const uint32_t* t = crc32c_tables();
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+
+    while (size >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7 * 256 + (lo & 0xFF)] ^ t[6 * 256 + ((lo >> 8) & 0xFF)]
+            ^ t[5 * 256 + ((lo >> 16) & 0xFF)] ^ t[4 * 256 + (lo >> 24)]
+            ^ t[3 * 256 + (hi & 0xFF)] ^ t[2 * 256 + ((hi >> 8) & 0xFF)]
+            ^ t[1 * 256 + ((hi >> 16) & 0xFF)] ^ t[0 * 256 + (hi >> 24)];
+        p += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = (crc >> 8) ^ t[(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+inline uint32_t crc32c(const void* data, size_t size) {
+    return crc32c_update(0, data, size);
+}
+
+inline uint32_t header_checksum(const VectorFileHeader& header) {
+    return crc32c(&header, offsetof(VectorFileHeader, header_crc));
+}
+
+// ---------------------------------------------------------------------------
+// Побайтовая перестановка: байт b элемента i уходит в позицию b * count + i.
+// Старшие байты double (знак, порядок) оказываются рядом и хорошо сжимаются.
+
+inline void byte_shuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t width) {
+    for (size_t i = 0; i < count; i++) {
+        for (size_t b = 0; b < width; b++) {
+            dst[b * count + i] = src[i * width + b];
+        }
+    }
+}
+
+inline void byte_unshuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t width) {
+    for (size_t b = 0; b < width; b++) {
+        const uint8_t* plane = src + b * count;
+        for (size_t i = 0; i < count; i++) {
+            dst[i * width + b] = plane[i];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Блочный LZ в формате последовательностей LZ4:
+// токен (4 бита длины литералов, 4 бита длины совпадения - 4), литералы,
+// 16-битное смещение, продолжения длин байтами 255.
+
+namespace lz {
+
+const int MIN_MATCH = 4;
+const int HASH_LOG = 16;
+const size_t LAST_LITERALS = 5;
+const size_t MF_LIMIT = 12;
+const size_t MAX_OFFSET = 65535;
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+inline void write_length(std::vector<uint8_t>& dst, size_t len) {
+    while (len >= 255) {
+        dst.push_back(255);
+        len -= 255;
+    }
+    dst.push_back((uint8_t)len);
+}
+
+inline void emit_sequence(std::vector<uint8_t>& dst, const uint8_t* literals, size_t literal_len,
+    size_t offset, size_t match_len) {
+    size_t token_pos = dst.size();
+    dst.push_back(0);
+
+    uint8_t token = 0;
+    if (literal_len >= 15) {
+        token = 15 << 4;
+        write_length(dst, literal_len - 15);
+    }
+    else {
+        token = (uint8_t)(literal_len << 4);
+    }
+    dst.insert(dst.end(), literals, literals + literal_len);
+
+    if (match_len > 0) {
+        dst.push_back((uint8_t)(offset & 0xFF));
+        dst.push_back((uint8_t)(offset >> 8));
+        size_t ml = match_len - MIN_MATCH;
+        if (ml >= 15) {
+            token |= 15;
+            write_length(dst, ml - 15);
+        }
+        else {
+            token |= (uint8_t)ml;
+        }
+    }
+    dst[token_pos] = token;
+}
+
+inline void compress(const uint8_t* src, size_t size, std::vector<uint8_t>& dst) {
+    dst.clear();
+    dst.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+    if (size >= MF_LIMIT + 1) {
+        std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0xFFFFFFFFu);
+        const size_t match_limit = size - MF_LIMIT;
+        size_t pos = 0;
+
+        while (pos < match_limit) {
+            uint32_t seq = read32(src + pos);
+            uint32_t h = hash4(seq);
+            size_t candidate = table[h];
+            table[h] = (uint32_t)pos;
+
+            if (candidate == 0xFFFFFFFFu || pos - candidate > MAX_OFFSET || read32(src + candidate) != seq) {
+                pos++;
+                continue;
+            }
+
+            size_t match_len = MIN_MATCH;
+            const size_t max_len = size - LAST_LITERALS - pos;
+            while (match_len < max_len && src[candidate + match_len] == src[pos + match_len]) {
+                match_len++;
+            }
+
+            emit_sequence(dst, src + anchor, pos - anchor, pos - candidate, match_len);
+            pos += match_len;
+            anchor = pos;
+        }
+    }
+    emit_sequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+inline bool read_length(const uint8_t*& p, const uint8_t* end, size_t& len) {
+    uint8_t b;
+    do {
+        if (p >= end) return false;
+        b = *p++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+inline bool decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size) {
+    const uint8_t* p = src;
+    const uint8_t* end = src + size;
+    size_t out = 0;
+
+    while (p < end) {
+        uint8_t token = *p++;
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && !read_length(p, end, literal_len)) return false;
+        if (literal_len > (size_t)(end - p) || literal_len > raw_size - out) return false;
+        memcpy(dst + out, p, literal_len);
+        p += literal_len;
+        out += literal_len;
+
+        if (p == end) break;
+
+        if (end - p < 2) return false;
+        size_t offset = p[0] | (size_t(p[1]) << 8);
+        p += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(p, end, match_len)) return false;
+        match_len += MIN_MATCH;
+
+        if (offset == 0 || offset > out || match_len > raw_size - out) return false;
+        const uint8_t* match = dst + out - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            dst[out + i] = match[i];
+        }
+        out += match_len;
+    }
+    return out == raw_size;
+}
+
+}  // namespace lz
+
+// ---------------------------------------------------------------------------
+// Кодирование чанка: double -> dtype -> (shuffle + LZ).
+// Возвращает фактически применённое сжатие: несжимаемые чанки хранятся как есть.
+
+inline VectorCompression encode_chunk(const double* values, size_t count, uint32_t dtype,
+    uint32_t compression, std::vector<uint8_t>& raw, std::vector<uint8_t>& out) {
+    size_t width = dtype_size(dtype);
+    raw.resize(count * width);
+
+    if (dtype == DTYPE_FLOAT32) {
+        float* f = reinterpret_cast<float*>(raw.data());
+        for (size_t i = 0; i < count; i++) {
+            f[i] = (float)values[i];
+        }
+    }
+    else {
+        memcpy(raw.data(), values, count * width);
+    }
+
+    if (compression == COMPRESSION_SHUFFLE_LZ) {
+        std::vector<uint8_t> shuffled(raw.size());
+        byte_shuffle(raw.data(), shuffled.data(), count, width);
+        lz::compress(shuffled.data(), shuffled.size(), out);
+        if (out.size() < raw.size()) {
+            return COMPRESSION_SHUFFLE_LZ;
+        }
+    }
+    out.swap(raw);
+    return COMPRESSION_NONE;
+}
+
+inline bool decode_chunk(const uint8_t* stored, size_t stored_size, uint32_t compression,
+    uint32_t dtype, size_t count, std::vector<double>& values) {
+    size_t width = dtype_size(dtype);
+    std::vector<uint8_t> raw;
+    const uint8_t* payload = stored;
+
+    if (compression == COMPRESSION_SHUFFLE_LZ) {
+        std::vector<uint8_t> shuffled(count * width);
+        if (!lz::decompress(stored, stored_size, shuffled.data(), shuffled.size())) {
+            return false;
+        }
+        raw.resize(count * width);
+        byte_unshuffle(shuffled.data(), raw.data(), count, width);
+        payload = raw.data();
+    }
+    else if (stored_size != count * width) {
+        return false;
+    }
+
+    values.resize(count);
+    if (dtype == DTYPE_FLOAT32) {
+        const float* f = reinterpret_cast<const float*>(payload);
+        for (size_t i = 0; i < count; i++) {
+            values[i] = f[i];
+        }
+    }
+    else {
+        memcpy(values.data(), payload, count * sizeof(double));
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Чтение v1 и v2 с произвольным доступом к паре. Каждый читатель держит свой
+// поток, поэтому для параллельного чтения достаточно открыть несколько читателей.
+
+class VectorFileReader {
+private:
+    std::ifstream file;
+    int file_version = 0;
+    uint64_t file_bytes = 0;
+    VectorFileHeader header{};
+    std::vector<ChunkIndexEntry> index;
+
+    int64_t cached_chunk = -1;
+    std::vector<double> chunk_values;
+    std::vector<uint8_t> stored_buffer;
+    // Чанки, CRC32C которых уже сверен этим читателем.
+    std::vector<bool> verified_chunks;
+
+    bool load_chunk(int64_t chunk) {
+        if (chunk == cached_chunk) {
+            return true;
+        }
+        const ChunkIndexEntry& entry = index[chunk];
+        stored_buffer.resize(entry.stored_size);
+        file.seekg((std::streamoff)entry.offset);
+        if (!file.read(reinterpret_cast<char*>(stored_buffer.data()), entry.stored_size)) {
+            return false;
+        }
+        if (crc32c(stored_buffer.data(), stored_buffer.size()) != entry.crc) {
+            std::cerr << "Ошибка CRC32C в чанке " << chunk << std::endl;
+            return false;
+        }
+
+        int64_t pairs = std::min(header.pairs_per_chunk, header.num_pairs - chunk * header.pairs_per_chunk);
+        size_t count = (size_t)(pairs * 2 * header.vector_size);
+        if (!decode_chunk(stored_buffer.data(), stored_buffer.size(), entry.compression, header.dtype, count, chunk_values)) {
+            std::cerr << "Повреждённый чанк " << chunk << std::endl;
+            return false;
+        }
+        verified_chunks[chunk] = true;
+        cached_chunk = chunk;
+        return true;
+    }
+
+    bool read_at(uint64_t offset, void* dst, size_t bytes) {
+        file.seekg((std::streamoff)offset);
+        return (bool)file.read(reinterpret_cast<char*>(dst), bytes);
+    }
+
+public:
+    bool open(const std::string& filename) {
+        file.open(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.seekg(0, std::ios::end);
+        file_bytes = (uint64_t)file.tellg();
+        file.seekg(0);
+
+        char magic[8] = {};
+        if (!file.read(magic, sizeof(magic))) {
+            return false;
+        }
+
+        if (memcmp(magic, VECTOR_FILE_MAGIC, sizeof(magic)) != 0) {
+            int v1_header[2];
+            memcpy(v1_header, magic, sizeof(v1_header));
+            if (v1_header[0] < 0 || v1_header[1] <= 0) {
+                return false;
+            }
+            file_version = 1;
+            header = VectorFileHeader{};
+            header.num_pairs = v1_header[0];
+            header.vector_size = v1_header[1];
+            header.dtype = DTYPE_FLOAT64;
+            header.data_offset = sizeof(v1_header);
+            return true;
+        }
+
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            return false;
+        }
+        if (header.version != VECTOR_FILE_VERSION || header.header_crc != header_checksum(header)) {
+            std::cerr << "Неподдерживаемый или повреждённый заголовок файла " << filename << std::endl;
+            return false;
+        }
+        if (!(header.flags & VECTOR_FILE_COMPLETE)) {
+            std::cerr << "Файл " << filename << " записан не полностью" << std::endl;
+            return false;
+        }
+
+        index.resize(header.num_chunks);
+        if (!read_at(header.index_offset, index.data(), index.size() * sizeof(ChunkIndexEntry))) {
+            return false;
+        }
+        if (crc32c(index.data(), index.size() * sizeof(ChunkIndexEntry)) != header.index_crc) {
+            std::cerr << "Ошибка CRC32C индекса файла " << filename << std::endl;
+            return false;
+        }
+        verified_chunks.assign((size_t)header.num_chunks, false);
+        file_version = 2;
+        return true;
+    }
+
+    int version() const { return file_version; }
+    int64_t num_pairs() const { return header.num_pairs; }
+    int64_t vector_size() const { return header.vector_size; }
+    uint64_t file_size() const { return file_bytes; }
+    const VectorFileHeader& file_header() const { return header; }
+    const std::vector<ChunkIndexEntry>& chunk_index() const { return index; }
+
+    int64_t num_vectors() const { return 2 * header.num_pairs; }
+
+    // Читает первые count элементов вектора номер vector_index (пара vector_index / 2).
+    bool read_vector(int64_t vector_index, double* out, int64_t count) {
+        if (vector_index < 0 || vector_index >= num_vectors() || count > header.vector_size) {
+            return false;
+        }
+        const uint64_t vector_bytes = header.vector_size * dtype_size(header.dtype);
+
+        if (file_version == 1) {
+            return read_at(header.data_offset + vector_index * vector_bytes, out, count * sizeof(double));
+        }
+
+        const int64_t vectors_per_chunk = 2 * header.pairs_per_chunk;
+        int64_t chunk = vector_index / vectors_per_chunk;
+        int64_t vector_in_chunk = vector_index % vectors_per_chunk;
+        const ChunkIndexEntry& entry = index[chunk];
+
+        // Неполное чтение несжатого float64-чанка идёт прямо с диска, но только
+        // после того, как чанк целиком прочитан и сверен с CRC32C: первое
+        // обращение к чанку идёт через load_chunk, последующие - из
+        // декодированного чанка, если он ещё в памяти, иначе напрямую.
+        if (entry.compression == COMPRESSION_NONE && header.dtype == DTYPE_FLOAT64 && count < header.vector_size
+            && verified_chunks[chunk] && chunk != cached_chunk) {
+            return read_at(entry.offset + vector_in_chunk * vector_bytes, out, count * sizeof(double));
+        }
+
+        if (!load_chunk(chunk)) {
+            return false;
+        }
+        const double* src = chunk_values.data() + vector_in_chunk * header.vector_size;
+        std::copy(src, src + count, out);
+        return true;
+    }
+
+    // Читает первые count элементов обоих векторов пары pair.
+    template <typename Alloc>
+    bool read_pair(int64_t pair, std::vector<double, Alloc>& vec1, std::vector<double, Alloc>& vec2, int64_t count) {
+        if (pair < 0 || pair >= header.num_pairs) {
+            return false;
+        }
+        count = std::min(count, header.vector_size);
+        vec1.resize(count);
+        vec2.resize(count);
+        return read_vector(2 * pair, vec1.data(), count) && read_vector(2 * pair + 1, vec2.data(), count);
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Параллельная запись. Чанки распределяются между потоками динамически,
+// каждый поток сам заполняет свою пару (fill) и кодирует чанк, а запись идёт
+// через WriteBehindWriter по заранее известным смещениям. Несжатые чанки
+// имеют фиксированный размер и смещение c * chunk_bytes; сжатым место
+// выделяется атомарным счётчиком в порядке готовности.
+
+using PairFiller = std::function<void(int64_t pair, double* vec1, double* vec2)>;
+
+inline VectorFileHeader make_vector_file_header(int64_t num_pairs, int64_t vector_size, const VectorFileOptions& options) {
+    VectorFileHeader header{};
+    memcpy(header.magic, VECTOR_FILE_MAGIC, sizeof(header.magic));
+    header.version = VECTOR_FILE_VERSION;
+    header.header_size = sizeof(VectorFileHeader);
+    header.dtype = options.version == 1 ? DTYPE_FLOAT64 : options.dtype;
+    header.compression = options.version == 1 ? COMPRESSION_NONE : options.compression;
+    header.num_pairs = num_pairs;
+    header.vector_size = vector_size;
+    header.pairs_per_chunk = options.pairs_per_chunk > 0
+        ? options.pairs_per_chunk
+        : default_pairs_per_chunk(vector_size, header.dtype);
+    header.num_chunks = (num_pairs + header.pairs_per_chunk - 1) / header.pairs_per_chunk;
+    header.seed = options.seed;
+
+    if (options.version == 1) {
+        header.data_offset = 2 * sizeof(int);
+    }
+    else {
+        header.index_offset = sizeof(VectorFileHeader);
+        header.data_offset = header.index_offset + header.num_chunks * sizeof(ChunkIndexEntry);
+    }
+    return header;
+}
+
+// Полный v2-файл с той же формой, кодированием и seed можно не генерировать заново.
+inline bool vector_file_is_current(const std::string& filename, int64_t num_pairs, int64_t vector_size,
+    const VectorFileOptions& options) {
+    if (options.version != 2) {
+        return false;
+    }
+    VectorFileReader reader;
+    if (!reader.open(filename) || reader.version() != 2) {
+        return false;
+    }
+
+    const VectorFileHeader& h = reader.file_header();
+    if (h.num_pairs != num_pairs || h.vector_size != vector_size || h.dtype != (uint32_t)options.dtype
+        || h.compression != (uint32_t)options.compression || h.seed != options.seed) {
+        return false;
+    }
+    if (options.pairs_per_chunk > 0 && h.pairs_per_chunk != options.pairs_per_chunk) {
+        return false;
+    }
+
+    uint64_t data_end = h.data_offset;
+    for (const ChunkIndexEntry& entry : reader.chunk_index()) {
+        data_end = std::max<uint64_t>(data_end, entry.offset + entry.stored_size);
+    }
+    return data_end <= reader.file_size();
+}
+
+inline bool write_vector_file(const std::string& filename, int64_t num_pairs, int64_t vector_size,
+    const VectorFileOptions& options, const PairFiller& fill) {
+    VectorFileHeader header = make_vector_file_header(num_pairs, vector_size, options);
+    const bool v1 = options.version == 1;
+    const bool compressed = header.compression != COMPRESSION_NONE;
+    const uint64_t chunk_bytes = header.pairs_per_chunk * 2 * vector_size * dtype_size(header.dtype);
+    const uint64_t max_size = header.data_offset + num_pairs * 2 * vector_size * dtype_size(header.dtype);
+
+    RandomAccessFile file;
+    if (!file.create(filename) || !file.preallocate(max_size)) {
+        return false;
+    }
+
+    std::vector<ChunkIndexEntry> index(header.num_chunks);
+    if (!v1) {
+        // Заголовок без флага COMPLETE: оборванная запись не будет принята за готовый файл.
+        if (!file.write_at(&header, sizeof(header), 0)
+            || !file.write_at(index.data(), index.size() * sizeof(ChunkIndexEntry), header.index_offset)) {
+            return false;
+        }
+    }
+
+    int threads = options.threads > 0 ? options.threads : omp_get_max_threads();
+    WriteBehindWriter writer(file, threads + 4);
+    std::atomic<uint64_t> cursor(header.data_offset);
+
+#pragma omp parallel num_threads(threads)
+    {
+        std::vector<double> values;
+        std::vector<uint8_t> raw;
+
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t c = 0; c < header.num_chunks; c++) {
+            int64_t first_pair = c * header.pairs_per_chunk;
+            int64_t pairs = std::min(header.pairs_per_chunk, num_pairs - first_pair);
+            values.resize((size_t)(pairs * 2 * vector_size));
+
+            for (int64_t p = 0; p < pairs; p++) {
+                double* vec1 = values.data() + p * 2 * vector_size;
+                fill(first_pair + p, vec1, vec1 + vector_size);
+            }
+
+            std::vector<uint8_t>* buffer = writer.acquire();
+            VectorCompression used = encode_chunk(values.data(), values.size(), header.dtype, header.compression, raw, *buffer);
+
+            uint64_t offset = compressed
+                ? cursor.fetch_add(buffer->size())
+                : header.data_offset + c * chunk_bytes;
+            index[c] = ChunkIndexEntry{ offset, buffer->size(), crc32c(buffer->data(), buffer->size()), (uint32_t)used };
+            writer.submit(buffer, offset);
+        }
+    }
+
+    if (!writer.finish()) {
+        return false;
+    }
+    if (compressed && !file.truncate(cursor.load())) {
+        return false;
+    }
+    if (!file.sync()) {
+        return false;
+    }
+
+    if (v1) {
+        int v1_header[2] = { (int)num_pairs, (int)vector_size };
+        return file.write_at(v1_header, sizeof(v1_header), 0);
+    }
+
+    header.index_crc = crc32c(index.data(), index.size() * sizeof(ChunkIndexEntry));
+    header.flags = VECTOR_FILE_COMPLETE;
+    header.header_crc = header_checksum(header);
+    return file.write_at(index.data(), index.size() * sizeof(ChunkIndexEntry), header.index_offset)
+        && file.write_at(&header, sizeof(header), 0);
+}